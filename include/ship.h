@@ -2,6 +2,9 @@
 #define SHIP_H
 
 #include "shared.h"
+#include <pthread.h>
+#include <sys/stat.h>
+#include <dirent.h>
 
 #define HEADER "\033[95m"
 #define BLUE "\033[94m"
@@ -23,6 +26,32 @@
 #define ARROW SYM_ARROW
 #define INFO SYM_INFO
 
+#define SHIP_HASH_SEED 0x9E3779B97F4A7C15ULL
+#define SHIP_STATE_DIR ".ship"
+#define SHIP_STATE_FILE SHIP_STATE_DIR "/state"
+#define SHIP_VERSION "1.0.0"
+#define SHIP_CACHE_MAGIC "SHIPC\001\0\0"
+#define SHIP_CACHE_MAGIC_LEN 8
+#define SHIP_BENCH_OUTPUT "bench_output.txt"
+#define SHIP_STATS_TOP 10
+#define SHIP_DAEMON_SOCKET SHIP_STATE_DIR "/daemon.sock"
+#define SHIP_WATCH_DEBOUNCE_MS 150
+#define SHIP_LOG_DIR SHIP_STATE_DIR "/logs"
+#define SHIP_DURATIONS_FILE SHIP_STATE_DIR "/durations"
+#define SHIP_DURATIONS_MAX_AGE (30 * 24 * 3600)
+#define SHIP_CAPTURE_TAIL (64 * 1024)
+#define SHIP_LOG_QUEUE_BYTES (4 * 1024 * 1024)
+#define SHIP_ARTIFACT_ENV "SHIP_ARTIFACT_CACHE"
+#define SHIP_ARTIFACT_LIMIT_ENV "SHIP_ARTIFACT_LIMIT"
+#define SHIP_ARTIFACT_LIMIT_MB 5120
+#define SHIP_ARTIFACT_MAGIC "SHIPA2"
+#define SHIP_WORKER_NAME "ship-worker"
+#define SHIP_WORKER_SOCKET SHIP_STATE_DIR "/worker.sock"
+#define SHIP_REMOTE_ENV "SHIP_REMOTE"
+#define SHIP_WORKER_TOKEN_ENV "SHIP_WORKER_TOKEN"
+#define SHIP_WIRE_CHUNK (64 * 1024)
+#define SHIP_WIRE_MAX_FRAME (16 * 1024 * 1024)
+
 /// @brief Basic string structure
 typedef struct
 {
@@ -31,6 +60,24 @@ typedef struct
     Size capacity;
 } ShipString;
 
+/// @brief One block of an arena; allocations are bumped out of data
+typedef struct ShipArenaChunk
+{
+    struct ShipArenaChunk* next;
+    Size size;
+    Size used;
+    UInt8 data[];
+} ShipArenaChunk;
+
+/// @brief Region allocator owning all parse-time memory of one build
+typedef struct
+{
+    ShipArenaChunk* head;
+    Size total;
+} ShipArena;
+
+#define SHIP_ARENA_CHUNK (64 << 10)
+
 /// @brief Vector structure for generic lists
 typedef struct
 {
@@ -39,33 +86,155 @@ typedef struct
     Size capacity;
 } ShipVector;
 
+typedef enum
+{
+    SHIP_VALUE_NULL,
+    SHIP_VALUE_STRING,
+    SHIP_VALUE_NUMBER,
+    SHIP_VALUE_BOOL,
+    SHIP_VALUE_LIST,
+    SHIP_VALUE_POINTER
+} ShipValueType;
+
+/// @brief Tagged script value, stored inline in maps and task args.
+/// POINTER carries internal records (state, ids) through the same map type.
+typedef struct ShipValue
+{
+    ShipValueType type;
+    union
+    {
+        ShipString string;
+        Float64 number;
+        Bool boolean;
+        struct
+        {
+            struct ShipValue* items;
+            Size count;
+        } list;
+        Any pointer;
+    };
+} ShipValue;
+
 typedef struct
 {
     ShipString key;
-    Any value;
+    UInt64 hash;
+    ShipValue value;
 } KVPair;
 
-/// @brief Simple Map structure
+/// @brief Insertion-ordered hash map. Pairs live densely in items; slots is an
+/// open-addressing (linear probing) index into items, -1 marking empty slots.
 typedef struct
 {
     KVPair* items;
     Size count;
     Size capacity;
+    Int32* slots;
+    Size slot_count;
+    ShipArena* arena;
 } ShipMap;
 
+/// @brief Resources used by a task: its own thread's CPU and I/O, its pool
+/// threads' and every child it reaped. max_rss_kb is the largest child's peak
+/// resident set. unmeasured marks work ship could not sample (a remote
+/// executor, the persistent shell), whose counters mean nothing.
+typedef struct
+{
+    UInt64 wall_ns;
+    Float64 user_sec;
+    Float64 sys_sec;
+    Int64 max_rss_kb;
+    Int64 in_blocks;
+    Int64 out_blocks;
+    Int64 vol_switches;
+    Int64 invol_switches;
+    Int32 children;
+    Bool unmeasured;
+} ShipUsage;
+
 typedef struct
 {
     ShipString stdout_str;
     ShipString stderr_str;
     Int32 returncode;
+    ShipUsage usage;
+    ShipValue value;
 } ShipResult;
 
+/// @brief Fixed-size ring keeping the last cap bytes written to it
+typedef struct
+{
+    Int8* data;
+    Size cap;
+    UInt64 total;
+} ShipRing;
+
+/// @brief One output stream of a task: its tail in memory, all of it in the
+/// log, and on a remote worker also framed back to the client as it arrives
+typedef struct
+{
+    ShipRing tail;
+    Int32 log_fd;
+    Int32 wire_fd;
+    UInt8 wire_type;
+} ShipCapture;
+
+/// @brief Frames of the remote execution protocol. Each is a UInt8 type and
+/// a big-endian UInt32 payload length, followed by the payload; integers in
+/// payloads are big-endian too. The client sends AUTH first when the worker
+/// wants a token, then ENV, FILE/DATA and OUTPUT frames, then RUN; the worker
+/// answers with STDOUT and STDERR as the command runs, FILE/DATA for the
+/// requested outputs, and EXIT.
+typedef enum
+{
+    SHIP_WIRE_ENV = 1,
+    SHIP_WIRE_FILE,
+    SHIP_WIRE_DATA,
+    SHIP_WIRE_OUTPUT,
+    SHIP_WIRE_RUN,
+    SHIP_WIRE_STDOUT,
+    SHIP_WIRE_STDERR,
+    SHIP_WIRE_EXIT,
+    SHIP_WIRE_AUTH
+} ShipWireType;
+
+/// @brief Executors that `remote: true` run tasks are spread across
+typedef struct
+{
+    ShipVector addrs;
+    UInt64 next;
+} ShipRemote;
+
+/// @brief Output queued for the log writer; a zero-length chunk closes fd
+typedef struct ShipLogChunk
+{
+    struct ShipLogChunk* next;
+    Int32 fd;
+    Size len;
+    Int8 data[];
+} ShipLogChunk;
+
+/// @brief Background thread draining captured output into per-task log files
+typedef struct
+{
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    ShipLogChunk* head;
+    ShipLogChunk* tail;
+    Size queued;
+    Bool running;
+    Bool stop;
+} ShipLogWriter;
+
 typedef enum
 {
     TOKEN_LBRACE,
     TOKEN_RBRACE,
     TOKEN_LPAREN,
     TOKEN_RPAREN,
+    TOKEN_LBRACKET,
+    TOKEN_RBRACKET,
     TOKEN_COLON,
     TOKEN_COMMA,
     TOKEN_EQUALS,
@@ -87,17 +256,181 @@ typedef enum
     TOKEN_EOF
 } ShipTokenType;
 
+/// @brief A token is a slice [offset, offset+length) of the script. Only
+/// string literals containing escapes are materialized, into text.
 typedef struct
 {
     ShipTokenType type;
-    ShipString value;
     Int32 line;
+    Size offset;
+    Size length;
+    Int8* text;
     Float64 number_value;
     Bool bool_value;
 } ShipToken;
 
+/// @brief Contiguous token array over the (memory-mapped) script source
+typedef struct
+{
+    ShipToken* data;
+    Size length;
+    Size capacity;
+    CharSeq source;
+} ShipTokenList;
+
 typedef ShipResult (*ShipFunc)(ShipMap args);
 
+typedef Void (*ShipJobFunc)(Any arg);
+
+typedef struct
+{
+    ShipJobFunc func;
+    Any arg;
+} ShipJob;
+
+/// @brief Fixed-size thread pool fed from a FIFO job queue
+typedef struct
+{
+    pthread_t* threads;
+    Size thread_count;
+    ShipJob* jobs;
+    Size head;
+    Size count;
+    Size capacity;
+    Size active;
+    Bool stopping;
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t idle;
+    ShipUsage usage;
+} ShipPool;
+
+#define SHIP_ZIP_STREAM_THRESHOLD (32ULL << 20)
+#define SHIP_ZIP_CHUNK (1ULL << 20)
+#define SHIP_ZIP_INFLIGHT_BYTES (256ULL << 20)
+#define SHIP_ZIP64_LIMIT 0xFFFFFFFFULL
+
+/// @brief One file of an archive being written by shipZip
+typedef struct
+{
+    Int8* path;
+    Int8* name;
+    UInt64 size;
+    UInt32 mode;
+    Int64 mtime;
+    UInt32 crc;
+    UInt64 csize;
+    UInt16 method;
+    UInt64 offset;
+    UInt8* data;
+    Bool zip64;
+    Bool ready;
+    Bool failed;
+    struct ShipZipWriter* writer;
+} ShipZipEntry;
+
+/// @brief One slice of a large entry, read and deflated on the pool on its
+/// own and flushed to a byte boundary so slices concatenate in order
+typedef struct
+{
+    ShipZipEntry* entry;
+    Int32 fd;
+    UInt64 offset;
+    Size length;
+    Bool last;
+    UInt8* data;
+    Size csize;
+    UInt32 crc;
+    Bool ready;
+    Bool failed;
+} ShipZipChunk;
+
+/// @brief Shared state of one recursive copy running on a pool
+typedef struct
+{
+    ShipPool pool;
+    pthread_mutex_t lock;
+    ShipVector dirs;
+    Int32 error;
+    Int8* error_path;
+    UInt64 files;
+    UInt64 bytes;
+} ShipCopyContext;
+
+typedef struct
+{
+    ShipCopyContext* ctx;
+    Int8* src;
+    Int8* dst;
+    struct stat sb;
+} ShipCopyJob;
+
+/// @brief Batched directory reader over getdents64 (readdir elsewhere)
+typedef struct
+{
+    Int32 fd;
+#ifdef __linux__
+    UInt8* buffer;
+    Size length;
+    Size pos;
+#else
+    DIR* dir;
+#endif
+} ShipDirReader;
+
+/// @brief Shared state of one parallel recursive delete
+typedef struct
+{
+    ShipPool pool;
+    pthread_mutex_t lock;
+    Int32 error;
+    Int8* error_path;
+    UInt64 removed;
+} ShipDeleteContext;
+
+/// @brief Shared state of one parallel glob walk for the list task
+typedef struct
+{
+    ShipPool pool;
+    pthread_mutex_t lock;
+    CharSeq root;
+    ShipVector include;
+    ShipVector exclude;
+    Bool recursive;
+    Int32 type;
+    ShipVector matches;
+    Int32 error;
+    Int8* error_path;
+} ShipListContext;
+
+typedef struct
+{
+    ShipListContext* ctx;
+    Int8* rel;
+} ShipListJob;
+
+/// @brief A directory being emptied; removed once its scan and all subdirectories
+/// finish. Children are opened and removed relative to fd, never by full path.
+typedef struct ShipDeleteDir
+{
+    ShipDeleteContext* ctx;
+    struct ShipDeleteDir* parent;
+    Int8* name;
+    Int32 fd;
+    Size pending;
+} ShipDeleteDir;
+
+typedef struct ShipZipWriter
+{
+    ShipZipEntry* entries;
+    Size count;
+    Size capacity;
+    Int32 level;
+    Bool store_only;
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+} ShipZipWriter;
+
 typedef struct
 {
     ShipString name;
@@ -111,17 +444,46 @@ typedef struct
     Size pos;
     Int32 line;
     Int32 col;
+    ShipArena* arena;
 } ShipLexer;
 
 typedef struct
 {
-    ShipVector tokens;
+    ShipArena* arena;
+    ShipTokenList tokens;
     Size pos;
     ShipMap variables;
     ShipVector tasks;
     ShipString title;
+    Int32 group_count;
+    Bool failed;
 } ShipParser;
 
+typedef enum
+{
+    SHIP_EXPR_CONST,
+    SHIP_EXPR_NOT,
+    SHIP_EXPR_OR,
+    SHIP_EXPR_AND,
+    SHIP_EXPR_EQ,
+    SHIP_EXPR_NE,
+    SHIP_EXPR_LT,
+    SHIP_EXPR_LE,
+    SHIP_EXPR_GT,
+    SHIP_EXPR_GE
+} ShipExprOp;
+
+/// @brief Compiled expression node, allocated from the parse arena.
+/// exprFold collapses subtrees whose operands are constant into a CONST leaf.
+typedef struct ShipExpr
+{
+    ShipExprOp op;
+    ShipValue value;
+    Int32 line;
+    struct ShipExpr* left;
+    struct ShipExpr* right;
+} ShipExpr;
+
 typedef struct
 {
     ShipFunc func;
@@ -129,27 +491,370 @@ typedef struct
     ShipString task_name;
     Bool is_custom;
     ShipString custom_name;
+    Int32 group;
+    Size* deps;
+    Size dep_count;
+    Size* dependents;
+    Size dependent_count;
+    UInt64 args_hash;
 } ShipTask;
 
+/// @brief Options controlling a single runBuild invocation
+typedef struct
+{
+    Bool dry_run;
+    Int32 jobs;
+    Bool force;
+    Bool stats;
+    Bool* selected;
+    CharSeq artifact_dir;
+    UInt64 artifact_limit;
+    Bool jobserver;
+    Float64 cpus;
+    UInt64 memory;
+} ShipBuildOptions;
+
+/// @brief GNU make jobserver: a pipe (or fifo) of tokens, one per job slot
+/// beyond the implicit one every participant starts with. Either created by
+/// ship for its children or inherited from a parent make through MAKEFLAGS.
+typedef struct
+{
+    Int32 read_fd;
+    Int32 write_fd;
+    Bool owner;
+    Int32 implicit_free;
+    Int32 wake[2];
+    Int8* saved_makeflags;
+} ShipJobserver;
+
+#define SHIP_JOB_IMPLICIT (-1)
+#define SHIP_JOB_ERROR (-2)
+
+/// @brief Running SHA-256 state
+typedef struct
+{
+    UInt32 h[8];
+    UInt64 length;
+    UInt8 block[64];
+    Size used;
+} ShipSha256;
+
+/// @brief SHA-256 digest; names blobs and tasks in the shared artifact store
+typedef struct
+{
+    UInt8 bytes[32];
+} ShipDigest;
+
+/// @brief A file of the artifact store, as seen by LRU eviction
+typedef struct
+{
+    Int8* path;
+    Int64 size;
+    Int64 mtime_ns;
+} ShipArtifactFile;
+
+/// @brief A mapped .shipc parse cache. Loaded tasks borrow their strings from
+/// the mapping, so it must outlive the build.
+typedef struct
+{
+    UInt8* data;
+    Size size;
+} ShipCache;
+
+/// @brief Bounds-checked cursor over a .shipc image; ok drops to false on overrun
+typedef struct
+{
+    const UInt8* data;
+    Size size;
+    Size pos;
+    Bool ok;
+} ShipCacheReader;
+
+/// @brief One Chrome trace event: a complete span ('X') or a thread name ('M')
+typedef struct
+{
+    Int8 phase;
+    ShipString name;
+    CharSeq category;
+    UInt64 start_ns;
+    UInt64 end_ns;
+    Int32 tid;
+    Int64 child_pid;
+} ShipTraceEvent;
+
+/// @brief Process-wide event buffer for --trace; appended to under lock
+typedef struct
+{
+    Bool enabled;
+    UInt64 origin_ns;
+    ShipTraceEvent* events;
+    Size count;
+    Size capacity;
+    pthread_mutex_t lock;
+} ShipTrace;
+
+/// @brief Shape of the synthetic Shipfile generated by --bench
+typedef struct
+{
+    Size vars;
+    Size tasks;
+    Int32 depth;
+    Int32 escape_pct;
+    Int32 iterations;
+} ShipBenchConfig;
+
+/// @brief Timing samples for one benchmarked phase
+typedef struct
+{
+    CharSeq phase;
+    Size items;
+    Int32 runs;
+    UInt64 min_ns;
+    UInt64 max_ns;
+    UInt64 total_ns;
+} ShipBenchResult;
+
+/// @brief Parsed command line
+typedef struct
+{
+    CharSeq script_path;
+    ShipBuildOptions options;
+    Bool use_cache;
+    Bool bench;
+    ShipBenchConfig bench_config;
+    CharSeq trace_path;
+    Bool daemon;
+    Bool client;
+    Bool watch;
+    CharSeq remote;
+    CharSeq worker;
+} ShipCli;
+
+/// @brief inotify instance; dirs maps each watch descriptor to its directory
+typedef struct
+{
+    Int32 fd;
+    ShipVector dirs;
+} ShipWatcher;
+
+/// @brief Long-lived /bin/sh that consecutive `shell: "persistent"` run tasks share
+typedef struct
+{
+    Int32 pid;
+    Int32 in_fd;
+    Int32 out_fd;
+    Int32 err_fd;
+    UInt64 serial;
+    Bool started;
+    pthread_mutex_t lock;
+} ShipShell;
+
+/// @brief Script bytes, mmap'd when possible
+typedef struct
+{
+    Int8* data;
+    Size size;
+    Bool mapped;
+} ShipSource;
+
+/// @brief A loaded, planned script. Tasks may borrow from the arena, the
+/// token list or the cache mapping, which all live until scriptFree.
+typedef struct
+{
+    ShipArena arena;
+    ShipCache cache;
+    ShipTokenList tokens;
+    ShipString title;
+    ShipVector tasks;
+} ShipScript;
+
+/// @brief A script kept parsed in daemon memory, reused while its key matches
+typedef struct
+{
+    UInt64 key;
+    ShipArena arena;
+    ShipCache cache;
+    ShipString title;
+    ShipVector tasks;
+} ShipWarmScript;
+
+/// @brief Cached content hash of a file, reused while size and mtime match
+typedef struct
+{
+    Int64 size;
+    Int64 mtime_ns;
+    UInt64 hash;
+} ShipFileRecord;
+
+/// @brief Fingerprint of the last successful run of a task
+typedef struct
+{
+    UInt64 args_hash;
+    UInt64 inputs_hash;
+    UInt64 outputs_hash;
+} ShipTaskRecord;
+
+/// @brief Wall time of a task's last successful run
+typedef struct
+{
+    UInt64 args_hash;
+    UInt64 wall_ms;
+    Int64 seen;
+} ShipDurationRecord;
+
+/// @brief Measured task durations (.ship/durations), one line per task
+typedef struct
+{
+    ShipMap records;
+    Bool dirty;
+} ShipDurationLog;
+
+/// @brief On-disk incremental build state (.ship/state)
+typedef struct
+{
+    ShipMap files;
+    ShipMap tasks;
+    Bool dirty;
+    pthread_mutex_t lock;
+} ShipState;
+
+/// @brief Long-lived state of `ship --daemon`. Each build runs in a forked
+/// child, which inherits the warm scripts and file-hash state copy-on-write.
+typedef struct
+{
+    ShipMap scripts;
+    ShipState state;
+    Bool state_loaded;
+    Int64 state_mtime_ns;
+    Int64 state_size;
+} ShipDaemon;
+
+typedef enum
+{
+    TASK_WAITING,
+    TASK_READY,
+    TASK_RUNNING,
+    TASK_DONE,
+    TASK_SKIPPED,
+    TASK_FAILED,
+    TASK_UNSELECTED,
+    TASK_RESTORED
+} ShipTaskState;
+
+/// @brief Shared state of the worker pool executing the task graph
+typedef struct
+{
+    ShipVector* tasks;
+    ShipTaskState* states;
+    ShipResult* results;
+    Size* pending;
+    Size* ready;
+    Size ready_head;
+    Size ready_tail;
+    Size running;
+    Size next_report;
+    Bool failed;
+    Size stored;
+    ShipJobserver jobserver;
+    Float64* cpus;
+    UInt64* memory;
+    Float64 cpus_free;
+    UInt64 memory_free;
+    ShipBuildOptions* options;
+    ShipState* state;
+    ShipDurationLog* durations;
+    Float64* priority;
+    ShipMap ids;
+    Bool* referenced;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} ShipScheduler;
+
+Void arenaInit(ShipArena* a);
+Any arenaAlloc(ShipArena* a, Size size);
+ShipString arenaString(ShipArena* a, CharSeq data, Size len);
+Void arenaFree(ShipArena* a);
+
 Void string_free(ShipString* s);
 ShipString string_dup(CharSeq c);
 ShipString stringEmpty();
+ShipString stringView(CharSeq c);
+Void stringAppend(ShipString* s, const Int8* data, Size len);
+Size stringTrimmedLength(ShipString* s);
 ShipString string_from(CharSeq c);
+ShipString stringFromLength(CharSeq c, Size len);
 
 Void vectorPush(ShipVector* v, Any item);
 Any vector_get(ShipVector* v, Size index);
 Void vectorInit(ShipVector* v);
 
-Void mapSet(ShipMap* m, ShipString key, Any value);
-Any mapGet(ShipMap* m, ShipString key);
+Void mapSet(ShipMap* m, ShipString key, ShipValue value);
+ShipValue* mapGet(ShipMap* m, ShipString key);
+ShipValue* mapGetStr(ShipMap* m, CharSeq key);
+Any mapGetPointer(ShipMap* m, ShipString key);
+ShipString* valueAsString(ShipValue* v);
+Float64 valueAsNumber(ShipValue* v, Float64 fallback);
+Bool valueAsBool(ShipValue* v, Bool fallback);
+Bool valueTruthy(ShipValue* v);
+ShipString valueToString(ShipValue* v);
+Void valueFree(ShipValue* v);
+Bool valueEquals(ShipValue* a, ShipValue* b);
+UInt64 valueHash(UInt64 h, ShipValue* v);
+ShipExpr* exprMake(ShipArena* arena, ShipExprOp op, Int32 line, ShipExpr* left, ShipExpr* right);
+ShipExpr* exprFold(ShipExpr* e, Bool* failed);
+ShipValue exprEval(ShipExpr* e, Bool* failed);
+KVPair* mapLookup(ShipMap* m, CharSeq key, Size len, UInt64 hash);
 Void mapInit(ShipMap* m);
+Void mapInitArena(ShipMap* m, ShipArena* arena);
+Void mapFree(ShipMap* m);
 
 Void registryInit();
 Void registryRegister(CharSeq name, CharSeq display_name, ShipFunc func);
+ShipRegistryEntry* registryLookup(CharSeq name, Size len);
 ShipFunc registryGet(CharSeq name);
 Bool registryExists(CharSeq name);
 ShipString registryGetDisplayName(CharSeq name);
 
+Int8* pathJoin(CharSeq dir, CharSeq name);
+Bool pathMakeParents(CharSeq path);
+Bool pathWithin(CharSeq path, CharSeq root);
+Bool copyFile(CharSeq src, CharSeq dst, struct stat* sb);
+Bool copyTree(CharSeq src, CharSeq dst, ShipString* err, UInt64* files, UInt64* bytes);
+Bool movePath(CharSeq src, CharSeq dst, ShipString* err);
+Bool removeTree(CharSeq path, Bool forgive_missing, ShipString* err, UInt64* removed);
+
+Bool dirOpen(ShipDirReader* r, Int32 fd);
+Bool dirNext(ShipDirReader* r, CharSeq* name, UInt8* type);
+Void dirClose(ShipDirReader* r);
+Bool globMatch(CharSeq pattern, CharSeq path);
+Bool listTree(ShipListContext* ctx);
+
+Bool commandNeedsShell(CharSeq cmd);
+Void ringWrite(ShipRing* r, const Int8* data, Size len);
+Void captureWrite(ShipCapture* c, const Int8* data, Size len);
+ShipString captureFinish(ShipCapture* c, CharSeq log_path);
+Void logWriterPush(Int32 fd, const Int8* data, Size len);
+Void logWriterDrain();
+Int32 processRun(CharSeq cmd, Int8** env, ShipCapture* out, ShipCapture* err, ShipUsage* usage);
+Int8** envMerge(ShipValue* v);
+Bool wireSend(Int32 fd, UInt8 type, const Void* data, Size len);
+Bool wireRecv(Int32 fd, UInt8* type, ShipString* payload);
+Int32 wireConnect(CharSeq addr);
+Int32 wireListen(CharSeq addr);
+Bool wireIsLocal(CharSeq addr);
+Int32 remoteRun(CharSeq addr, CharSeq cmd, ShipMap* args, ShipCapture* out, ShipCapture* err, Bool* reached);
+Void remoteConfigure(CharSeq spec);
+Int32 workerServe(CharSeq addr);
+Int32 shellRun(ShipShell* sh, CharSeq cmd, ShipValue* env, ShipCapture* out, ShipCapture* err);
+Void shellClose(ShipShell* sh);
+
+Void poolInit(ShipPool* pool, Size threads);
+Void poolSubmit(ShipPool* pool, ShipJobFunc func, Any arg);
+Void poolWait(ShipPool* pool);
+Void poolDestroy(ShipPool* pool);
+ShipUsage usageThread();
+Void usageAdd(ShipUsage* a, ShipUsage* b);
+
 Void printHeader(CharSeq title);
 ShipResult shipRun(ShipMap args);
 ShipResult shipDelete(ShipMap args);
@@ -161,10 +866,74 @@ ShipResult shipZip(ShipMap args);
 ShipResult shipList(ShipMap args);
 ShipResult shipEcho(ShipMap args);
 
-ShipVector tokenize(CharSeq content);
-Void parserInit(ShipParser* p, ShipVector tokens);
-Void parserParse(ShipParser* p);
+UInt64 hashBytes(UInt64 h, const Void* data, Size len);
+UInt64 hashFile(CharSeq path, Bool* ok);
+Bool listNext(CharSeq* cursor, CharSeq* start, Size* len);
+
+Void stateLoad(ShipState* st, CharSeq path);
+Bool stateSave(ShipState* st, CharSeq path);
+Bool stateTracked(ShipTask* t);
+Void sha256Init(ShipSha256* c);
+Void sha256Update(ShipSha256* c, const Void* data, Size len);
+Void sha256Final(ShipSha256* c, ShipDigest* out);
+Bool sha256File(CharSeq path, ShipDigest* out);
+Bool artifactKey(ShipTask* t, ShipDigest* key);
+Bool artifactRestore(CharSeq dir, ShipDigest* key, Size* files);
+Bool artifactStore(CharSeq dir, ShipDigest* key, ShipValue* outputs);
+Void artifactEvict(CharSeq dir, UInt64 limit);
+Bool stateCheck(ShipState* st, ShipTask* t, UInt64* inputs_hash);
+Void stateRecord(ShipState* st, ShipTask* t, UInt64 inputs_hash);
+
+ShipTokenList tokenize(ShipArena* arena, CharSeq content, Size length);
+ShipString tokenText(ShipTokenList* tokens, ShipToken* t);
+Bool tokenIs(ShipTokenList* tokens, ShipToken* t, CharSeq word);
+Void parserInit(ShipParser* p, ShipTokenList tokens, ShipArena* arena);
+Bool parserParse(ShipParser* p);
+
+UInt64 cacheKey(CharSeq content, Size length);
+Void cachePath(CharSeq script_path, Int8* out, Size cap);
+Bool cacheLoad(CharSeq path, UInt64 key, ShipArena* arena, ShipCache* cache, ShipString* title, ShipVector* tasks);
+Bool cacheSave(CharSeq path, UInt64 key, ShipString title, ShipVector tasks);
+Void cacheClose(ShipCache* cache);
+
+UInt64 clockNs();
+Void traceStart();
+Void traceThreadName(CharSeq name);
+Void traceSpan(CharSeq category, CharSeq name, UInt64 start_ns, UInt64 end_ns, Int64 child_pid);
+Bool traceWrite(CharSeq path);
+ShipString benchGenerate(ShipBenchConfig* config);
+Bool benchRun(ShipBenchConfig* config, CharSeq out_path);
+
+Void stateFree(ShipState* st);
+Void durationsLoad(ShipDurationLog* log, CharSeq path);
+Bool durationsSave(ShipDurationLog* log, CharSeq path);
+Void durationsRecord(ShipDurationLog* log, ShipTask* t, UInt64 wall_ns);
+Void durationsFree(ShipDurationLog* log);
+Void formatSeconds(Int8* buf, Size cap, Float64 seconds);
+Float64 planPriorities(ShipVector* tasks, ShipBuildOptions* options, ShipDurationLog* log, Float64* priority);
+Bool cliParse(ShipCli* cli, Int32 argc, Int8** argv, Int8* err, Size err_cap);
+Bool sourceOpen(CharSeq script_path, ShipSource* src);
+Void sourceClose(ShipSource* src);
+Bool scriptLoad(ShipCli* cli, ShipScript* script);
+Void scriptFree(ShipScript* script);
+Int32 buildScript(ShipCli* cli);
+Int32 daemonServe(CharSeq socket_path);
+Int32 clientRun(CharSeq socket_path, Int32 argc, Int8** argv, Bool* connected);
+
+Bool watcherInit(ShipWatcher* w);
+Void watcherAddTree(ShipWatcher* w, CharSeq path);
+Void watcherFree(ShipWatcher* w);
+Bool watchPathUnder(CharSeq path, CharSeq root);
+Int32 watchRun(ShipCli* cli);
 
-Void runBuild(ShipString title, ShipVector tasks, Bool dry_run);
+Int32 cpuCount();
+UInt64 memoryCapacity();
+Bool parseMemory(CharSeq text, UInt64* bytes);
+Bool jobserverInit(ShipJobserver* js, Int32 jobs);
+Int32 jobserverAcquire(ShipJobserver* js);
+Void jobserverRelease(ShipJobserver* js, Int32 token);
+Void jobserverFree(ShipJobserver* js);
+Bool planBuild(ShipVector tasks, ShipArena* arena);
+Bool runBuild(ShipString title, ShipVector tasks, ShipBuildOptions* options);
 
 #endif
@@ -1,20 +1,53 @@
+#define _GNU_SOURCE
 #include "ship.h"
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <time.h>
 #include <stdarg.h>
+#include <errno.h>
+#include <strings.h>
+#include <zlib.h>
 
 #ifdef _WIN32
 #include <windows.h>
 #define PATH_SEP '\\'
 #else
 #include <unistd.h>
+#include <spawn.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <dirent.h>
 #include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/sendfile.h>
+#include <sys/inotify.h>
+#include <linux/fs.h>
+#endif
 #define PATH_SEP '/'
 #endif
 
+extern Int8** environ;
+
 static ShipVector global_registry;
+static ShipTrace global_trace;
+static ShipDaemon* global_daemon;
+static ShipShell global_shell = { .lock = PTHREAD_MUTEX_INITIALIZER };
+static ShipLogWriter global_log = { .lock = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER };
+static __thread CharSeq task_log_path;
+static __thread ShipUsage* task_usage;
+static ShipRemote global_remote;
 
 /// @brief Create a new String from C string
 ShipString stringFrom(CharSeq c)
@@ -35,6 +68,81 @@ ShipString stringFrom(CharSeq c)
     return s;
 }
 
+/// @brief Copy exactly len bytes into a new NUL-terminated String
+ShipString stringFromLength(CharSeq c, Size len)
+{
+    ShipString s;
+    s.length = len;
+    s.capacity = len + 1;
+    s.data = (Int8*)malloc(s.capacity);
+    memcpy(s.data, c, len);
+    s.data[len] = '\0';
+    return s;
+}
+
+/// @brief Non-owning string over existing NUL-terminated data (capacity 0)
+ShipString stringView(CharSeq c)
+{
+    ShipString s;
+    s.data = (Int8*)c;
+    s.length = strlen(c);
+    s.capacity = 0;
+    return s;
+}
+
+Void arenaInit(ShipArena* a)
+{
+    a->head = null;
+    a->total = 0;
+}
+
+/// @brief Bump-allocate 16-byte aligned memory; it lives until arenaFree
+Any arenaAlloc(ShipArena* a, Size size)
+{
+    size = (size + 15) & ~(Size)15;
+    ShipArenaChunk* c = a->head;
+    if(!c || c->used + size > c->size)
+    {
+        Size chunk = c ? c->size * 2 : SHIP_ARENA_CHUNK;
+        if(chunk > (16 << 20)) chunk = 16 << 20;
+        if(chunk < size) chunk = size;
+        c = (ShipArenaChunk*)malloc(sizeof(ShipArenaChunk) + chunk);
+        c->next = a->head;
+        c->size = chunk;
+        c->used = 0;
+        a->head = c;
+        a->total += chunk;
+    }
+    Any p = c->data + c->used;
+    c->used += size;
+    return p;
+}
+
+/// @brief Copy len bytes into the arena as a NUL-terminated string
+ShipString arenaString(ShipArena* a, CharSeq data, Size len)
+{
+    ShipString s;
+    s.data = (Int8*)arenaAlloc(a, len + 1);
+    memcpy(s.data, data, len);
+    s.data[len] = '\0';
+    s.length = len;
+    s.capacity = 0;
+    return s;
+}
+
+/// @brief Release every allocation of the arena at once
+Void arenaFree(ShipArena* a)
+{
+    ShipArenaChunk* c = a->head;
+    while(c)
+    {
+        ShipArenaChunk* next = c->next;
+        free(c);
+        c = next;
+    }
+    arenaInit(a);
+}
+
 /// @brief Free string memory
 Void stringFree(ShipString* s)
 {
@@ -47,17 +155,56 @@ Void stringFree(ShipString* s)
     s->capacity = 0;
 }
 
-/// @brief definition of mapFind
-KVPair* mapFind(ShipMap* m, ShipString key)
+/// @brief Append bytes, growing the buffer geometrically
+Void stringAppend(ShipString* s, const Int8* data, Size len)
 {
-    for(Size i = 0; i < m->count; i++)
+    if(s->length + len + 1 > s->capacity)
+    {
+        Size cap = s->capacity ? s->capacity : 64;
+        while(cap < s->length + len + 1) cap *= 2;
+        s->data = (Int8*)realloc(s->data, cap);
+        s->capacity = cap;
+    }
+    memcpy(s->data + s->length, data, len);
+    s->length += len;
+    s->data[s->length] = '\0';
+}
+
+/// @brief Length without trailing whitespace
+Size stringTrimmedLength(ShipString* s)
+{
+    Size len = s->length;
+    while(len > 0 && isspace((UInt8)s->data[len - 1])) len--;
+    return len;
+}
+
+/// @brief Probe for key; hash must be hashBytes(SHIP_HASH_SEED, key, len)
+KVPair* mapLookup(ShipMap* m, CharSeq key, Size len, UInt64 hash)
+{
+    if(m->slot_count == 0)
     {
-        if(strcmp(m->items[i].key.data, key.data) == 0)
+        return null;
+    }
+    Size mask = m->slot_count - 1;
+    for(Size i = (Size)hash & mask;; i = (i + 1) & mask)
+    {
+        Int32 idx = m->slots[i];
+        if(idx < 0)
+        {
+            return null;
+        }
+        KVPair* kv = &m->items[idx];
+        if(kv->hash == hash && kv->key.length == len && memcmp(kv->key.data, key, len) == 0)
         {
-            return &m->items[i];
+            return kv;
         }
     }
-    return null;
+}
+
+/// @brief definition of mapFind
+KVPair* mapFind(ShipMap* m, ShipString key)
+{
+    return mapLookup(m, key.data, key.length, hashBytes(SHIP_HASH_SEED, key.data, key.length));
 }
 
 /// @brief Initialize registry
@@ -78,20 +225,27 @@ Void registryRegister(CharSeq name, CharSeq display_name, ShipFunc func)
     vectorPush(&global_registry, entry);
 }
 
-/// @brief Get function by name
-ShipFunc registryGet(CharSeq name)
+/// @brief Find a registry entry by a (not necessarily NUL-terminated) name
+ShipRegistryEntry* registryLookup(CharSeq name, Size len)
 {
     for(Size i = 0; i < global_registry.length; i++)
     {
         ShipRegistryEntry* entry = (ShipRegistryEntry*)global_registry.data[i];
-        if(strcmp(entry->name.data, name) == 0)
+        if(entry->name.length == len && memcmp(entry->name.data, name, len) == 0)
         {
-            return entry->func;
+            return entry;
         }
     }
     return null;
 }
 
+/// @brief Get function by name
+ShipFunc registryGet(CharSeq name)
+{
+    ShipRegistryEntry* entry = registryLookup(name, strlen(name));
+    return entry ? entry->func : null;
+}
+
 /// @brief Check if function exists
 Bool registryExists(CharSeq name)
 {
@@ -136,35 +290,494 @@ Void mapInit(ShipMap* m)
     m->count = 0;
     m->capacity = 0;
     m->items = null;
+    m->slots = null;
+    m->slot_count = 0;
+    m->arena = null;
+}
+
+/// @brief Map whose keys and tables are allocated from arena and never freed individually
+Void mapInitArena(ShipMap* m, ShipArena* arena)
+{
+    mapInit(m);
+    m->arena = arena;
+}
+
+Void mapFree(ShipMap* m)
+{
+    if(!m->arena)
+    {
+        for(Size i = 0; i < m->count; i++)
+        {
+            stringFree(&m->items[i].key);
+        }
+        free(m->items);
+        free(m->slots);
+    }
+    mapInit(m);
+}
+
+/// @brief Rebuild the slot index at twice the size, reusing the cached hashes
+Void mapGrow(ShipMap* m)
+{
+    Size count = m->slot_count == 0 ? 8 : m->slot_count * 2;
+    if(m->arena)
+    {
+        m->slots = (Int32*)arenaAlloc(m->arena, count * sizeof(Int32));
+    }
+    else
+    {
+        free(m->slots);
+        m->slots = (Int32*)malloc(count * sizeof(Int32));
+    }
+    memset(m->slots, 0xFF, count * sizeof(Int32));
+    m->slot_count = count;
+    Size mask = count - 1;
+    for(Size i = 0; i < m->count; i++)
+    {
+        Size j = (Size)m->items[i].hash & mask;
+        while(m->slots[j] >= 0) j = (j + 1) & mask;
+        m->slots[j] = (Int32)i;
+    }
 }
 
-Void mapSet(ShipMap* m, ShipString key, Any value)
+Void mapSet(ShipMap* m, ShipString key, ShipValue value)
 {
-    KVPair* existing = mapFind(m, key);
+    UInt64 hash = hashBytes(SHIP_HASH_SEED, key.data, key.length);
+    KVPair* existing = mapLookup(m, key.data, key.length, hash);
     if(existing)
     {
         existing->value = value;
         return;
     }
+    if((m->count + 1) * 4 > m->slot_count * 3)
+    {
+        mapGrow(m);
+    }
     if(m->count >= m->capacity)
     {
         m->capacity = m->capacity == 0 ? 4 : m->capacity * 2;
-        m->items = (KVPair*)realloc(m->items, m->capacity * sizeof(KVPair));
+        if(m->arena)
+        {
+            KVPair* items = (KVPair*)arenaAlloc(m->arena, m->capacity * sizeof(KVPair));
+            if(m->count) memcpy(items, m->items, m->count * sizeof(KVPair));
+            m->items = items;
+        }
+        else
+        {
+            m->items = (KVPair*)realloc(m->items, m->capacity * sizeof(KVPair));
+        }
     }
-    m->items[m->count].key = stringFrom(key.data);
-    m->items[m->count].value = value;
+    KVPair* kv = &m->items[m->count];
+    kv->key = m->arena ? arenaString(m->arena, key.data, key.length) : stringFromLength(key.data, key.length);
+    kv->hash = hash;
+    kv->value = value;
+    Size mask = m->slot_count - 1;
+    Size j = (Size)hash & mask;
+    while(m->slots[j] >= 0) j = (j + 1) & mask;
+    m->slots[j] = (Int32)m->count;
     m->count++;
 }
 
-Any mapGet(ShipMap* m, ShipString key)
+/// @brief Lookup with a borrowed key; never allocates. Null when absent.
+ShipValue* mapGet(ShipMap* m, ShipString key)
 {
     KVPair* pair = mapFind(m, key);
-    return pair ? pair->value : null;
+    return pair ? &pair->value : null;
+}
+
+/// @brief Lookup by C string literal, e.g. mapGetStr(&args, "command")
+ShipValue* mapGetStr(ShipMap* m, CharSeq key)
+{
+    Size len = strlen(key);
+    KVPair* pair = mapLookup(m, key, len, hashBytes(SHIP_HASH_SEED, key, len));
+    return pair ? &pair->value : null;
+}
+
+/// @brief Lookup of an internal record stored with valueFromPointer
+Any mapGetPointer(ShipMap* m, ShipString key)
+{
+    ShipValue* v = mapGet(m, key);
+    return v && v->type == SHIP_VALUE_POINTER ? v->pointer : null;
+}
+
+/// @brief Value implementations
+simple ShipValue valueNull()
+{
+    ShipValue v;
+    memset(&v, 0, sizeof(v));
+    return v;
+}
+
+simple ShipValue valueFromString(ShipString s)
+{
+    ShipValue v = valueNull();
+    v.type = SHIP_VALUE_STRING;
+    v.string = s;
+    return v;
+}
+
+simple ShipValue valueFromNumber(Float64 n)
+{
+    ShipValue v = valueNull();
+    v.type = SHIP_VALUE_NUMBER;
+    v.number = n;
+    return v;
+}
+
+simple ShipValue valueFromBool(Bool b)
+{
+    ShipValue v = valueNull();
+    v.type = SHIP_VALUE_BOOL;
+    v.boolean = b;
+    return v;
+}
+
+simple ShipValue valueFromPointer(Any ptr)
+{
+    ShipValue v = valueNull();
+    v.type = SHIP_VALUE_POINTER;
+    v.pointer = ptr;
+    return v;
+}
+
+/// @brief The string payload, or null when v is missing or not a string
+ShipString* valueAsString(ShipValue* v)
+{
+    return v && v->type == SHIP_VALUE_STRING ? &v->string : null;
+}
+
+Float64 valueAsNumber(ShipValue* v, Float64 fallback)
+{
+    return v && v->type == SHIP_VALUE_NUMBER ? v->number : fallback;
+}
+
+Bool valueAsBool(ShipValue* v, Bool fallback)
+{
+    return v && v->type == SHIP_VALUE_BOOL ? v->boolean : fallback;
+}
+
+/// @brief Condition semantics: null, false, 0, [] and the strings "", "false",
+/// "0", "null" and "none" (any case) are false
+Bool valueTruthy(ShipValue* v)
+{
+    static CharSeq falsy[] = { "false", "0", "null", "none" };
+    if(!v) return false;
+    switch(v->type)
+    {
+        case SHIP_VALUE_STRING:
+            for(Size i = 0; i < sizeof(falsy) / sizeof(falsy[0]); i++)
+            {
+                if(v->string.length == strlen(falsy[i]) && strncasecmp(v->string.data, falsy[i], v->string.length) == 0)
+                {
+                    return false;
+                }
+            }
+            return v->string.length > 0;
+        case SHIP_VALUE_NUMBER: return v->number != 0;
+        case SHIP_VALUE_BOOL: return v->boolean;
+        case SHIP_VALUE_LIST: return v->list.count > 0;
+        case SHIP_VALUE_POINTER: return v->pointer != null;
+        default: return false;
+    }
+}
+
+/// @brief Structural equality; numbers and bools compare numerically
+Bool valueEquals(ShipValue* a, ShipValue* b)
+{
+    Bool a_num = a->type == SHIP_VALUE_NUMBER || a->type == SHIP_VALUE_BOOL;
+    Bool b_num = b->type == SHIP_VALUE_NUMBER || b->type == SHIP_VALUE_BOOL;
+    if(a_num && b_num)
+    {
+        return valueAsNumber(a, a->boolean) == valueAsNumber(b, b->boolean);
+    }
+    if(a->type != b->type)
+    {
+        return false;
+    }
+    switch(a->type)
+    {
+        case SHIP_VALUE_STRING:
+            return a->string.length == b->string.length && memcmp(a->string.data, b->string.data, a->string.length) == 0;
+        case SHIP_VALUE_LIST:
+            if(a->list.count != b->list.count) return false;
+            for(Size i = 0; i < a->list.count; i++)
+            {
+                if(!valueEquals(&a->list.items[i], &b->list.items[i])) return false;
+            }
+            return true;
+        case SHIP_VALUE_POINTER:
+            return a->pointer == b->pointer;
+        default:
+            return true;
+    }
+}
+
+/// @brief Fold a value's type and contents into h; used to fingerprint task args
+UInt64 valueHash(UInt64 h, ShipValue* v)
+{
+    h = hashBytes(h, &v->type, sizeof(v->type));
+    switch(v->type)
+    {
+        case SHIP_VALUE_STRING: return hashBytes(h, v->string.data, v->string.length);
+        case SHIP_VALUE_NUMBER: return hashBytes(h, &v->number, sizeof(Float64));
+        case SHIP_VALUE_BOOL: return hashBytes(h, &v->boolean, sizeof(Bool));
+        case SHIP_VALUE_LIST:
+            for(Size i = 0; i < v->list.count; i++)
+            {
+                h = valueHash(h, &v->list.items[i]);
+            }
+            return hashBytes(h, &v->list.count, sizeof(Size));
+        default: return h;
+    }
+}
+
+/// @brief Render a value as text; list items are joined by spaces. Caller frees.
+ShipString valueToString(ShipValue* v)
+{
+    Int8 buf[64];
+    if(!v || v->type == SHIP_VALUE_NULL) return stringFrom("null");
+    switch(v->type)
+    {
+        case SHIP_VALUE_STRING:
+            return stringFromLength(v->string.data, v->string.length);
+        case SHIP_VALUE_NUMBER:
+            snprintf(buf, sizeof(buf), "%.15g", v->number);
+            return stringFrom(buf);
+        case SHIP_VALUE_BOOL:
+            return stringFrom(v->boolean ? "true" : "false");
+        case SHIP_VALUE_LIST:
+        {
+            ShipString out = stringFrom("");
+            for(Size i = 0; i < v->list.count; i++)
+            {
+                ShipString item = valueToString(&v->list.items[i]);
+                if(i) stringAppend(&out, " ", 1);
+                stringAppend(&out, item.data, item.length);
+                stringFree(&item);
+            }
+            return out;
+        }
+        default:
+            return stringFrom("");
+    }
+}
+
+/// @brief Release a heap-built value (task results); arena values are never freed
+Void valueFree(ShipValue* v)
+{
+    if(v->type == SHIP_VALUE_STRING)
+    {
+        stringFree(&v->string);
+    }
+    else if(v->type == SHIP_VALUE_LIST)
+    {
+        for(Size i = 0; i < v->list.count; i++)
+        {
+            valueFree(&v->list.items[i]);
+        }
+        free(v->list.items);
+    }
+    *v = valueNull();
+}
+
+/// @brief 64-bit multiply-xorshift hash, consuming 8 bytes per step
+UInt64 hashBytes(UInt64 h, const Void* data, Size len)
+{
+    const UInt8* b = (const UInt8*)data;
+    h ^= len * 0xFF51AFD7ED558CCDULL;
+    while(len >= 8)
+    {
+        UInt64 w;
+        memcpy(&w, b, 8);
+        h = (h ^ w) * 0x100000001B3ULL;
+        h ^= h >> 29;
+        b += 8;
+        len -= 8;
+    }
+    UInt64 tail = 0;
+    if(len) memcpy(&tail, b, len);
+    h = (h ^ tail) * 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 32;
+    return h;
+}
+
+/// @brief Hash the content of a file; sets *ok to false if it can't be read
+UInt64 hashFile(CharSeq path, Bool* ok)
+{
+    UInt64 h = SHIP_HASH_SEED;
+    Int32 fd = open(path, O_RDONLY);
+    *ok = fd >= 0;
+    if(fd < 0)
+    {
+        return 0;
+    }
+    static __thread UInt8 buffer[1 << 16];
+    while(true)
+    {
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if(n < 0)
+        {
+            *ok = false;
+            break;
+        }
+        if(n == 0) break;
+        h = hashBytes(h, buffer, (Size)n);
+    }
+    close(fd);
+    return h;
+}
+
+static const UInt32 sha256_k[64] =
+{
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define SHA256_ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+/// @brief One 64-byte block of the SHA-256 compression function (FIPS 180-4)
+static Void sha256Block(ShipSha256* c, const UInt8* b)
+{
+    UInt32 w[64];
+    for(Int32 i = 0; i < 16; i++)
+    {
+        w[i] = (UInt32)b[i * 4] << 24 | (UInt32)b[i * 4 + 1] << 16 | (UInt32)b[i * 4 + 2] << 8 | (UInt32)b[i * 4 + 3];
+    }
+    for(Int32 i = 16; i < 64; i++)
+    {
+        UInt32 s0 = SHA256_ROTR(w[i - 15], 7) ^ SHA256_ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        UInt32 s1 = SHA256_ROTR(w[i - 2], 17) ^ SHA256_ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    UInt32 a = c->h[0], bb = c->h[1], cc = c->h[2], d = c->h[3];
+    UInt32 e = c->h[4], f = c->h[5], g = c->h[6], h = c->h[7];
+    for(Int32 i = 0; i < 64; i++)
+    {
+        UInt32 t1 = h + (SHA256_ROTR(e, 6) ^ SHA256_ROTR(e, 11) ^ SHA256_ROTR(e, 25)) + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+        UInt32 t2 = (SHA256_ROTR(a, 2) ^ SHA256_ROTR(a, 13) ^ SHA256_ROTR(a, 22)) + ((a & bb) ^ (a & cc) ^ (bb & cc));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = cc;
+        cc = bb;
+        bb = a;
+        a = t1 + t2;
+    }
+    c->h[0] += a;
+    c->h[1] += bb;
+    c->h[2] += cc;
+    c->h[3] += d;
+    c->h[4] += e;
+    c->h[5] += f;
+    c->h[6] += g;
+    c->h[7] += h;
+}
+
+Void sha256Init(ShipSha256* c)
+{
+    static const UInt32 iv[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+    memcpy(c->h, iv, sizeof(iv));
+    c->length = 0;
+    c->used = 0;
+}
+
+Void sha256Update(ShipSha256* c, const Void* data, Size len)
+{
+    const UInt8* b = (const UInt8*)data;
+    c->length += len;
+    if(c->used)
+    {
+        Size take = 64 - c->used < len ? 64 - c->used : len;
+        memcpy(c->block + c->used, b, take);
+        c->used += take;
+        b += take;
+        len -= take;
+        if(c->used < 64) return;
+        sha256Block(c, c->block);
+        c->used = 0;
+    }
+    for(; len >= 64; b += 64, len -= 64)
+    {
+        sha256Block(c, b);
+    }
+    memcpy(c->block, b, len);
+    c->used = len;
+}
+
+Void sha256Final(ShipSha256* c, ShipDigest* out)
+{
+    UInt64 bits = c->length * 8;
+    UInt8 pad = 0x80;
+    UInt8 zero = 0;
+    Size length = c->length;
+    sha256Update(c, &pad, 1);
+    while(c->used != 56) sha256Update(c, &zero, 1);
+    UInt8 tail[8];
+    for(Int32 i = 0; i < 8; i++) tail[i] = (UInt8)(bits >> (56 - i * 8));
+    sha256Update(c, tail, 8);
+    c->length = length;
+    for(Int32 i = 0; i < 8; i++)
+    {
+        out->bytes[i * 4] = (UInt8)(c->h[i] >> 24);
+        out->bytes[i * 4 + 1] = (UInt8)(c->h[i] >> 16);
+        out->bytes[i * 4 + 2] = (UInt8)(c->h[i] >> 8);
+        out->bytes[i * 4 + 3] = (UInt8)c->h[i];
+    }
+}
+
+/// @brief SHA-256 of a file's content; false if it can't be read
+Bool sha256File(CharSeq path, ShipDigest* out)
+{
+    Int32 fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+    {
+        return false;
+    }
+    ShipSha256 c;
+    sha256Init(&c);
+    static __thread UInt8 buffer[1 << 16];
+    Bool ok = true;
+    for(ssize_t n; (n = read(fd, buffer, sizeof(buffer))) != 0;)
+    {
+        if(n < 0 && errno == EINTR) continue;
+        if(n < 0)
+        {
+            ok = false;
+            break;
+        }
+        sha256Update(&c, buffer, (Size)n);
+    }
+    close(fd);
+    sha256Final(&c, out);
+    return ok;
+}
+
+/// @brief Iterate items of a comma or whitespace separated list
+Bool listNext(CharSeq* cursor, CharSeq* start, Size* len)
+{
+    CharSeq c = *cursor;
+    while(*c == ',' || isspace((UInt8)*c)) c++;
+    *start = c;
+    while(*c && *c != ',' && !isspace((UInt8)*c)) c++;
+    *len = (Size)(c - *start);
+    *cursor = c;
+    return *len > 0;
 }
 
-Void lexerInit(ShipLexer* l, CharSeq content)
+/// @brief The lexer borrows content; tokens are slices into it
+Void lexerInit(ShipLexer* l, ShipArena* arena, CharSeq content, Size length)
 {
-    l->text = stringFrom(content);
+    l->arena = arena;
+    l->text.data = (Int8*)content;
+    l->text.length = length;
+    l->text.capacity = 0;
     l->pos = 0;
     l->line = 1;
     l->col = 1;
@@ -242,32 +855,38 @@ Void lexerSkipWhitespace(ShipLexer* l)
     }
 }
 
-ShipString lexerReadString(ShipLexer* l, Int8 quote)
+/// @brief Read a quoted literal. Without escapes the token is a slice of the
+/// source; otherwise the unescaped content is materialized in the arena.
+Void lexerReadString(ShipLexer* l, Int8 quote, ShipToken* t)
 {
     lexerAdvance(l);
     Size start = l->pos;
+    Size end = start;
     Size len = 0;
-    Size temp_pos = l->pos;
-    while(temp_pos < l->text.length)
+    Bool escaped = false;
+    while(end < l->text.length && l->text.data[end] != quote)
     {
-        Int8 c = l->text.data[temp_pos];
-        if(c == quote)
-        {
-            break;
-        }
-        if(c == '\\')
+        if(l->text.data[end] == '\\')
         {
-            temp_pos++;
+            escaped = true;
+            end++;
         }
-        temp_pos++;
+        end++;
         len++;
     }
+    if(end > l->text.length) end = l->text.length;
 
-    ShipString s;
-    s.capacity = len + 100;
-    s.data = (Int8*)malloc(s.capacity);
-    Size out_idx = 0;
+    t->offset = start;
+    if(!escaped)
+    {
+        t->length = end - start;
+        while(l->pos < end) lexerAdvance(l);
+        lexerAdvance(l);
+        return;
+    }
 
+    Int8* out = (Int8*)arenaAlloc(l->arena, len + 1);
+    Size out_idx = 0;
     while(l->pos < l->text.length)
     {
         Int8 c = lexerPeek(l, 0);
@@ -279,33 +898,31 @@ ShipString lexerReadString(ShipLexer* l, Int8 quote)
         else if(c == '\\')
         {
             lexerAdvance(l);
-            Int8 escaped = lexerPeek(l, 0);
-            if(escaped == 'n') s.data[out_idx++] = '\n';
-            else if(escaped == 't') s.data[out_idx++] = '\t';
-            else s.data[out_idx++] = escaped;
+            Int8 escaped_char = lexerPeek(l, 0);
+            if(escaped_char == 'n') out[out_idx++] = '\n';
+            else if(escaped_char == 't') out[out_idx++] = '\t';
+            else out[out_idx++] = escaped_char;
             lexerAdvance(l);
         }
         else
         {
-            s.data[out_idx++] = c;
+            out[out_idx++] = c;
             lexerAdvance(l);
         }
     }
-    s.data[out_idx] = '\0';
-    s.length = out_idx;
-    return s;
+    out[out_idx] = '\0';
+    t->text = out;
+    t->length = out_idx;
 }
 
-ShipString lexerReadIdent(ShipLexer* l)
+Void lexerReadIdent(ShipLexer* l, ShipToken* t)
 {
-    Size start = l->pos;
-    Size len = 0;
+    t->offset = l->pos;
     while(l->pos < l->text.length)
     {
         Int8 c = lexerPeek(l, 0);
         if(isalnum(c) || c == '_' || c == '-' || c == '.' || c == '/')
         {
-            len++;
             lexerAdvance(l);
         }
         else
@@ -313,21 +930,39 @@ ShipString lexerReadIdent(ShipLexer* l)
             break;
         }
     }
+    t->length = l->pos - t->offset;
+}
+
+/// @brief Token content: the materialized text or the source slice (not NUL-terminated)
+ShipString tokenText(ShipTokenList* tokens, ShipToken* t)
+{
     ShipString s;
-    s.length = len;
-    s.capacity = len + 1;
-    s.data = (Int8*)malloc(s.capacity);
-    strncpy(s.data, l->text.data + start, len);
-    s.data[len] = '\0';
+    s.data = t->text ? t->text : (Int8*)tokens->source + t->offset;
+    s.length = t->length;
+    s.capacity = 0;
     return s;
 }
 
+Bool tokenIs(ShipTokenList* tokens, ShipToken* t, CharSeq word)
+{
+    Size len = strlen(word);
+    return t->length == len && memcmp(tokenText(tokens, t).data, word, len) == 0;
+}
+
+Bool lexerSliceIs(ShipLexer* l, ShipToken* t, CharSeq word)
+{
+    Size len = strlen(word);
+    return t->length == len && memcmp(l->text.data + t->offset, word, len) == 0;
+}
+
 ShipToken lexerNext(ShipLexer* l)
 {
     lexerSkipWhitespace(l);
     ShipToken t;
     t.line = l->line;
-    t.value = stringFrom("");
+    t.offset = l->pos;
+    t.length = 0;
+    t.text = null;
     t.bool_value = false;
     t.number_value = 0;
 
@@ -339,49 +974,47 @@ ShipToken lexerNext(ShipLexer* l)
 
     Int8 c = lexerPeek(l, 0);
     Int8 n = lexerPeek(l, 1);
+    t.length = 2;
 
-    if(c == '=' && n == '=')
+    if(c == '=' && n == '=') t.type = TOKEN_EQ;
+    else if(c == '!' && n == '=') t.type = TOKEN_NE;
+    else if(c == '<' && n == '=') t.type = TOKEN_LE;
+    else if(c == '>' && n == '=') t.type = TOKEN_GE;
+    else if(c == '&' && n == '&') t.type = TOKEN_AND;
+    else if(c == '|' && n == '|') t.type = TOKEN_OR;
+    else
     {
-        t.type = TOKEN_EQ;
-        t.value = stringFrom("==");
-        lexerAdvance(l);
-        lexerAdvance(l);
+        t.length = 1;
+        if(c == '{') t.type = TOKEN_LBRACE;
+        else if(c == '}') t.type = TOKEN_RBRACE;
+        else if(c == '(') t.type = TOKEN_LPAREN;
+        else if(c == ')') t.type = TOKEN_RPAREN;
+        else if(c == '[') t.type = TOKEN_LBRACKET;
+        else if(c == ']') t.type = TOKEN_RBRACKET;
+        else if(c == ':') t.type = TOKEN_COLON;
+        else if(c == ',') t.type = TOKEN_COMMA;
+        else if(c == '=') t.type = TOKEN_EQUALS;
+        else if(c == '<') t.type = TOKEN_LT;
+        else if(c == '>') t.type = TOKEN_GT;
+        else if(c == '!') t.type = TOKEN_NOT;
+        else t.length = 0;
     }
-    else if(c == '!' && n == '=')
+    if(t.length > 0)
     {
-        t.type = TOKEN_NE;
-        t.value = stringFrom("!=");
-        lexerAdvance(l);
-        lexerAdvance(l);
+        for(Size i = 0; i < t.length; i++) lexerAdvance(l);
+        return t;
     }
-    else if(c == '<' && n == '=') { t.type = TOKEN_LE; t.value = stringFrom("<="); lexerAdvance(l); lexerAdvance(l); }
-    else if(c == '>' && n == '=') { t.type = TOKEN_GE; t.value = stringFrom(">="); lexerAdvance(l); lexerAdvance(l); }
-    else if(c == '&' && n == '&') { t.type = TOKEN_AND; t.value = stringFrom("&&"); lexerAdvance(l); lexerAdvance(l); }
-    else if(c == '|' && n == '|')
-    {
-        t.type = TOKEN_OR; t.value = stringFrom("||"); lexerAdvance(l); lexerAdvance(l); }
-    else if(c == '{') { t.type = TOKEN_LBRACE; t.value = stringFrom("{"); lexerAdvance(l); }
-    else if(c == '}') { t.type = TOKEN_RBRACE; t.value = stringFrom("}"); lexerAdvance(l); }
-    else if(c == '(') { t.type = TOKEN_LPAREN; t.value = stringFrom("("); lexerAdvance(l); }
-    else if(c == ')') { t.type = TOKEN_RPAREN; t.value = stringFrom(")"); lexerAdvance(l); }
-    else if(c == ':') { t.type = TOKEN_COLON; t.value = stringFrom(":"); lexerAdvance(l); }
-    else if(c == ',') { t.type = TOKEN_COMMA; t.value = stringFrom(","); lexerAdvance(l); }
-    else if(c == '=') { t.type = TOKEN_EQUALS; t.value = stringFrom("="); lexerAdvance(l); }
-    else if(c == '<') { t.type = TOKEN_LT; t.value = stringFrom("<"); lexerAdvance(l); }
-    else if(c == '>') { t.type = TOKEN_GT; t.value = stringFrom(">"); lexerAdvance(l); }
-    else if(c == '!') { t.type = TOKEN_NOT; t.value = stringFrom("!"); lexerAdvance(l); }
-    else if(c == '"' || c == '\'')
+
+    if(c == '"' || c == '\'')
     {
         t.type = TOKEN_STRING;
-        stringFree(&t.value);
-        t.value = lexerReadString(l, c);
+        lexerReadString(l, c, &t);
     }
     else if(c == '$')
     {
         lexerAdvance(l);
         t.type = TOKEN_CUSTOM;
-        stringFree(&t.value);
-        t.value = lexerReadIdent(l);
+        lexerReadIdent(l, &t);
     }
     else if(isdigit(c) || (c == '-' && isdigit(n)))
     {
@@ -397,55 +1030,61 @@ ShipToken lexerNext(ShipLexer* l)
         }
         Size len = l->pos - start;
         Int8 buf[64];
-        strncpy(buf, l->text.data + start, len < 63 ? len : 63);
+        memcpy(buf, l->text.data + start, len < 63 ? len : 63);
         buf[len < 63 ? len : 63] = 0;
         t.number_value = atof(buf);
         if(neg) t.number_value = -t.number_value;
+        t.length = l->pos - t.offset;
     }
     else if(isalpha(c) || c == '_')
     {
-        ShipString id = lexerReadIdent(l);
-        if(strcmp(id.data, "true") == 0 || strcmp(id.data, "True") == 0)
+        lexerReadIdent(l, &t);
+        if(lexerSliceIs(l, &t, "true") || lexerSliceIs(l, &t, "True"))
         {
             t.type = TOKEN_BOOL; t.bool_value = true;
         }
-        else if(strcmp(id.data, "false") == 0 || strcmp(id.data, "False") == 0)
+        else if(lexerSliceIs(l, &t, "false") || lexerSliceIs(l, &t, "False"))
         {
             t.type = TOKEN_BOOL; t.bool_value = false;
         }
-        else if(strcmp(id.data, "null") == 0 || strcmp(id.data, "none") == 0)
+        else if(lexerSliceIs(l, &t, "null") || lexerSliceIs(l, &t, "none"))
         {
             t.type = TOKEN_NULL;
         }
         else
         {
             t.type = TOKEN_IDENT;
-            stringFree(&t.value);
-            t.value = id;
-            return t;
         }
-        stringFree(&id);
     }
     else
     {
+        // Unknown character: skip it and lex the next token
         lexerAdvance(l);
+        return lexerNext(l);
     }
     return t;
 }
 
-ShipVector tokenize(CharSeq content)
+/// @brief Lex the whole script into one contiguous token array
+ShipTokenList tokenize(ShipArena* arena, CharSeq content, Size length)
 {
-    ShipVector tokens;
-    vectorInit(&tokens);
+    ShipTokenList tokens;
+    tokens.source = content;
+    tokens.length = 0;
+    tokens.capacity = length / 4 + 16;
+    tokens.data = (ShipToken*)malloc(tokens.capacity * sizeof(ShipToken));
     ShipLexer l;
-    lexer_init(&l, content);
+    lexerInit(&l, arena, content, length);
     while(true)
     {
-        ShipToken t = lexerNext(&l);
-        ShipToken* tp = (ShipToken*)malloc(sizeof(ShipToken));
-        *tp = t;
-        vectorPush(&tokens, tp);
-        if(t.type == TOKEN_EOF)
+        if(tokens.length == tokens.capacity)
+        {
+            tokens.capacity *= 2;
+            tokens.data = (ShipToken*)realloc(tokens.data, tokens.capacity * sizeof(ShipToken));
+        }
+        ShipToken* t = &tokens.data[tokens.length++];
+        *t = lexerNext(&l);
+        if(t->type == TOKEN_EOF)
         {
             break;
         }
@@ -453,13 +1092,16 @@ ShipVector tokenize(CharSeq content)
     return tokens;
 }
 
-Void parserInit(ShipParser* p, ShipVector tokens)
+Void parserInit(ShipParser* p, ShipTokenList tokens, ShipArena* arena)
 {
+    p->arena = arena;
     p->tokens = tokens;
     p->pos = 0;
-    mapInit(&p->variables);
+    mapInitArena(&p->variables, arena);
     vectorInit(&p->tasks);
-    p->title = stringFrom("Ship Build");
+    p->title = stringView("Ship Build");
+    p->group_count = 0;
+    p->failed = false;
 }
 
 ShipToken* parserPeek(ShipParser* p, Int32 offset)
@@ -467,14 +1109,14 @@ ShipToken* parserPeek(ShipParser* p, Int32 offset)
     Size idx = p->pos + offset;
     if(idx >= p->tokens.length)
     {
-        return (ShipToken*)p->tokens.data[p->tokens.length - 1];
+        return &p->tokens.data[p->tokens.length - 1];
     }
-    return (ShipToken*)p->tokens.data[idx];
+    return &p->tokens.data[idx];
 }
 
 ShipToken* parserCurrent(ShipParser* p)
 {
-    return parser_peek(p, 0);
+    return parserPeek(p, 0);
 }
 
 Void parserAdvance(ShipParser* p)
@@ -490,79 +1132,282 @@ Void parserExpect(ShipParser* p, ShipTokenType type)
         fprintf(stderr, FAIL "Syntax Error: Expected token type %d but got %d at line %d\n" ENDC, type, t->type, t->line);
         exit(1);
     }
-    parseAdvance(p);
+    parserAdvance(p);
 }
 
-Any parserParseExpression(ShipParser* p);
+ShipValue parserParseExpression(ShipParser* p);
+ShipExpr* parserParseBinary(ShipParser* p, Int32 min_prec);
 Void parserSkipBlock(ShipParser* p);
 ShipVector parserParseBlockBody(ShipParser* p);
 
-Any parser_resolve(ShipParser* p, ShipString name)
+ShipValue parser_resolve(ShipParser* p, ShipString name)
 {
-    Any val = mapGet(&p->variables, name);
-    if(val) return val;
-    ShipString* s = (ShipString*)malloc(sizeof(ShipString));
-    *s = stringFrom(name.data);
-    return s;
+    ShipValue* val = mapGet(&p->variables, name);
+    if(val) return *val;
+    return valueFromString(arenaString(p->arena, name.data, name.length));
+}
+
+/// @brief Parse `[a, b, ...]` after the opening bracket into an arena list
+ShipValue parserParseList(ShipParser* p)
+{
+    ShipValue* items = null;
+    Size count = 0;
+    Size capacity = 0;
+    while(parserCurrent(p)->type != TOKEN_RBRACKET && parserCurrent(p)->type != TOKEN_EOF)
+    {
+        ShipValue item = parserParseExpression(p);
+        if(count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 8;
+            items = (ShipValue*)realloc(items, capacity * sizeof(ShipValue));
+        }
+        items[count++] = item;
+        if(parserCurrent(p)->type == TOKEN_COMMA)
+        {
+            parserAdvance(p);
+        }
+    }
+    parserExpect(p, TOKEN_RBRACKET);
+    ShipValue v = valueNull();
+    v.type = SHIP_VALUE_LIST;
+    v.list.count = count;
+    v.list.items = (ShipValue*)arenaAlloc(p->arena, (count ? count : 1) * sizeof(ShipValue));
+    if(count) memcpy(v.list.items, items, count * sizeof(ShipValue));
+    free(items);
+    return v;
 }
 
-Any parserParsePrimary(ShipParser* p)
+ShipValue parserParsePrimary(ShipParser* p)
 {
     ShipToken* t = parserCurrent(p);
-    parseAdvance(p);
+    parserAdvance(p);
     if(t->type == TOKEN_STRING)
     {
-        ShipString* s = (ShipString*)malloc(sizeof(ShipString));
-        *s = stringFrom(t->value.data);
-        return s;
+        ShipString text = tokenText(&p->tokens, t);
+        return valueFromString(t->text ? text : arenaString(p->arena, text.data, text.length));
     }
     if(t->type == TOKEN_NUMBER)
     {
-        Float64* f = (Float64*)malloc(sizeof(Float64));
-        *f = t->number_value;
-        return f;
+        return valueFromNumber(t->number_value);
     }
     if(t->type == TOKEN_BOOL)
     {
-        Bool* b = (Bool*)malloc(sizeof(Bool));
-        *b = t->bool_value;
-        return b;
+        return valueFromBool(t->bool_value);
+    }
+    if(t->type == TOKEN_NULL)
+    {
+        return valueNull();
     }
-    if(t->type == TOKEN_NULL) return null;
     if(t->type == TOKEN_IDENT)
     {
-        Any v = mapGet(&p->variables, t->value);
-        if(v)
+        return parser_resolve(p, tokenText(&p->tokens, t));
+    }
+    if(t->type == TOKEN_LBRACKET)
+    {
+        return parserParseList(p);
+    }
+    return valueNull();
+}
+
+/// @brief Expression implementations
+ShipExpr* exprConst(ShipArena* arena, ShipValue v)
+{
+    ShipExpr* e = (ShipExpr*)arenaAlloc(arena, sizeof(ShipExpr));
+    memset(e, 0, sizeof(ShipExpr));
+    e->op = SHIP_EXPR_CONST;
+    e->value = v;
+    return e;
+}
+
+/// @brief Build an operator node; folding waits for exprFold so that the
+/// right side of && and || is never touched before the left is known
+ShipExpr* exprMake(ShipArena* arena, ShipExprOp op, Int32 line, ShipExpr* left, ShipExpr* right)
+{
+    ShipExpr* e = exprConst(arena, valueNull());
+    e->op = op;
+    e->line = line;
+    e->left = left;
+    e->right = right;
+    return e;
+}
+
+/// @brief Fold a finished tree bottom-up into constants where its operands
+/// allow. `false && x` and `true || x` fold without folding x, so a dead
+/// operand is neither evaluated nor able to raise an error.
+ShipExpr* exprFold(ShipExpr* e, Bool* failed)
+{
+    if(e->op == SHIP_EXPR_CONST)
+    {
+        return e;
+    }
+    e->left = exprFold(e->left, failed);
+    if(e->left->op == SHIP_EXPR_CONST && (e->op == SHIP_EXPR_AND || e->op == SHIP_EXPR_OR))
+    {
+        Bool l = valueTruthy(&e->left->value);
+        if(l == (e->op == SHIP_EXPR_OR))
         {
-            return v;
+            e->op = SHIP_EXPR_CONST;
+            e->value = valueFromBool(l);
+            e->left = null;
+            e->right = null;
+            return e;
         }
-        ShipString* s = (ShipString*)malloc(sizeof(ShipString));
-        *s = stringFrom(t->value.data);
-        return s;
     }
-    if(t->type == TOKEN_LPAREN)
+    if(e->right)
+    {
+        e->right = exprFold(e->right, failed);
+    }
+    if(e->left->op == SHIP_EXPR_CONST && (!e->right || e->right->op == SHIP_EXPR_CONST))
+    {
+        e->value = exprEval(e, failed);
+        e->op = SHIP_EXPR_CONST;
+        e->left = null;
+        e->right = null;
+    }
+    return e;
+}
+
+/// @brief Order two values for <, <=, >, >=; numbers and bools numerically,
+/// strings bytewise. Mixed kinds are reported as a script error at line,
+/// set *failed and compare equal so that parsing can carry on.
+Int32 exprCompare(ShipValue* a, ShipValue* b, Int32 line, Bool* failed)
+{
+    Bool a_num = a->type == SHIP_VALUE_NUMBER || a->type == SHIP_VALUE_BOOL;
+    Bool b_num = b->type == SHIP_VALUE_NUMBER || b->type == SHIP_VALUE_BOOL;
+    if(a_num && b_num)
+    {
+        Float64 x = valueAsNumber(a, a->boolean);
+        Float64 y = valueAsNumber(b, b->boolean);
+        return x < y ? -1 : x > y ? 1 : 0;
+    }
+    if(a->type == SHIP_VALUE_STRING && b->type == SHIP_VALUE_STRING)
+    {
+        Size n = a->string.length < b->string.length ? a->string.length : b->string.length;
+        Int32 c = memcmp(a->string.data, b->string.data, n);
+        if(c != 0) return c;
+        return a->string.length < b->string.length ? -1 : a->string.length > b->string.length ? 1 : 0;
+    }
+    static CharSeq names[] = { "null", "string", "number", "bool", "list", "pointer" };
+    fprintf(stderr, FAIL "Error: Cannot compare %s with %s at line %d\n" ENDC, names[a->type], names[b->type], line);
+    *failed = true;
+    return 0;
+}
+
+/// @brief Evaluate a compiled expression; && and || short-circuit
+ShipValue exprEval(ShipExpr* e, Bool* failed)
+{
+    if(e->op == SHIP_EXPR_CONST)
+    {
+        return e->value;
+    }
+    ShipValue l = exprEval(e->left, failed);
+    switch(e->op)
+    {
+        case SHIP_EXPR_NOT:
+            return valueFromBool(!valueTruthy(&l));
+        case SHIP_EXPR_AND:
+            if(!valueTruthy(&l)) return valueFromBool(false);
+            l = exprEval(e->right, failed);
+            return valueFromBool(valueTruthy(&l));
+        case SHIP_EXPR_OR:
+            if(valueTruthy(&l)) return valueFromBool(true);
+            l = exprEval(e->right, failed);
+            return valueFromBool(valueTruthy(&l));
+        default:
+            break;
+    }
+    ShipValue r = exprEval(e->right, failed);
+    switch(e->op)
+    {
+        case SHIP_EXPR_EQ: return valueFromBool(valueEquals(&l, &r));
+        case SHIP_EXPR_NE: return valueFromBool(!valueEquals(&l, &r));
+        case SHIP_EXPR_LT: return valueFromBool(exprCompare(&l, &r, e->line, failed) < 0);
+        case SHIP_EXPR_LE: return valueFromBool(exprCompare(&l, &r, e->line, failed) <= 0);
+        case SHIP_EXPR_GT: return valueFromBool(exprCompare(&l, &r, e->line, failed) > 0);
+        case SHIP_EXPR_GE: return valueFromBool(exprCompare(&l, &r, e->line, failed) >= 0);
+        default: return valueNull();
+    }
+}
+
+/// @brief Binary operator for a token, or CONST when the token is not one
+ShipExprOp exprBinaryOp(ShipTokenType type)
+{
+    switch(type)
+    {
+        case TOKEN_OR: return SHIP_EXPR_OR;
+        case TOKEN_AND: return SHIP_EXPR_AND;
+        case TOKEN_EQ: return SHIP_EXPR_EQ;
+        case TOKEN_NE: return SHIP_EXPR_NE;
+        case TOKEN_LT: return SHIP_EXPR_LT;
+        case TOKEN_LE: return SHIP_EXPR_LE;
+        case TOKEN_GT: return SHIP_EXPR_GT;
+        case TOKEN_GE: return SHIP_EXPR_GE;
+        default: return SHIP_EXPR_CONST;
+    }
+}
+
+/// @brief Binding power: || < && < comparisons; 0 for non-operators
+Int32 exprPrecedence(ShipExprOp op)
+{
+    switch(op)
+    {
+        case SHIP_EXPR_OR: return 1;
+        case SHIP_EXPR_AND: return 2;
+        case SHIP_EXPR_CONST:
+        case SHIP_EXPR_NOT: return 0;
+        default: return 3;
+    }
+}
+
+/// @brief Operand: `!` operand, `( expr )`, or a primary value
+ShipExpr* parserParseUnary(ShipParser* p)
+{
+    ShipTokenType type = parserCurrent(p)->type;
+    if(type == TOKEN_NOT)
+    {
+        Int32 line = parserCurrent(p)->line;
+        parserAdvance(p);
+        return exprMake(p->arena, SHIP_EXPR_NOT, line, parserParseUnary(p), null);
+    }
+    if(type == TOKEN_LPAREN)
     {
-        Any val = parserParseExpression(p);
+        parserAdvance(p);
+        ShipExpr* e = parserParseBinary(p, 1);
         parserExpect(p, TOKEN_RPAREN);
-        return val;
+        return e;
     }
-    return null;
+    return exprConst(p->arena, parserParsePrimary(p));
 }
 
-Bool toBool(Any val)
+/// @brief Precedence climbing over the binary operators; left associative
+ShipExpr* parserParseBinary(ShipParser* p, Int32 min_prec)
 {
-    return !val ? false : true;
+    ShipExpr* left = parserParseUnary(p);
+    for(;;)
+    {
+        ShipExprOp op = exprBinaryOp(parserCurrent(p)->type);
+        Int32 prec = exprPrecedence(op);
+        if(prec == 0 || prec < min_prec)
+        {
+            break;
+        }
+        Int32 line = parserCurrent(p)->line;
+        parserAdvance(p);
+        left = exprMake(p->arena, op, line, left, parserParseBinary(p, prec + 1));
+    }
+    return left;
 }
 
-Any parserParseExpression(ShipParser* p)
+ShipValue parserParseExpression(ShipParser* p)
 {
-    return parserParsePrimary(p);
+    return exprEval(exprFold(parserParseBinary(p, 1), &p->failed), &p->failed);
 }
 
-ShipMap parserParseFuncArgs(ShipParser* p)
+ShipMap parserParseFuncArgs(ShipParser* p, UInt64* args_hash)
 {
     ShipMap args;
-    mapInit(&args);
+    mapInitArena(&args, p->arena);
+    *args_hash = SHIP_HASH_SEED;
     parserExpect(p, TOKEN_LBRACE);
     while(parserCurrent(p)->type != TOKEN_RBRACE)
     {
@@ -572,20 +1417,21 @@ ShipMap parserParseFuncArgs(ShipParser* p)
             fprintf(stderr, "Expected arg name\n");
             exit(1);
         }
-        ShipString key = stringFrom(key_tok->value.data);
-        parseAdvance(p);
+        ShipString key = tokenText(&p->tokens, key_tok);
+        parserAdvance(p);
         if(parserCurrent(p)->type != TOKEN_COLON)
         {
             fprintf(stderr, "Expected : after arg name\n");
             exit(1);
         }
-        parseAdvance(p);
-        Any val = parserParseExpression(p);
+        parserAdvance(p);
+        ShipValue val = parserParseExpression(p);
         mapSet(&args, key, val);
-        stringFree(&key);
+        *args_hash = hashBytes(*args_hash, key.data, key.length);
+        *args_hash = valueHash(*args_hash, &val);
         if(parserCurrent(p)->type == TOKEN_COMMA)
         {
-            parseAdvance(p);
+            parserAdvance(p);
         }
     }
     parserExpect(p, TOKEN_RBRACE);
@@ -600,24 +1446,24 @@ Void parserParseVarBlock(ShipParser* p)
         ShipToken* name_tok = parserCurrent(p);
         if(name_tok->type != TOKEN_IDENT)
         {
-            parseAdvance(p);
+            parserAdvance(p);
             continue;
         }
-        ShipString name = stringFrom(name_tok->value.data);
-        parseAdvance(p);
+        ShipString name = tokenText(&p->tokens, name_tok);
+        parserAdvance(p);
 
         if(parserCurrent(p)->type != TOKEN_EQUALS)
         {
-            parseAdvance(p);
+            parserAdvance(p);
             continue;
         }
-        parseAdvance(p);
+        parserAdvance(p);
 
-        Any val = parserParseExpression(p);
+        ShipValue val = parserParseExpression(p);
         mapSet(&p->variables, name, val);
         if(parserCurrent(p)->type == TOKEN_COMMA)
         {
-            parseAdvance(p);
+            parserAdvance(p);
         }
     }
     parserExpect(p, TOKEN_RBRACE);
@@ -637,10 +1483,30 @@ Void parserSkipBlock(ShipParser* p)
         {
             depth--;
         }
-        parseAdvance(p);
+        parserAdvance(p);
     }
 }
 
+/// @brief Parse `if cond { ... }` after the `if` keyword; a false condition
+/// skips the block by brace matching without parsing it
+Void parserParseIf(ShipParser* p, ShipVector* tasks)
+{
+    ShipValue cond = parserParseExpression(p);
+    parserExpect(p, TOKEN_LBRACE);
+    if(!valueTruthy(&cond))
+    {
+        parserSkipBlock(p);
+        return;
+    }
+    ShipVector block = parserParseBlockBody(p);
+    for(Size i = 0; i < block.length; i++)
+    {
+        vectorPush(tasks, block.data[i]);
+    }
+    free(block.data);
+    parserExpect(p, TOKEN_RBRACE);
+}
+
 ShipVector parserParseBlockBody(ShipParser* p)
 {
     ShipVector tasks;
@@ -650,45 +1516,54 @@ ShipVector parserParseBlockBody(ShipParser* p)
         ShipToken* t = parserCurrent(p);
         if(t->type == TOKEN_IDENT)
         {
-            ShipString ident = t->value;
-            parseAdvance(p);
+            ShipRegistryEntry* entry = registryLookup(tokenText(&p->tokens, t).data, t->length);
+            parserAdvance(p);
 
-            if(strcmp(ident.data, "title") == 0)
+            if(tokenIs(&p->tokens, t, "title"))
             {
-                if(parserCurrent(p)->type == TOKEN_COLON) parseAdvance(p);
-                Any val = parserParseExpression(p);
-                if(val) p->title = stringFrom(((ShipString*)val)->data);
+                if(parserCurrent(p)->type == TOKEN_COLON) parserAdvance(p);
+                ShipValue val = parserParseExpression(p);
+                if(val.type == SHIP_VALUE_STRING)
+                {
+                    p->title = val.string;
+                }
+                else if(val.type != SHIP_VALUE_NULL)
+                {
+                    ShipString text = valueToString(&val);
+                    p->title = arenaString(p->arena, text.data, text.length);
+                    stringFree(&text);
+                }
             }
-            else if(strcmp(ident.data, "var") == 0)
+            else if(tokenIs(&p->tokens, t, "var"))
             {
                 parserParseVarBlock(p);
             }
-            else if(strcmp(ident.data, "if") == 0)
+            else if(tokenIs(&p->tokens, t, "if"))
+            {
+                parserParseIf(p, &tasks);
+            }
+            else if(tokenIs(&p->tokens, t, "parallel"))
             {
-                Any cond = parserParseExpression(p);
                 parserExpect(p, TOKEN_LBRACE);
-                if(toBool(cond))
+                Int32 group = ++p->group_count;
+                ShipVector block = parserParseBlockBody(p);
+                for(Size i = 0; i < block.length; i++)
                 {
-                    ShipVector block = parserParseBlockBody(p);
-                    for(Size i=0; i<block.length; i++)
-                    {
-                        vectorPush(&tasks, block.data[i]);
-                    }
-                }
-                else
-                {
-                    parserSkipBlock(p);
+                    ((ShipTask*)block.data[i])->group = group;
+                    vectorPush(&tasks, block.data[i]);
                 }
-                if(parserCurrent(p)->type == TOKEN_RBRACE) parseAdvance(p);
+                free(block.data);
+                parserExpect(p, TOKEN_RBRACE);
             }
-            else if(registryExists(ident.data))
+            else if(entry)
             {
-                ShipFunc func = registryGet(ident.data);
-                ShipMap args = parserParseFuncArgs(p);
-                ShipTask* tsk = (ShipTask*) malloc(sizeof(ShipTask));
+                ShipFunc func = entry->func;
+                ShipTask* tsk = (ShipTask*) arenaAlloc(p->arena, sizeof(ShipTask));
+                memset(tsk, 0, sizeof(ShipTask));
+                ShipMap args = parserParseFuncArgs(p, &tsk->args_hash);
                 tsk->func = func;
                 tsk->args = args;
-                tsk->task_name = stringFrom(ident.data);
+                tsk->task_name = entry->name;
                 tsk->is_custom = false;
                 vectorPush(&tasks, tsk);
             }
@@ -696,36 +1571,37 @@ ShipVector parserParseBlockBody(ShipParser* p)
             {
                 if(parserCurrent(p)->type == TOKEN_LBRACE)
                 {
-                    parseAdvance(p);
+                    parserAdvance(p);
                     parserSkipBlock(p);
                 }
             }
         }
         else if(t->type == TOKEN_CUSTOM)
         {
-             ShipString name = t->value;
-             parseAdvance(p);
+             ShipString name = tokenText(&p->tokens, t);
+             parserAdvance(p);
              if(parserCurrent(p)->type == TOKEN_LBRACE)
              {
-                 parseAdvance(p);
+                 parserAdvance(p);
                  parserSkipBlock(p);
              }
-             printf(DIM "Custom task: $%s\n" ENDC, name.data);
+             printf(DIM "Custom task: $%.*s\n" ENDC, (Int32)name.length, name.data);
         }
         else
         {
-            parseAdvance(p);
+            parserAdvance(p);
         }
     }
     return tasks;
 }
 
-Void parserParse(ShipParser* p)
+/// @brief Parse the whole script; false when an expression reported an error
+Bool parserParse(ShipParser* p)
 {
     ShipToken* t = parserCurrent(p);
-    if(t->type == TOKEN_IDENT && strcmp(t->value.data, "ship") == 0)
+    if(t->type == TOKEN_IDENT && tokenIs(&p->tokens, t, "ship"))
     {
-        parseAdvance(p);
+        parserAdvance(p);
         parserExpect(p, TOKEN_LBRACE);
         p->tasks = parserParseBlockBody(p);
         parserExpect(p, TOKEN_RBRACE);
@@ -734,225 +1610,6790 @@ Void parserParse(ShipParser* p)
     {
         p->tasks = parserParseBlockBody(p);
     }
+    return !p->failed;
 }
 
-ShipResult shipRun(ShipMap args)
+/// @brief Join a directory and an entry name with a single separator
+Int8* pathJoin(CharSeq dir, CharSeq name)
 {
-    ShipString* cmd = (ShipString*) mapGet(&args, stringFrom("command"));
-    ShipResult res;
-    res.stdout_str = stringEmpty();
-    res.stderr_str = stringEmpty();
-    if(!cmd)
-    {
-        res.returncode = -1;
-        return res;
-    }
-    res.returncode = system(cmd->data);
-    return res;
+    Size dl = strlen(dir);
+    Size nl = strlen(name);
+    while(dl > 1 && dir[dl - 1] == '/') dl--;
+    Int8* out = (Int8*)malloc(dl + nl + 2);
+    memcpy(out, dir, dl);
+    out[dl] = '/';
+    memcpy(out + dl + 1, name, nl + 1);
+    return out;
 }
 
-ShipResult shipDelete(ShipMap args)
+/// @brief Create every missing parent directory of path (like mkdir -p on dirname)
+Bool pathMakeParents(CharSeq path)
 {
-    ShipString* path = (ShipString*) mapGet(&args, stringFrom("path"));
-    ShipResult res;
-    res.returncode = 0;
-    res.stdout_str = stringFrom("");
-    res.stderr_str = stringFrom("");
-    if(path)
+    Int8* buf = stringFrom(path).data;
+    Bool ok = true;
+    for(Int8* c = buf + 1; *c; c++)
     {
-        Int8 buffer[1024];
-        snprintf(buffer, 1024, "rm -rf \"%s\"", path->data);
-        res.returncode = system(buffer);
+        if(*c != '/') continue;
+        *c = '\0';
+        if(mkdir(buf, 0755) != 0 && errno != EEXIST)
+        {
+            ok = false;
+        }
+        *c = '/';
     }
-    return res;
+    free(buf);
+    return ok;
 }
 
-ShipResult shipMkdir(ShipMap args)
+/// @brief Whether path, which need not exist yet, resolves to root or below it
+Bool pathWithin(CharSeq path, CharSeq root)
 {
-    ShipString* path = (ShipString*) mapGet(&args, stringFrom("path"));
-    ShipResult res;
-    res.returncode = 0;
-    res.stdout_str = stringFrom("");
-    res.stderr_str = stringFrom("");
-    if(path)
+    Int8 base[PATH_MAX];
+    Int8 resolved[PATH_MAX];
+    if(!realpath(root, base))
     {
-        Int8 buffer[1024];
-        snprintf(buffer, 1024, "mkdir -p \"%s\"", path->data);
-        res.returncode = system(buffer);
+        return false;
     }
-    return res;
+    // resolve the longest prefix that exists; the rest is created later as
+    // plain directories, so it can be applied lexically
+    Int8* probe = stringFrom(path).data;
+    Size keep = strlen(probe);
+    while(!realpath(keep ? probe : ".", resolved))
+    {
+        if(keep == 0)
+        {
+            free(probe);
+            return false;
+        }
+        while(keep > 0 && probe[keep - 1] == '/') keep--;
+        while(keep > 0 && probe[keep - 1] != '/') keep--;
+        probe[keep] = '\0';
+    }
+    CharSeq rest = path + keep;
+    while(*rest)
+    {
+        Size n = strcspn(rest, "/");
+        if(n == 2 && rest[0] == '.' && rest[1] == '.')
+        {
+            Int8* slash = strrchr(resolved, '/');
+            slash[slash == resolved ? 1 : 0] = '\0';
+        }
+        else if(n > 0 && !(n == 1 && rest[0] == '.'))
+        {
+            Size len = strlen(resolved);
+            if(len + n + 2 > sizeof(resolved))
+            {
+                break;
+            }
+            if(len > 1) resolved[len++] = '/';
+            memcpy(resolved + len, rest, n);
+            resolved[len + n] = '\0';
+        }
+        rest += n;
+        while(*rest == '/') rest++;
+    }
+    free(probe);
+    Size bl = strlen(base);
+    return strncmp(resolved, base, bl) == 0 && (resolved[bl] == '\0' || resolved[bl] == '/' || bl == 1);
 }
 
-ShipResult shipCopy(ShipMap args)
+Any poolWorker(Any arg)
 {
-    ShipString* src = (ShipString*) mapGet(&args, stringFrom("src"));
-    ShipString* dst = (ShipString*) mapGet(&args, stringFrom("dst"));
-    ShipResult res = {0};
-    res.returncode = 0;
-    res.stdout_str = stringFrom("");
-    res.stderr_str = stringFrom("");
-    if(src && dst)
+    ShipPool* pool = (ShipPool*)arg;
+    pthread_mutex_lock(&pool->lock);
+    while(true)
     {
-        Int8 buffer[2048];
-        snprintf(buffer, 2048, "cp -r \"%s\" \"%s\"", src->data, dst->data);
-        res.returncode = system(buffer);
+        while(pool->count == 0 && !pool->stopping)
+        {
+            pthread_cond_wait(&pool->work, &pool->lock);
+        }
+        if(pool->count == 0)
+        {
+            break;
+        }
+        ShipJob job = pool->jobs[pool->head];
+        pool->head = (pool->head + 1) % pool->capacity;
+        pool->count--;
+        pthread_mutex_unlock(&pool->lock);
+
+        job.func(job.arg);
+
+        pthread_mutex_lock(&pool->lock);
+        if(--pool->active == 0)
+        {
+            pthread_cond_broadcast(&pool->idle);
+        }
     }
-    return res;
+    // every pool belongs to one task, so the thread's lifetime totals are
+    // exactly what it spent on that task
+    ShipUsage spent = usageThread();
+    usageAdd(&pool->usage, &spent);
+    pthread_mutex_unlock(&pool->lock);
+    return null;
 }
-ShipResult shipMove(ShipMap args)
+
+Void poolInit(ShipPool* pool, Size threads)
 {
-    ShipString* src = (ShipString*) mapGet(&args, stringFrom("src"));
-    ShipString* dst = (ShipString*) mapGet(&args, stringFrom("dst"));
-    ShipResult res = {0};
-    res.returncode = 0;
-    res.stdout_str = stringFrom("");
-    res.stderr_str = stringFrom("");
-    if(src && dst)
+    pool->thread_count = threads > 0 ? threads : 1;
+    pool->threads = (pthread_t*)malloc(pool->thread_count * sizeof(pthread_t));
+    pool->capacity = 64;
+    pool->jobs = (ShipJob*)malloc(pool->capacity * sizeof(ShipJob));
+    pool->head = 0;
+    pool->count = 0;
+    pool->active = 0;
+    pool->stopping = false;
+    memset(&pool->usage, 0, sizeof(pool->usage));
+    pthread_mutex_init(&pool->lock, null);
+    pthread_cond_init(&pool->work, null);
+    pthread_cond_init(&pool->idle, null);
+    for(Size i = 0; i < pool->thread_count; i++)
     {
-        Int8 buffer[2048];
-        snprintf(buffer, 2048, "mv \"%s\" \"%s\"", src->data, dst->data);
-        res.returncode = system(buffer);
+        pthread_create(&pool->threads[i], null, poolWorker, pool);
     }
-    return res;
 }
 
-ShipResult shipZip(ShipMap args)
+/// @brief Queue a job; safe to call from inside a running job
+Void poolSubmit(ShipPool* pool, ShipJobFunc func, Any arg)
 {
-    ShipResult res = {0};
-    res.returncode = 0;
-    res.stdout_str = stringFrom("");
-    res.stderr_str = stringFrom("");
-    return res;
+    pthread_mutex_lock(&pool->lock);
+    if(pool->count == pool->capacity)
+    {
+        Size cap = pool->capacity * 2;
+        ShipJob* jobs = (ShipJob*)malloc(cap * sizeof(ShipJob));
+        for(Size i = 0; i < pool->count; i++)
+        {
+            jobs[i] = pool->jobs[(pool->head + i) % pool->capacity];
+        }
+        free(pool->jobs);
+        pool->jobs = jobs;
+        pool->capacity = cap;
+        pool->head = 0;
+    }
+    pool->jobs[(pool->head + pool->count) % pool->capacity] = (ShipJob){ func, arg };
+    pool->count++;
+    pool->active++;
+    pthread_cond_signal(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
 }
 
-ShipResult shipList(ShipMap args)
+/// @brief Block until every submitted job, including ones they submitted, has finished
+Void poolWait(ShipPool* pool)
 {
-    ShipString* path = (ShipString*) mapGet(&args, stringFrom("path"));
-    ShipResult res = {0};
-    res.returncode = 0;
-    res.stdout_str = stringFrom("");
-    res.stderr_str = stringFrom("");
-    if(path)
+    pthread_mutex_lock(&pool->lock);
+    while(pool->active > 0)
     {
-        Int8 buffer[1024];
-        snprintf(buffer, 1024, "ls \"%s\"", path->data);
-        res.returncode = system(buffer);
+        pthread_cond_wait(&pool->idle, &pool->lock);
     }
-    return res;
+    pthread_mutex_unlock(&pool->lock);
 }
 
-ShipResult shipMoveAll(ShipMap args)
+Void poolDestroy(ShipPool* pool)
 {
-    ShipString* src = (ShipString*)mapGet(&args, stringFrom("src"));
-    ShipString* dst = (ShipString*)mapGet(&args, stringFrom("dst"));
-    ShipResult res = {0};
-    res.returncode = 0;
-    res.stdout_str = stringFrom("");
-    res.stderr_str = stringFrom("");
-    if(src && dst)
+    poolWait(pool);
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+    for(Size i = 0; i < pool->thread_count; i++)
     {
-        Int8 buffer[2048];
-        snprintf(buffer, 2048, "mv \"%s\"/* \"%s\"", src->data, dst->data);
-        res.returncode = system(buffer);
+        pthread_join(pool->threads[i], null);
     }
-    return res;
+    if(task_usage)
+    {
+        usageAdd(task_usage, &pool->usage);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work);
+    pthread_cond_destroy(&pool->idle);
+    free(pool->threads);
+    free(pool->jobs);
 }
 
-ShipResult shipEcho(ShipMap args)
+/// @brief True when cmd uses shell syntax or builtins and must go through /bin/sh
+Bool commandNeedsShell(CharSeq cmd)
 {
-    ShipString* msg = (ShipString*)mapGet(&args, stringFrom("message"));
-    if(msg)
+    static CharSeq builtins[] = {
+        "cd", "export", "source", ".", "exit", "set", "unset", "alias", "eval", "exec",
+        "ulimit", "umask", "read", "trap", "shift", "wait", "return", "if", "for", "while", null
+    };
+    if(strpbrk(cmd, "|&;<>()$`\\\"'*?[#~{}!\n"))
     {
-        printf("  " CYAN ">" ENDC " %s\n", msg->data);
+        return true;
     }
-    ShipResult r;
-    r.returncode = 0;
-    r.stdout_str = stringFrom(msg ? msg->data : "");
-    r.stderr_str = stringFrom("");
-    return r;
+    CharSeq c = cmd;
+    while(isspace((UInt8)*c)) c++;
+    CharSeq start = c;
+    while(*c && !isspace((UInt8)*c)) c++;
+    Size len = (Size)(c - start);
+    if(len == 0 || memchr(start, '=', len))
+    {
+        return true;
+    }
+    for(Size i = 0; builtins[i]; i++)
+    {
+        if(strlen(builtins[i]) == len && strncmp(builtins[i], start, len) == 0) return true;
+    }
+    return false;
 }
 
-ShipString stringEmpty()
+/// @brief Convert a kernel rusage sample into ShipUsage counters
+ShipUsage usageFromRusage(struct rusage* ru)
 {
-    return stringFrom("");
+    ShipUsage u;
+    memset(&u, 0, sizeof(u));
+    u.user_sec = ru->ru_utime.tv_sec + ru->ru_utime.tv_usec / 1e6;
+    u.sys_sec = ru->ru_stime.tv_sec + ru->ru_stime.tv_usec / 1e6;
+    u.max_rss_kb = ru->ru_maxrss;
+    u.in_blocks = ru->ru_inblock;
+    u.out_blocks = ru->ru_oublock;
+    u.vol_switches = ru->ru_nvcsw;
+    u.invol_switches = ru->ru_nivcsw;
+    return u;
 }
 
-Void runBuild(ShipString title, ShipVector tasks, Bool dry_run)
+/// @brief Accumulate b into a; peak RSS takes the maximum
+Void usageAdd(ShipUsage* a, ShipUsage* b)
 {
-    printHeader(title.data);
-    printf(BOLD "Plan: %lu steps to execute." ENDC "\n\n", (UInt64)tasks.length);
-    for(Size i = 0; i < tasks.length; i++)
-    {
-        ShipTask* t = (ShipTask*)tasks.data[i];
-        // Fix for potential NULL task_name
-        Int8* tname = t->task_name.data;
-        if (!tname) tname = "Unknown Task";
-        printf(DIM "[%lu/%lu]" ENDC " " INFO " %s...\n", (UInt64)(i+1), (UInt64)tasks.length, tname);
+    a->wall_ns += b->wall_ns;
+    a->user_sec += b->user_sec;
+    a->sys_sec += b->sys_sec;
+    a->max_rss_kb = b->max_rss_kb > a->max_rss_kb ? b->max_rss_kb : a->max_rss_kb;
+    a->in_blocks += b->in_blocks;
+    a->out_blocks += b->out_blocks;
+    a->vol_switches += b->vol_switches;
+    a->invol_switches += b->invol_switches;
+    a->children += b->children;
+    a->unmeasured = a->unmeasured || b->unmeasured;
+}
 
-        if(!dry_run)
-        {
-            ShipResult res = t->func(t->args);
-            if(res.returncode == 0)
-            {
-                printf(DIM "[%lu/%lu]" ENDC " " CHECK " %s " DIM "(Done)" ENDC "\n", (UInt64)(i+1), (UInt64)tasks.length, tname);
-            }
-            else
-            {
-                printf(FAIL "Failed!\n" ENDC);
-                break;
-            }
-        }
-    }
+/// @brief CPU and I/O counters of the calling thread (the process elsewhere)
+ShipUsage usageThread()
+{
+    struct rusage ru;
+#ifdef RUSAGE_THREAD
+    getrusage(RUSAGE_THREAD, &ru);
+#else
+    getrusage(RUSAGE_SELF, &ru);
+#endif
+    ShipUsage u = usageFromRusage(&ru);
+    u.max_rss_kb = 0;
+    return u;
 }
 
-Void printHeader(CharSeq title)
+/// @brief Spawn attributes for child processes: ship ignores SIGPIPE itself,
+/// but commands get the default action back so `yes | head` still ends
+static Void spawnAttrInit(posix_spawnattr_t* attr)
 {
-    printf("\n" HEADER BOLD "============================================================" ENDC "\n");
-    printf(HEADER BOLD "   %s" ENDC "\n", title);
-    printf(HEADER BOLD "============================================================" ENDC "\n\n");
+    posix_spawnattr_init(attr);
+    sigset_t defaults;
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGPIPE);
+    posix_spawnattr_setsigdefault(attr, &defaults);
+    Int16 flags = POSIX_SPAWN_SETSIGDEF;
+#ifdef POSIX_SPAWN_USEVFORK
+    flags |= POSIX_SPAWN_USEVFORK;
+#endif
+    posix_spawnattr_setflags(attr, flags);
 }
 
-int main(int argc, Int8** argv)
+/// @brief Append to the ring, overwriting its oldest bytes once full
+Void ringWrite(ShipRing* r, const Int8* data, Size len)
 {
-    registryInit();
-    registryRegister("run", "Run Command", shipRun);
-    registryRegister("delete", "Delete", shipDelete);
-    registryRegister("mkdir", "Create Directory", shipMkdir);
-    registryRegister("copy", "Copy", shipCopy);
-    registryRegister("move", "Move", shipMove);
-    registryRegister("move_all", "Move Contents", shipMoveAll);
-    registryRegister("zip", "Create ZIP", shipZip);
-    registryRegister("list", "List Directory", shipList);
-    registryRegister("echo", "Echo", shipEcho);
-    CharSeq script_path = "Shipfile";
-    Bool dry_run = false;
-    if(argc > 1)
+    if(!r->data)
     {
-        script_path = argv[1];
+        r->data = (Int8*)malloc(r->cap);
     }
-    FILE* f = fopen(script_path, "rb");
-    if(!f)
+    Size keep = len < r->cap ? len : r->cap;
+    Size pos = (Size)((r->total + len - keep) % r->cap);
+    data += len - keep;
+    while(keep > 0)
+    {
+        Size n = keep < r->cap - pos ? keep : r->cap - pos;
+        memcpy(r->data + pos, data, n);
+        data += n;
+        keep -= n;
+        pos = (pos + n) % r->cap;
+    }
+    r->total += len;
+}
+
+/// @brief Write out queued chunks until asked to stop with an empty queue
+static Any logWriterThread(Any arg)
+{
+    ShipLogWriter* w = (ShipLogWriter*)arg;
+    traceThreadName("log writer");
+    pthread_mutex_lock(&w->lock);
+    while(true)
     {
-        Int8 buf[256];
-        sprintf(buf, "%s.ship", script_path);
-        f = fopen(buf, "rb");
-        if(!f)
+        while(!w->head && !w->stop)
         {
-            printf(FAIL "Error: Script not found: %s\n" ENDC, script_path);
-            return 1;
+            pthread_cond_wait(&w->cond, &w->lock);
         }
-    }
-    fseek(f, 0, SEEK_END);
-    Int64 fsize = ftell(f);
-    fseek(f, 0, SEEK_SET);
-    Int8* content = (Int8*)malloc(fsize + 1);
-    fread(content, 1, fsize, f);
-    fclose(f);
-    content[fsize] = 0;
-    ShipVector tokens = tokenize(content);
-    ShipParser parser;
-    parser_init(&parser, tokens);
-    parserParse(&parser);
-    runBuild(parser.title, parser.tasks, dry_run);
-    return 0;
+        ShipLogChunk* c = w->head;
+        if(!c)
+        {
+            break;
+        }
+        w->head = c->next;
+        if(!w->head) w->tail = null;
+        pthread_mutex_unlock(&w->lock);
+
+        if(c->len == 0)
+        {
+            close(c->fd);
+        }
+        for(Size off = 0; off < c->len;)
+        {
+            ssize_t n = write(c->fd, c->data + off, c->len - off);
+            if(n > 0) off += (Size)n;
+            else if(errno != EINTR) break;
+        }
+
+        pthread_mutex_lock(&w->lock);
+        w->queued -= c->len;
+        free(c);
+        pthread_cond_broadcast(&w->cond);
+    }
+    pthread_mutex_unlock(&w->lock);
+    return null;
+}
+
+/// @brief Queue bytes for fd, blocking while SHIP_LOG_QUEUE_BYTES are already
+/// pending so a noisy task cannot outrun the disk; len 0 queues a close
+Void logWriterPush(Int32 fd, const Int8* data, Size len)
+{
+    ShipLogWriter* w = &global_log;
+    ShipLogChunk* c = (ShipLogChunk*)malloc(sizeof(ShipLogChunk) + len);
+    c->next = null;
+    c->fd = fd;
+    c->len = len;
+    if(len) memcpy(c->data, data, len);
+    pthread_mutex_lock(&w->lock);
+    if(!w->running)
+    {
+        w->stop = false;
+        w->running = pthread_create(&w->thread, null, logWriterThread, w) == 0;
+    }
+    if(!w->running)
+    {
+        pthread_mutex_unlock(&w->lock);
+        if(len == 0) close(fd);
+        else use(write(fd, data, len));
+        free(c);
+        return;
+    }
+    while(w->queued > 0 && w->queued + len > SHIP_LOG_QUEUE_BYTES)
+    {
+        pthread_cond_wait(&w->cond, &w->lock);
+    }
+    w->queued += len;
+    if(w->tail) w->tail->next = c;
+    else w->head = c;
+    w->tail = c;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+}
+
+/// @brief Flush every queued chunk and stop the writer thread
+Void logWriterDrain()
+{
+    ShipLogWriter* w = &global_log;
+    pthread_mutex_lock(&w->lock);
+    if(!w->running)
+    {
+        pthread_mutex_unlock(&w->lock);
+        return;
+    }
+    w->stop = true;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+    pthread_join(w->thread, null);
+    w->running = false;
+}
+
+/// @brief Keep data in the stream's tail and hand it to the log writer and,
+/// on a worker, to the connection
+Void captureWrite(ShipCapture* c, const Int8* data, Size len)
+{
+    if(len == 0)
+    {
+        return;
+    }
+    ringWrite(&c->tail, data, len);
+    if(c->log_fd >= 0)
+    {
+        logWriterPush(c->log_fd, data, len);
+    }
+    if(c->wire_fd >= 0)
+    {
+        wireSend(c->wire_fd, c->wire_type, data, len);
+    }
+}
+
+/// @brief The captured tail as a string, noting how much was dropped
+ShipString captureFinish(ShipCapture* c, CharSeq log_path)
+{
+    ShipRing* r = &c->tail;
+    ShipString s = stringEmpty();
+    Size kept = r->total < r->cap ? (Size)r->total : r->cap;
+    if(r->total > r->cap)
+    {
+        Int8 note[512];
+        snprintf(note, sizeof(note), "[... %lu earlier bytes omitted; full output in %s]\n", (UInt64)(r->total - r->cap), log_path ? log_path : "no log");
+        stringAppend(&s, note, strlen(note));
+    }
+    Size start = r->total > r->cap ? (Size)(r->total % r->cap) : 0;
+    if(kept > 0)
+    {
+        stringAppend(&s, r->data + start, kept - start);
+        stringAppend(&s, r->data, start);
+    }
+    free(r->data);
+    r->data = null;
+    return s;
+}
+
+/// @brief environ with the "KEY=VALUE" entries of v (a string or list) added
+/// or overriding; null when v is missing. Entries are borrowed, so only the
+/// array itself is freed, and v must outlive it.
+Int8** envMerge(ShipValue* v)
+{
+    if(!v)
+    {
+        return null;
+    }
+    Size extra = v->type == SHIP_VALUE_LIST ? v->list.count : 1;
+    Size base = 0;
+    while(environ[base]) base++;
+    Int8** env = (Int8**)malloc((base + extra + 1) * sizeof(Int8*));
+    memcpy(env, environ, base * sizeof(Int8*));
+    Size n = base;
+    for(Size i = 0; i < extra; i++)
+    {
+        ShipString* kv = valueAsString(v->type == SHIP_VALUE_LIST ? &v->list.items[i] : v);
+        CharSeq eq = kv ? strchr(kv->data, '=') : null;
+        if(!eq) continue;
+        Size key = (Size)(eq - kv->data) + 1;
+        Size j = 0;
+        while(j < n && strncmp(env[j], kv->data, key) != 0) j++;
+        env[j] = kv->data;
+        if(j == n) n++;
+    }
+    env[n] = null;
+    return env;
+}
+
+/// @brief Report that cmd could not be started, as the shell would on stderr
+static Void processFail(ShipCapture* err, CharSeq cmd, Int32 code)
+{
+    Int8 msg[512];
+    snprintf(msg, sizeof(msg), "%s: %s\n", cmd, strerror(code));
+    captureWrite(err, msg, strlen(msg));
+}
+
+/// @brief Spawn cmd and collect its stdout/stderr; returns the exit code,
+/// 128+signal if it was killed, or 127 if it could not be started. A non-null
+/// env replaces environ for the child.
+Int32 processRun(CharSeq cmd, Int8** env, ShipCapture* out, ShipCapture* err, ShipUsage* usage)
+{
+    // pipes first, so that running out of descriptors leaves nothing to free
+    Int32 out_pipe[2];
+    Int32 err_pipe[2];
+    if(pipe2(out_pipe, O_CLOEXEC) != 0)
+    {
+        processFail(err, cmd, errno);
+        return 127;
+    }
+    if(pipe2(err_pipe, O_CLOEXEC) != 0)
+    {
+        Int32 e = errno;
+        close(out_pipe[0]);
+        close(out_pipe[1]);
+        processFail(err, cmd, e);
+        return 127;
+    }
+
+    Int8* words = null;
+    Int8** argv;
+    Int8* sh_argv[4] = { "/bin/sh", "-c", (Int8*)cmd, null };
+    if(commandNeedsShell(cmd))
+    {
+        argv = sh_argv;
+    }
+    else
+    {
+        words = stringFrom(cmd).data;
+        Size count = 0;
+        argv = (Int8**)malloc((strlen(cmd) / 2 + 2) * sizeof(Int8*));
+        for(Int8* w = strtok(words, " \t\r"); w; w = strtok(null, " \t\r"))
+        {
+            argv[count++] = w;
+        }
+        argv[count] = null;
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, out_pipe[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, err_pipe[1], STDERR_FILENO);
+    posix_spawnattr_t attr;
+    spawnAttrInit(&attr);
+    pid_t pid;
+    UInt64 spawn_ns = global_trace.enabled ? clockNs() : 0;
+    Int32 rc = posix_spawnp(&pid, argv[0], &actions, &attr, argv, env ? env : environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    close(out_pipe[1]);
+    close(err_pipe[1]);
+    if(words)
+    {
+        free(words);
+        free(argv);
+    }
+    if(rc != 0)
+    {
+        close(out_pipe[0]);
+        close(err_pipe[0]);
+        processFail(err, cmd, rc);
+        return 127;
+    }
+
+    struct pollfd fds[2] = { { out_pipe[0], POLLIN, 0 }, { err_pipe[0], POLLIN, 0 } };
+    ShipCapture* sinks[2] = { out, err };
+    Int8 buffer[1 << 14];
+    Int32 open_fds = 2;
+    while(open_fds > 0)
+    {
+        if(poll(fds, 2, -1) < 0)
+        {
+            if(errno == EINTR) continue;
+            break;
+        }
+        for(Int32 i = 0; i < 2; i++)
+        {
+            if(fds[i].fd < 0 || !(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            ssize_t n = read(fds[i].fd, buffer, sizeof(buffer));
+            if(n > 0)
+            {
+                captureWrite(sinks[i], buffer, (Size)n);
+            }
+            else if(n == 0 || errno != EINTR)
+            {
+                close(fds[i].fd);
+                fds[i].fd = -1;
+                open_fds--;
+            }
+        }
+    }
+    for(Int32 i = 0; i < 2; i++)
+    {
+        if(fds[i].fd >= 0) close(fds[i].fd);
+    }
+
+    Int32 status = 0;
+    struct rusage ru;
+    memset(&ru, 0, sizeof(ru));
+    while(wait4(pid, &status, 0, &ru) < 0 && errno == EINTR);
+    if(usage)
+    {
+        ShipUsage child = usageFromRusage(&ru);
+        child.children = 1;
+        usageAdd(usage, &child);
+    }
+    if(global_trace.enabled)
+    {
+        traceSpan("process", cmd, spawn_ns, clockNs(), pid);
+    }
+    if(WIFEXITED(status))
+    {
+        return WEXITSTATUS(status);
+    }
+    if(WIFSIGNALED(status))
+    {
+        return 128 + WTERMSIG(status);
+    }
+    return -1;
+}
+
+/// @brief Loop run by the persistent shell. Each command arrives on stdin as
+/// a "LENGTH MARKER" line followed by exactly LENGTH bytes of script, so the
+/// text is data to eval rather than part of the driver: an unbalanced quote
+/// or heredoc fails inside `command eval` instead of eating the sentinel.
+/// Background jobs are waited for so their output stays with their task.
+/// shellRun sends nothing more until the marker comes back, so the script is
+/// all the pipe holds and head may read it in whole blocks.
+#define SHIP_SHELL_DRIVER \
+    "while IFS=' ' read -r __ship_len __ship_mark; do\n" \
+    "  __ship_cmd=$(head -c \"$__ship_len\"; echo x)\n" \
+    "  __ship_cmd=${__ship_cmd%x}\n" \
+    "  command eval \"$__ship_cmd\" </dev/null\n" \
+    "  __ship_rc=$?\n" \
+    "  wait\n" \
+    "  printf '\\n%s %d\\n' \"$__ship_mark\" \"$__ship_rc\"\n" \
+    "  printf '\\n%s\\n' \"$__ship_mark\" >&2\n" \
+    "done\n"
+
+/// @brief Spawn the persistent /bin/sh with its stdio wired to pipes
+static Bool shellStart(ShipShell* sh)
+{
+    Int32 in_pipe[2];
+    Int32 out_pipe[2];
+    Int32 err_pipe[2];
+    if(pipe2(in_pipe, O_CLOEXEC) != 0)
+    {
+        return false;
+    }
+    if(pipe2(out_pipe, O_CLOEXEC) != 0)
+    {
+        close(in_pipe[0]);
+        close(in_pipe[1]);
+        return false;
+    }
+    if(pipe2(err_pipe, O_CLOEXEC) != 0)
+    {
+        close(in_pipe[0]);
+        close(in_pipe[1]);
+        close(out_pipe[0]);
+        close(out_pipe[1]);
+        return false;
+    }
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, in_pipe[0], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, out_pipe[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, err_pipe[1], STDERR_FILENO);
+    Int8* argv[4] = { "/bin/sh", "-c", SHIP_SHELL_DRIVER, null };
+    posix_spawnattr_t attr;
+    spawnAttrInit(&attr);
+    pid_t pid;
+    Int32 rc = posix_spawn(&pid, argv[0], &actions, &attr, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    close(in_pipe[0]);
+    close(out_pipe[1]);
+    close(err_pipe[1]);
+    if(rc != 0)
+    {
+        close(in_pipe[1]);
+        close(out_pipe[0]);
+        close(err_pipe[0]);
+        return false;
+    }
+    sh->pid = (Int32)pid;
+    sh->in_fd = in_pipe[1];
+    sh->out_fd = out_pipe[0];
+    sh->err_fd = err_pipe[0];
+    sh->started = true;
+    return true;
+}
+
+/// @brief Tear the session down; returns the shell's exit code
+static Int32 shellStop(ShipShell* sh)
+{
+    if(!sh->started)
+    {
+        return 0;
+    }
+    close(sh->in_fd);
+    close(sh->out_fd);
+    close(sh->err_fd);
+    sh->started = false;
+    Int32 status = 0;
+    while(waitpid(sh->pid, &status, 0) < 0 && errno == EINTR);
+    if(WIFEXITED(status))
+    {
+        return WEXITSTATUS(status);
+    }
+    if(WIFSIGNALED(status))
+    {
+        return 128 + WTERMSIG(status);
+    }
+    return -1;
+}
+
+/// @brief Offset of marker in s, or -1
+static ssize_t shellFind(ShipString* s, CharSeq marker, Size len)
+{
+    Int8* hit = (Int8*)memmem(s->data, s->length, marker, len);
+    return hit ? hit - s->data : -1;
+}
+
+/// @brief True while the shell process has not exited; does not reap it
+static Bool shellAlive(ShipShell* sh)
+{
+    siginfo_t info;
+    memset(&info, 0, sizeof(info));
+    return waitid(P_PID, (id_t)sh->pid, &info, WEXITED | WNOHANG | WNOWAIT) == 0 && info.si_pid == 0;
+}
+
+/// @brief Append text to a shell script as one single-quoted word
+static Void shellQuote(ShipString* script, CharSeq text, Size len)
+{
+    stringAppend(script, "'", 1);
+    for(Size i = 0; i < len; i++)
+    {
+        if(text[i] == '\'') stringAppend(script, "'\\''", 4);
+        else stringAppend(script, text + i, 1);
+    }
+    stringAppend(script, "'", 1);
+}
+
+/// @brief Run cmd inside the persistent shell so cd/export carry over to the
+/// next persistent task; output boundaries and the exit code come from
+/// per-command sentinels the driver prints after it. A task env is exported
+/// in a subshell around the command, so it reaches the command but neither
+/// it nor the command's own state changes outlive the task. Returns like
+/// processRun
+Int32 shellRun(ShipShell* sh, CharSeq cmd, ShipValue* env, ShipCapture* out, ShipCapture* err)
+{
+    pthread_mutex_lock(&sh->lock);
+    if(!sh->started && !shellStart(sh))
+    {
+        pthread_mutex_unlock(&sh->lock);
+        Int8 msg[512];
+        snprintf(msg, sizeof(msg), "%s: could not start /bin/sh: %s\n", cmd, strerror(errno));
+        captureWrite(err, msg, strlen(msg));
+        return 127;
+    }
+    UInt64 start_ns = global_trace.enabled ? clockNs() : 0;
+
+    // the leading newline keeps the marker on its own line even when the
+    // command's output does not end in one; it is never passed on
+    Int8 marker[64];
+    Size marker_len = (Size)snprintf(marker, sizeof(marker), "\n__ship_%d_%lu__", (Int32)getpid(), (UInt64)++sh->serial);
+    ShipString body = stringEmpty();
+    Size env_count = !env ? 0 : env->type == SHIP_VALUE_LIST ? env->list.count : 1;
+    if(env_count)
+    {
+        stringAppend(&body, "(\n", 2);
+        for(Size i = 0; i < env_count; i++)
+        {
+            ShipString* kv = valueAsString(env->type == SHIP_VALUE_LIST ? &env->list.items[i] : env);
+            CharSeq eq = kv ? strchr(kv->data, '=') : null;
+            if(!eq) continue;
+            Size key = (Size)(eq - kv->data);
+            Bool valid = key > 0 && !isdigit((UInt8)kv->data[0]);
+            for(Size j = 0; j < key && valid; j++)
+            {
+                valid = isalnum((UInt8)kv->data[j]) || kv->data[j] == '_';
+            }
+            if(!valid)
+            {
+                Int8 msg[512];
+                snprintf(msg, sizeof(msg), "env %.*s: not a shell variable name, not exported\n", (Int32)key, kv->data);
+                captureWrite(err, msg, strlen(msg));
+                continue;
+            }
+            stringAppend(&body, "export ", 7);
+            stringAppend(&body, kv->data, key + 1);
+            shellQuote(&body, eq + 1, kv->length - key - 1);
+            stringAppend(&body, "\n", 1);
+        }
+    }
+    stringAppend(&body, cmd, strlen(cmd));
+    if(env_count)
+    {
+        stringAppend(&body, "\n)", 2);
+    }
+    Int8 header[96];
+    Int32 n = snprintf(header, sizeof(header), "%lu %s\n", (UInt64)body.length, marker + 1);
+    ShipString script = stringEmpty();
+    stringAppend(&script, header, (Size)n);
+    stringAppend(&script, body.data, body.length);
+    stringFree(&body);
+
+    Bool alive = true;
+    for(Size off = 0; off < script.length && alive;)
+    {
+        ssize_t w = write(sh->in_fd, script.data + off, script.length - off);
+        if(w > 0) off += (Size)w;
+        else if(errno != EINTR) alive = false;
+    }
+    stringFree(&script);
+
+    // only the bytes that could still be part of a marker are held back;
+    // everything before them streams straight into the captures
+    ShipCapture* sinks[2] = { out, err };
+    ShipString bufs[2] = { stringEmpty(), stringEmpty() };
+    Bool done[2] = { false, false };
+    Int32 rc = -1;
+    struct pollfd fds[2] = { { sh->out_fd, POLLIN, 0 }, { sh->err_fd, POLLIN, 0 } };
+    Int8 buffer[1 << 14];
+    while(alive && (!done[0] || !done[1]))
+    {
+        // a background job that outlives the shell keeps the pipes open, so
+        // EOF alone cannot be relied on to notice that the shell is gone
+        Int32 ready = poll(fds, 2, 1000);
+        if(ready < 0)
+        {
+            if(errno == EINTR) continue;
+            alive = false;
+            break;
+        }
+        if(ready == 0)
+        {
+            alive = shellAlive(sh);
+            continue;
+        }
+        for(Int32 i = 0; i < 2; i++)
+        {
+            if(done[i] || !(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            ssize_t got = read(fds[i].fd, buffer, sizeof(buffer));
+            if(got == 0 || (got < 0 && errno != EINTR))
+            {
+                alive = false;
+                break;
+            }
+            if(got < 0) continue;
+            stringAppend(&bufs[i], buffer, (Size)got);
+            ssize_t at = shellFind(&bufs[i], marker, marker_len);
+            // stdout's marker carries the exit code, so wait for its full line
+            if(at >= 0 && (i == 1 || memchr(bufs[i].data + at + marker_len, '\n', bufs[i].length - (Size)at - marker_len)))
+            {
+                done[i] = true;
+                if(i == 0) rc = atoi(bufs[i].data + at + marker_len);
+                captureWrite(sinks[i], bufs[i].data, (Size)at);
+                continue;
+            }
+            Size hold = at >= 0 ? bufs[i].length - (Size)at : marker_len;
+            if(bufs[i].length > hold)
+            {
+                Size flush = bufs[i].length - hold;
+                captureWrite(sinks[i], bufs[i].data, flush);
+                memmove(bufs[i].data, bufs[i].data + flush, hold);
+                bufs[i].length = hold;
+            }
+        }
+    }
+    if(!alive)
+    {
+        // the command ended the shell itself (exit, exec, fatal error);
+        // keep what it wrote and report the shell's status instead
+        for(Int32 i = 0; i < 2; i++)
+        {
+            if(done[i]) continue;
+            captureWrite(sinks[i], bufs[i].data, bufs[i].length);
+            fcntl(fds[i].fd, F_SETFL, O_NONBLOCK);
+            for(ssize_t got; (got = read(fds[i].fd, buffer, sizeof(buffer))) > 0;)
+            {
+                captureWrite(sinks[i], buffer, (Size)got);
+            }
+        }
+        rc = shellStop(sh);
+    }
+    stringFree(&bufs[0]);
+    stringFree(&bufs[1]);
+    if(global_trace.enabled)
+    {
+        traceSpan("process", cmd, start_ns, clockNs(), sh->pid);
+    }
+    pthread_mutex_unlock(&sh->lock);
+    return rc;
+}
+
+/// @brief Stop the persistent shell, if one was started
+Void shellClose(ShipShell* sh)
+{
+    pthread_mutex_lock(&sh->lock);
+    shellStop(sh);
+    pthread_mutex_unlock(&sh->lock);
+}
+
+static Bool wireWriteAll(Int32 fd, const Void* data, Size len)
+{
+    const Int8* p = (const Int8*)data;
+    while(len > 0)
+    {
+        ssize_t n = write(fd, p, len);
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0) return false;
+        p += n;
+        len -= (Size)n;
+    }
+    return true;
+}
+
+static Bool wireReadAll(Int32 fd, Void* data, Size len)
+{
+    Int8* p = (Int8*)data;
+    while(len > 0)
+    {
+        ssize_t n = read(fd, p, len);
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0) return false;
+        p += n;
+        len -= (Size)n;
+    }
+    return true;
+}
+
+/// @brief Write one frame: type, big-endian UInt32 length, payload
+Bool wireSend(Int32 fd, UInt8 type, const Void* data, Size len)
+{
+    UInt8 header[5];
+    UInt32 n = htonl((UInt32)len);
+    header[0] = type;
+    memcpy(header + 1, &n, sizeof(n));
+    return wireWriteAll(fd, header, sizeof(header)) && wireWriteAll(fd, data, len);
+}
+
+/// @brief Send a frame carrying a single big-endian Int32
+Bool wireSendInt(Int32 fd, UInt8 type, Int32 value)
+{
+    UInt32 n = htonl((UInt32)value);
+    return wireSend(fd, type, &n, sizeof(n));
+}
+
+/// @brief Decode a big-endian Int32 from the start of a frame
+Int32 wireGetInt(CharSeq data)
+{
+    UInt32 n;
+    memcpy(&n, data, sizeof(n));
+    return (Int32)ntohl(n);
+}
+
+/// @brief Read one frame into payload (NUL-terminated); false on EOF, a
+/// short read or a frame over SHIP_WIRE_MAX_FRAME
+Bool wireRecv(Int32 fd, UInt8* type, ShipString* payload)
+{
+    UInt8 header[5];
+    UInt32 len;
+    if(!wireReadAll(fd, header, sizeof(header)))
+    {
+        return false;
+    }
+    *type = header[0];
+    memcpy(&len, header + 1, sizeof(len));
+    len = ntohl(len);
+    if(len > SHIP_WIRE_MAX_FRAME)
+    {
+        return false;
+    }
+    payload->length = 0;
+    stringAppend(payload, "", 0);
+    if(len == 0)
+    {
+        return true;
+    }
+    if(payload->capacity < (Size)len + 1)
+    {
+        payload->data = (Int8*)realloc(payload->data, (Size)len + 1);
+        payload->capacity = (Size)len + 1;
+    }
+    if(!wireReadAll(fd, payload->data, len))
+    {
+        return false;
+    }
+    payload->length = len;
+    payload->data[len] = '\0';
+    return true;
+}
+
+/// @brief Resolve "unix:PATH", "tcp:HOST:PORT", a bare path (has a '/'),
+/// "HOST:PORT" or a bare port (loopback) into a socket address
+static Bool wireAddress(CharSeq addr, struct sockaddr_storage* out, socklen_t* out_len)
+{
+    memset(out, 0, sizeof(*out));
+    CharSeq unix_path = strncmp(addr, "unix:", 5) == 0 ? addr + 5 : strncmp(addr, "tcp:", 4) != 0 && strchr(addr, '/') ? addr : null;
+    if(unix_path)
+    {
+        struct sockaddr_un* un = (struct sockaddr_un*)out;
+        if(strlen(unix_path) >= sizeof(un->sun_path))
+        {
+            return false;
+        }
+        un->sun_family = AF_UNIX;
+        strcpy(un->sun_path, unix_path);
+        *out_len = sizeof(*un);
+        return true;
+    }
+    if(strncmp(addr, "tcp:", 4) == 0) addr += 4;
+    Int8 host[256] = "127.0.0.1";
+    CharSeq port = strrchr(addr, ':');
+    if(port)
+    {
+        snprintf(host, sizeof(host), "%.*s", (Int32)(port - addr), addr);
+        port++;
+    }
+    else
+    {
+        port = addr;
+    }
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* res = null;
+    if(getaddrinfo(host, port, &hints, &res) != 0 || !res)
+    {
+        return false;
+    }
+    memcpy(out, res->ai_addr, res->ai_addrlen);
+    *out_len = res->ai_addrlen;
+    freeaddrinfo(res);
+    return true;
+}
+
+/// @brief Connect to an executor; -1 if it cannot be reached
+Int32 wireConnect(CharSeq addr)
+{
+    struct sockaddr_storage sa;
+    socklen_t len;
+    if(!wireAddress(addr, &sa, &len))
+    {
+        return -1;
+    }
+    Int32 fd = socket(sa.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd < 0 || connect(fd, (struct sockaddr*)&sa, len) != 0)
+    {
+        if(fd >= 0) close(fd);
+        return -1;
+    }
+    if(sa.ss_family != AF_UNIX)
+    {
+        Int32 one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+/// @brief Whether addr names a Unix socket or a loopback interface
+Bool wireIsLocal(CharSeq addr)
+{
+    struct sockaddr_storage storage;
+    socklen_t len;
+    if(!wireAddress(addr, &storage, &len))
+    {
+        return false;
+    }
+    struct sockaddr_storage* sa = &storage;
+    if(sa->ss_family == AF_UNIX)
+    {
+        return true;
+    }
+    if(sa->ss_family == AF_INET)
+    {
+        return (ntohl(((struct sockaddr_in*)sa)->sin_addr.s_addr) >> 24) == 127;
+    }
+    if(sa->ss_family == AF_INET6)
+    {
+        struct in6_addr* a = &((struct sockaddr_in6*)sa)->sin6_addr;
+        return IN6_IS_ADDR_LOOPBACK(a) || (IN6_IS_ADDR_V4MAPPED(a) && a->s6_addr[12] == 127);
+    }
+    return false;
+}
+
+/// @brief Bind and listen on addr, replacing a stale Unix socket file; a Unix
+/// socket is created owner-only
+Int32 wireListen(CharSeq addr)
+{
+    struct sockaddr_storage sa;
+    socklen_t len;
+    if(!wireAddress(addr, &sa, &len))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    mode_t mask = 0;
+    if(sa.ss_family == AF_UNIX)
+    {
+        unlink(((struct sockaddr_un*)&sa)->sun_path);
+        mask = umask(0177);
+    }
+    Int32 fd = socket(sa.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    Int32 one = 1;
+    if(fd >= 0) setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    Bool bound = fd >= 0 && bind(fd, (struct sockaddr*)&sa, len) == 0;
+    Int32 saved = errno;
+    if(sa.ss_family == AF_UNIX)
+    {
+        umask(mask);
+    }
+    errno = saved;
+    if(!bound || listen(fd, 64) != 0)
+    {
+        saved = errno;
+        if(fd >= 0) close(fd);
+        errno = saved;
+        return -1;
+    }
+    return fd;
+}
+
+/// @brief A wire path is relative and has no ".." component
+static Bool wirePathSafe(CharSeq path)
+{
+    if(path[0] == '/')
+    {
+        return false;
+    }
+    for(CharSeq c = path; *c; )
+    {
+        Size n = strcspn(c, "/");
+        if(n == 2 && c[0] == '.' && c[1] == '.')
+        {
+            return false;
+        }
+        c += n;
+        while(*c == '/') c++;
+    }
+    return true;
+}
+
+/// @brief Send a file as a FILE frame (mode, path) and DATA chunks; directories
+/// are sent file by file. Paths must be relative and stay inside the tree.
+static Bool wireSendPath(Int32 fd, CharSeq path, ShipCapture* err)
+{
+    struct stat sb;
+    if(stat(path, &sb) != 0)
+    {
+        return true;
+    }
+    if(!wirePathSafe(path))
+    {
+        Int8 msg[1024];
+        snprintf(msg, sizeof(msg), "Not sending %s: remote paths must be relative\n", path);
+        if(err) captureWrite(err, msg, strlen(msg));
+        return true;
+    }
+    if(S_ISDIR(sb.st_mode))
+    {
+        DIR* d = opendir(path);
+        if(!d)
+        {
+            return true;
+        }
+        Bool ok = true;
+        struct dirent* e;
+        while(ok && (e = readdir(d)) != null)
+        {
+            if(strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0) continue;
+            Int8* child = pathJoin(path, e->d_name);
+            ok = wireSendPath(fd, child, err);
+            free(child);
+        }
+        closedir(d);
+        return ok;
+    }
+    if(!S_ISREG(sb.st_mode))
+    {
+        return true;
+    }
+    Int32 in = open(path, O_RDONLY | O_CLOEXEC);
+    if(in < 0)
+    {
+        return true;
+    }
+    ShipString head = stringEmpty();
+    UInt32 mode = htonl((UInt32)(sb.st_mode & 07777));
+    stringAppend(&head, (const Int8*)&mode, sizeof(mode));
+    stringAppend(&head, path, strlen(path));
+    Bool ok = wireSend(fd, SHIP_WIRE_FILE, head.data, head.length);
+    stringFree(&head);
+    static __thread Int8 buffer[SHIP_WIRE_CHUNK];
+    ssize_t n;
+    while(ok && (n = read(in, buffer, sizeof(buffer))) > 0)
+    {
+        ok = wireSend(fd, SHIP_WIRE_DATA, buffer, (Size)n);
+    }
+    close(in);
+    return ok;
+}
+
+/// @brief Start receiving the file a FILE frame announces; -1 if its path is
+/// unsafe or (when roots is given) outside every root
+static Int32 wireOpenFile(ShipString* frame, ShipVector* roots)
+{
+    if(frame->length <= sizeof(UInt32))
+    {
+        return -1;
+    }
+    Int32 mode = wireGetInt(frame->data);
+    CharSeq path = frame->data + sizeof(UInt32);
+    if(!wirePathSafe(path))
+    {
+        return -1;
+    }
+    Bool allowed = !roots;
+    for(Size i = 0; roots && i < roots->length && !allowed; i++)
+    {
+        allowed = watchPathUnder(path, (CharSeq)roots->data[i]);
+    }
+    if(!allowed)
+    {
+        return -1;
+    }
+    pathMakeParents(path);
+    unlink(path);
+    return open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode & 07777);
+}
+
+/// @brief Run cmd on the executor at addr: ship the task's env and inputs,
+/// stream its output back into out/err, and write back its declared outputs.
+/// *reached is false when no executor answered, so the caller can run locally.
+Int32 remoteRun(CharSeq addr, CharSeq cmd, ShipMap* args, ShipCapture* out, ShipCapture* err, Bool* reached)
+{
+    Int32 fd = wireConnect(addr);
+    *reached = fd >= 0;
+    if(fd < 0)
+    {
+        return 127;
+    }
+    UInt64 start_ns = global_trace.enabled ? clockNs() : 0;
+    Bool ok = true;
+    CharSeq token = getenv(SHIP_WORKER_TOKEN_ENV);
+    if(token && token[0])
+    {
+        ok = wireSend(fd, SHIP_WIRE_AUTH, token, strlen(token));
+    }
+    ShipValue* env = mapGetStr(args, "env");
+    Size env_count = !env ? 0 : env->type == SHIP_VALUE_LIST ? env->list.count : 1;
+    for(Size i = 0; ok && i < env_count; i++)
+    {
+        ShipString* kv = valueAsString(env->type == SHIP_VALUE_LIST ? &env->list.items[i] : env);
+        if(kv) ok = wireSend(fd, SHIP_WIRE_ENV, kv->data, kv->length);
+    }
+
+    ShipVector roots;
+    vectorInit(&roots);
+    CharSeq names[2] = { "inputs", "outputs" };
+    for(Int32 k = 0; k < 2; k++)
+    {
+        ShipValue* v = mapGetStr(args, names[k]);
+        if(!v) continue;
+        ShipString spec = valueToString(v);
+        CharSeq c = spec.data;
+        CharSeq start;
+        Size len;
+        while(ok && listNext(&c, &start, &len))
+        {
+            Int8* path = stringFromLength(start, len).data;
+            if(k == 0)
+            {
+                ok = wireSendPath(fd, path, err);
+                free(path);
+            }
+            else
+            {
+                ok = wireSend(fd, SHIP_WIRE_OUTPUT, path, len);
+                vectorPush(&roots, path);
+            }
+        }
+        stringFree(&spec);
+    }
+    ok = ok && wireSend(fd, SHIP_WIRE_RUN, cmd, strlen(cmd));
+
+    Int32 rc = -1;
+    Bool exited = false;
+    Int32 file = -1;
+    ShipString frame = stringEmpty();
+    UInt8 type;
+    while(ok && !exited && wireRecv(fd, &type, &frame))
+    {
+        if(type == SHIP_WIRE_STDOUT || type == SHIP_WIRE_STDERR)
+        {
+            captureWrite(type == SHIP_WIRE_STDOUT ? out : err, frame.data, frame.length);
+        }
+        else if(type == SHIP_WIRE_FILE)
+        {
+            if(file >= 0) close(file);
+            file = wireOpenFile(&frame, &roots);
+        }
+        else if(type == SHIP_WIRE_DATA && file >= 0)
+        {
+            ok = wireWriteAll(file, frame.data, frame.length);
+        }
+        else if(type == SHIP_WIRE_EXIT && frame.length >= sizeof(Int32))
+        {
+            rc = wireGetInt(frame.data);
+            exited = true;
+        }
+    }
+    if(file >= 0) close(file);
+    if(!exited)
+    {
+        Int8 msg[512];
+        snprintf(msg, sizeof(msg), "Lost the connection to executor %s\n", addr);
+        captureWrite(err, msg, strlen(msg));
+        rc = 127;
+    }
+    stringFree(&frame);
+    for(Size i = 0; i < roots.length; i++)
+    {
+        free(roots.data[i]);
+    }
+    free(roots.data);
+    close(fd);
+    if(global_trace.enabled)
+    {
+        traceSpan("remote", cmd, start_ns, clockNs(), -1);
+    }
+    return rc;
+}
+
+/// @brief Executor for a run task's `remote` arg: an explicit address, or
+/// for `remote: true` the next one of --remote in round-robin order
+static CharSeq remoteAddress(ShipValue* v)
+{
+    if(!v || !valueTruthy(v))
+    {
+        return null;
+    }
+    if(v->type == SHIP_VALUE_STRING && strcmp(v->string.data, "true") != 0)
+    {
+        return v->string.data;
+    }
+    if(global_remote.addrs.length == 0)
+    {
+        return null;
+    }
+    UInt64 n = __atomic_fetch_add(&global_remote.next, 1, __ATOMIC_RELAXED);
+    return (CharSeq)global_remote.addrs.data[n % global_remote.addrs.length];
+}
+
+ShipResult shipRun(ShipMap args)
+{
+    ShipString* cmd = valueAsString(mapGetStr(&args, "command"));
+    ShipResult res = {0};
+    res.stdout_str = stringEmpty();
+    res.stderr_str = stringEmpty();
+    if(!cmd)
+    {
+        res.returncode = -1;
+        return res;
+    }
+    // the full streams go to the task's log file; only their tails stay in
+    // memory for the report, however much the command prints
+    Int32 log_fd = -1;
+    if(task_log_path)
+    {
+        mkdir(SHIP_STATE_DIR, 0755);
+        mkdir(SHIP_LOG_DIR, 0755);
+        log_fd = open(task_log_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    }
+    ShipCapture out = { { null, SHIP_CAPTURE_TAIL, 0 }, log_fd, -1, 0 };
+    ShipCapture err = { { null, SHIP_CAPTURE_TAIL, 0 }, log_fd, -1, 0 };
+    ShipString* shell = valueAsString(mapGetStr(&args, "shell"));
+    CharSeq remote = remoteAddress(mapGetStr(&args, "remote"));
+    Bool reached = false;
+    if(remote)
+    {
+        res.returncode = remoteRun(remote, cmd->data, &args, &out, &err, &reached);
+        res.usage.unmeasured = reached;
+        if(!reached)
+        {
+            Int8 msg[512];
+            snprintf(msg, sizeof(msg), "Executor %s is unreachable; running locally\n", remote);
+            captureWrite(&err, msg, strlen(msg));
+        }
+    }
+    if(!reached && shell && strcmp(shell->data, "persistent") == 0)
+    {
+        res.returncode = shellRun(&global_shell, cmd->data, mapGetStr(&args, "env"), &out, &err);
+        // the command is the shell's child, not ours, so wait4 never sees it
+        res.usage.unmeasured = true;
+    }
+    else if(!reached)
+    {
+        Int8** env = envMerge(mapGetStr(&args, "env"));
+        res.returncode = processRun(cmd->data, env, &out, &err, &res.usage);
+        free(env);
+    }
+    if(log_fd >= 0)
+    {
+        logWriterPush(log_fd, null, 0);
+    }
+    CharSeq log_path = log_fd >= 0 ? task_log_path : null;
+    stringFree(&res.stdout_str);
+    stringFree(&res.stderr_str);
+    res.stdout_str = captureFinish(&out, log_path);
+    res.stderr_str = captureFinish(&err, log_path);
+    return res;
+}
+
+ShipResult shipDelete(ShipMap args)
+{
+    ShipString* path = valueAsString(mapGetStr(&args, "path"));
+    Bool forgive = valueAsBool(mapGetStr(&args, "forgive_missing"), true);
+    ShipResult res = {0};
+    res.returncode = 0;
+    res.stdout_str = stringFrom("");
+    res.stderr_str = stringFrom("");
+    if(path)
+    {
+        UInt64 removed = 0;
+        if(removeTree(path->data, forgive, &res.stderr_str, &removed))
+        {
+            Int8 msg[1024];
+            if(removed)
+            {
+                snprintf(msg, sizeof(msg), "Deleted %lu entries from %s", removed, path->data);
+            }
+            else
+            {
+                snprintf(msg, sizeof(msg), "Path not found (ignored): %s", path->data);
+            }
+            stringFree(&res.stdout_str);
+            res.stdout_str = stringFrom(msg);
+        }
+        else
+        {
+            res.returncode = 1;
+        }
+    }
+    return res;
+}
+
+ShipResult shipMkdir(ShipMap args)
+{
+    ShipString* path = valueAsString(mapGetStr(&args, "path"));
+    ShipResult res = {0};
+    res.returncode = 0;
+    res.stdout_str = stringFrom("");
+    res.stderr_str = stringFrom("");
+    if(path)
+    {
+        Int8 buffer[1024];
+        snprintf(buffer, 1024, "mkdir -p \"%s\"", path->data);
+        res.returncode = system(buffer);
+    }
+    return res;
+}
+
+/// @brief Copy one regular file's data and metadata. Tries a reflink first,
+/// then in-kernel copy_file_range/sendfile, then a plain read/write loop.
+Bool copyFile(CharSeq src, CharSeq dst, struct stat* sb)
+{
+    Int32 in = open(src, O_RDONLY | O_CLOEXEC);
+    if(in < 0)
+    {
+        return false;
+    }
+    Int32 out = open(dst, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, sb->st_mode & 07777);
+    if(out < 0)
+    {
+        close(in);
+        return false;
+    }
+    Bool ok = false;
+    UInt64 left = (UInt64)sb->st_size;
+#ifdef __linux__
+#ifdef FICLONE
+    if(ioctl(out, FICLONE, in) == 0)
+    {
+        ok = true;
+        left = 0;
+    }
+#endif
+    while(!ok && left > 0)
+    {
+        ssize_t n = copy_file_range(in, null, out, null, left, 0);
+        if(n <= 0) break;
+        left -= (UInt64)n;
+    }
+    while(!ok && left > 0)
+    {
+        ssize_t n = sendfile(out, in, null, left);
+        if(n <= 0) break;
+        left -= (UInt64)n;
+    }
+#endif
+    if(!ok && left > 0)
+    {
+        static __thread UInt8 buffer[1 << 17];
+        ssize_t n;
+        while(left > 0 && (n = read(in, buffer, sizeof(buffer))) > 0)
+        {
+            if(write(out, buffer, (Size)n) != n) break;
+            left -= (UInt64)n;
+        }
+    }
+    ok = left == 0;
+    if(ok)
+    {
+        struct timespec times[2] = { sb->st_atim, sb->st_mtim };
+        fchmod(out, sb->st_mode & 07777);
+        futimens(out, times);
+    }
+    close(in);
+    ok = close(out) == 0 && ok;
+    return ok;
+}
+
+Void copyFail(ShipCopyContext* ctx, CharSeq path)
+{
+    Int32 err = errno ? errno : EIO;
+    pthread_mutex_lock(&ctx->lock);
+    if(!ctx->error)
+    {
+        ctx->error = err;
+        ctx->error_path = stringFrom(path).data;
+    }
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+Void copyFileJob(Any arg)
+{
+    ShipCopyJob* job = (ShipCopyJob*)arg;
+    ShipCopyContext* ctx = job->ctx;
+    if(S_ISLNK(job->sb.st_mode))
+    {
+        Int8 target[4096];
+        ssize_t n = readlink(job->src, target, sizeof(target) - 1);
+        if(n < 0 || (target[n] = '\0', symlink(target, job->dst)) != 0)
+        {
+            copyFail(ctx, job->src);
+        }
+        else
+        {
+            struct timespec times[2] = { job->sb.st_atim, job->sb.st_mtim };
+            utimensat(AT_FDCWD, job->dst, times, AT_SYMLINK_NOFOLLOW);
+        }
+    }
+    else if(!copyFile(job->src, job->dst, &job->sb))
+    {
+        copyFail(ctx, job->src);
+    }
+    else
+    {
+        pthread_mutex_lock(&ctx->lock);
+        ctx->files++;
+        ctx->bytes += (UInt64)job->sb.st_size;
+        pthread_mutex_unlock(&ctx->lock);
+    }
+    free(job->src);
+    free(job->dst);
+    free(job);
+}
+
+Void copyDirJob(Any arg);
+
+/// @brief Schedule one entry; directories are created immediately so their
+/// children can be written, and their metadata is applied once the pool drains.
+Void copySubmit(ShipCopyContext* ctx, Int8* src, Int8* dst, struct stat* sb)
+{
+    ShipCopyJob* job = (ShipCopyJob*)malloc(sizeof(ShipCopyJob));
+    job->ctx = ctx;
+    job->src = src;
+    job->dst = dst;
+    job->sb = *sb;
+    if(S_ISDIR(sb->st_mode))
+    {
+        if(mkdir(dst, 0700) != 0 && errno != EEXIST)
+        {
+            copyFail(ctx, dst);
+            free(src);
+            free(dst);
+            free(job);
+            return;
+        }
+        pthread_mutex_lock(&ctx->lock);
+        vectorPush(&ctx->dirs, job);
+        pthread_mutex_unlock(&ctx->lock);
+        poolSubmit(&ctx->pool, copyDirJob, job);
+    }
+    else if(S_ISREG(sb->st_mode) || S_ISLNK(sb->st_mode))
+    {
+        poolSubmit(&ctx->pool, copyFileJob, job);
+    }
+    else
+    {
+        free(src);
+        free(dst);
+        free(job);
+    }
+}
+
+Void copyDirJob(Any arg)
+{
+    ShipCopyJob* job = (ShipCopyJob*)arg;
+    ShipCopyContext* ctx = job->ctx;
+    DIR* d = opendir(job->src);
+    if(!d)
+    {
+        copyFail(ctx, job->src);
+        return;
+    }
+    struct dirent* ent;
+    while((ent = readdir(d)) != null)
+    {
+        if(strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) continue;
+        Int8* src = pathJoin(job->src, ent->d_name);
+        struct stat sb;
+        if(lstat(src, &sb) != 0)
+        {
+            copyFail(ctx, src);
+            free(src);
+            continue;
+        }
+        copySubmit(ctx, src, pathJoin(job->dst, ent->d_name), &sb);
+    }
+    closedir(d);
+}
+
+/// @brief Recursively copy src to dst, preserving modes and timestamps
+Bool copyTree(CharSeq src, CharSeq dst, ShipString* err, UInt64* files, UInt64* bytes)
+{
+    struct stat sb;
+    if(lstat(src, &sb) != 0)
+    {
+        Int8 msg[1024];
+        snprintf(msg, sizeof(msg), "Source not found: %s", src);
+        stringFree(err);
+        *err = stringFrom(msg);
+        return false;
+    }
+    ShipCopyContext ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    pthread_mutex_init(&ctx.lock, null);
+    vectorInit(&ctx.dirs);
+    poolInit(&ctx.pool, S_ISDIR(sb.st_mode) ? (Size)cpuCount() * 2 : 1);
+    copySubmit(&ctx, stringFrom(src).data, stringFrom(dst).data, &sb);
+    poolDestroy(&ctx.pool);
+
+    for(Size i = 0; i < ctx.dirs.length; i++)
+    {
+        ShipCopyJob* job = (ShipCopyJob*)ctx.dirs.data[i];
+        struct timespec times[2] = { job->sb.st_atim, job->sb.st_mtim };
+        chmod(job->dst, job->sb.st_mode & 07777);
+        utimensat(AT_FDCWD, job->dst, times, 0);
+        free(job->src);
+        free(job->dst);
+        free(job);
+    }
+    free(ctx.dirs.data);
+    pthread_mutex_destroy(&ctx.lock);
+    if(files) *files = ctx.files;
+    if(bytes) *bytes = ctx.bytes;
+    if(ctx.error)
+    {
+        Int8 msg[1024];
+        snprintf(msg, sizeof(msg), "%s: %s", ctx.error_path, strerror(ctx.error));
+        stringFree(err);
+        *err = stringFrom(msg);
+        free(ctx.error_path);
+        return false;
+    }
+    return true;
+}
+
+#ifdef __linux__
+typedef struct
+{
+    UInt64 d_ino;
+    Int64 d_off;
+    UInt16 d_reclen;
+    UInt8 d_type;
+    Int8 d_name[];
+} ShipDirent64;
+#endif
+
+/// @brief Start reading an open directory fd; the reader owns the fd
+Bool dirOpen(ShipDirReader* r, Int32 fd)
+{
+    r->fd = fd;
+#ifdef __linux__
+    r->buffer = (UInt8*)malloc(1 << 15);
+    r->length = 0;
+    r->pos = 0;
+    return true;
+#else
+    r->dir = fdopendir(fd);
+    return r->dir != null;
+#endif
+}
+
+/// @brief Next entry other than . and ..; type is a DT_* value, possibly DT_UNKNOWN
+Bool dirNext(ShipDirReader* r, CharSeq* name, UInt8* type)
+{
+#ifdef __linux__
+    while(true)
+    {
+        if(r->pos >= r->length)
+        {
+            long n = syscall(SYS_getdents64, r->fd, r->buffer, 1 << 15);
+            if(n <= 0)
+            {
+                return false;
+            }
+            r->length = (Size)n;
+            r->pos = 0;
+        }
+        ShipDirent64* e = (ShipDirent64*)(r->buffer + r->pos);
+        r->pos += e->d_reclen;
+        if(e->d_name[0] == '.' && (e->d_name[1] == '\0' || (e->d_name[1] == '.' && e->d_name[2] == '\0'))) continue;
+        *name = e->d_name;
+        *type = e->d_type;
+        return true;
+    }
+#else
+    struct dirent* e;
+    while((e = readdir(r->dir)) != null)
+    {
+        if(strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0) continue;
+        *name = e->d_name;
+        *type = e->d_type;
+        return true;
+    }
+    return false;
+#endif
+}
+
+Void dirClose(ShipDirReader* r)
+{
+#ifdef __linux__
+    free(r->buffer);
+    close(r->fd);
+#else
+    closedir(r->dir);
+#endif
+}
+
+/// @brief Display path of name inside dir, rebuilt from the chain of parents
+Int8* deletePath(ShipDeleteDir* dir, CharSeq name)
+{
+    Size length = name ? strlen(name) : 0;
+    for(ShipDeleteDir* d = dir; d; d = d->parent)
+    {
+        length += strlen(d->name) + 1;
+    }
+    Int8* out = (Int8*)malloc(length + 1);
+    Int8* at = out + length;
+    *at = '\0';
+    if(name)
+    {
+        at -= strlen(name);
+        memcpy(at, name, strlen(name));
+        *--at = '/';
+    }
+    for(ShipDeleteDir* d = dir; d; d = d->parent)
+    {
+        Size n = strlen(d->name);
+        at -= n;
+        memcpy(at, d->name, n);
+        if(d->parent) *--at = '/';
+    }
+    // the root name carries no separator slot of its own
+    if(at != out) memmove(out, at, strlen(at) + 1);
+    return out;
+}
+
+Void deleteFail(ShipDeleteDir* dir, CharSeq name)
+{
+    Int32 err = errno ? errno : EIO;
+    ShipDeleteContext* ctx = dir->ctx;
+    pthread_mutex_lock(&ctx->lock);
+    if(!ctx->error)
+    {
+        ctx->error = err;
+        ctx->error_path = deletePath(dir, name);
+    }
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+/// @brief Drop one reference; the last one removes the directory from its
+/// parent's fd and releases the parent
+Void deleteRelease(ShipDeleteDir* dir)
+{
+    while(dir && __atomic_sub_fetch(&dir->pending, 1, __ATOMIC_ACQ_REL) == 0)
+    {
+        ShipDeleteDir* parent = dir->parent;
+        if(dir->fd >= 0)
+        {
+            close(dir->fd);
+        }
+        if(unlinkat(parent ? parent->fd : AT_FDCWD, dir->name, AT_REMOVEDIR) != 0)
+        {
+            deleteFail(dir, null);
+        }
+        else
+        {
+            __atomic_add_fetch(&dir->ctx->removed, 1, __ATOMIC_RELAXED);
+        }
+        free(dir->name);
+        free(dir);
+        dir = parent;
+    }
+}
+
+/// @brief Worker job: unlink the files of one directory and hand its
+/// subdirectories to the pool as new work items
+Void deleteDirJob(Any arg)
+{
+    ShipDeleteDir* dir = (ShipDeleteDir*)arg;
+    ShipDeleteContext* ctx = dir->ctx;
+    // every component above this one was already opened with O_NOFOLLOW, so a
+    // directory swapped for a symlink anywhere in the tree cannot redirect us
+    dir->fd = openat(dir->parent ? dir->parent->fd : AT_FDCWD, dir->name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    Int32 scan = dir->fd >= 0 ? fcntl(dir->fd, F_DUPFD_CLOEXEC, 0) : -1;
+    ShipDirReader r;
+    if(scan < 0 || !dirOpen(&r, scan))
+    {
+        deleteFail(dir, null);
+        if(scan >= 0) close(scan);
+        deleteRelease(dir);
+        return;
+    }
+    CharSeq name;
+    UInt8 type;
+    UInt64 removed = 0;
+    while(dirNext(&r, &name, &type))
+    {
+        if(type == DT_UNKNOWN)
+        {
+            struct stat sb;
+            if(fstatat(dir->fd, name, &sb, AT_SYMLINK_NOFOLLOW) != 0)
+            {
+                if(errno != ENOENT)
+                {
+                    deleteFail(dir, name);
+                }
+                continue;
+            }
+            type = S_ISDIR(sb.st_mode) ? DT_DIR : DT_REG;
+        }
+        if(type == DT_DIR)
+        {
+            ShipDeleteDir* child = (ShipDeleteDir*)malloc(sizeof(ShipDeleteDir));
+            child->ctx = ctx;
+            child->parent = dir;
+            child->name = stringFrom(name).data;
+            child->fd = -1;
+            child->pending = 1;
+            __atomic_add_fetch(&dir->pending, 1, __ATOMIC_ACQ_REL);
+            poolSubmit(&ctx->pool, deleteDirJob, child);
+        }
+        else if(unlinkat(dir->fd, name, 0) == 0)
+        {
+            removed++;
+        }
+        else if(errno != ENOENT)
+        {
+            deleteFail(dir, name);
+        }
+    }
+    dirClose(&r);
+    __atomic_add_fetch(&ctx->removed, removed, __ATOMIC_RELAXED);
+    deleteRelease(dir);
+}
+
+/// @brief Remove a file or directory tree, emptying directories in parallel
+Bool removeTree(CharSeq path, Bool forgive_missing, ShipString* err, UInt64* removed)
+{
+    Int8 msg[1024];
+    struct stat sb;
+    if(removed) *removed = 0;
+    if(lstat(path, &sb) != 0)
+    {
+        if(errno == ENOENT && forgive_missing)
+        {
+            return true;
+        }
+        snprintf(msg, sizeof(msg), "Path not found: %s", path);
+        stringFree(err);
+        *err = stringFrom(msg);
+        return false;
+    }
+    if(!S_ISDIR(sb.st_mode))
+    {
+        if(unlink(path) != 0)
+        {
+            snprintf(msg, sizeof(msg), "%s: %s", path, strerror(errno));
+            stringFree(err);
+            *err = stringFrom(msg);
+            return false;
+        }
+        if(removed) *removed = 1;
+        return true;
+    }
+
+    ShipDeleteContext ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    pthread_mutex_init(&ctx.lock, null);
+    poolInit(&ctx.pool, (Size)cpuCount() * 2);
+    ShipDeleteDir* root = (ShipDeleteDir*)malloc(sizeof(ShipDeleteDir));
+    root->ctx = &ctx;
+    root->parent = null;
+    root->name = stringFrom(path).data;
+    root->fd = -1;
+    root->pending = 1;
+    poolSubmit(&ctx.pool, deleteDirJob, root);
+    poolDestroy(&ctx.pool);
+    pthread_mutex_destroy(&ctx.lock);
+    if(removed) *removed = ctx.removed;
+    if(ctx.error)
+    {
+        snprintf(msg, sizeof(msg), "%s: %s", ctx.error_path, strerror(ctx.error));
+        stringFree(err);
+        *err = stringFrom(msg);
+        free(ctx.error_path);
+        return false;
+    }
+    return true;
+}
+
+/// @brief Match one [...] class at *p against c; advances *p past it.
+/// Returns -1 when the bracket is unterminated and should be taken literally.
+static Int32 globClass(CharSeq* p, Int8 c)
+{
+    CharSeq q = *p + 1;
+    Bool negate = *q == '!' || *q == '^';
+    if(negate) q++;
+    Bool hit = false;
+    for(Bool first = true; *q && (first || *q != ']'); first = false)
+    {
+        Int8 lo = *q++;
+        Int8 hi = lo;
+        if(*q == '-' && q[1] && q[1] != ']')
+        {
+            hi = q[1];
+            q += 2;
+        }
+        if(c >= lo && c <= hi) hit = true;
+    }
+    if(*q != ']')
+    {
+        return -1;
+    }
+    *p = q + 1;
+    return hit != negate;
+}
+
+/// @brief s starts a path segment with a dot, which wildcards never match
+simple Bool globHidden(CharSeq s, CharSeq base)
+{
+    return *s == '.' && (s == base || s[-1] == '/');
+}
+
+static Bool globMatchAt(CharSeq p, CharSeq s, CharSeq base)
+{
+    while(*p)
+    {
+        if(p[0] == '*' && p[1] == '*')
+        {
+            p += 2;
+            Bool dirs = *p == '/';
+            if(dirs) p++;
+            for(;; s++)
+            {
+                if((!dirs || s == base || s[-1] == '/') && globMatchAt(p, s, base)) return true;
+                if(!*s || globHidden(s, base)) return false;
+            }
+        }
+        if(*p == '*')
+        {
+            p++;
+            for(;; s++)
+            {
+                if(globMatchAt(p, s, base)) return true;
+                if(!*s || *s == '/' || globHidden(s, base)) return false;
+            }
+        }
+        if(!*s)
+        {
+            return false;
+        }
+        if(*p == '?' && *s != '/' && !globHidden(s, base))
+        {
+            p++;
+            s++;
+            continue;
+        }
+        if(*p == '[' && *s != '/')
+        {
+            Int32 r = globClass(&p, *s);
+            if(r == 0) return false;
+            if(r > 0)
+            {
+                s++;
+                continue;
+            }
+        }
+        if(*p == '\\' && p[1]) p++;
+        if(*p != *s)
+        {
+            return false;
+        }
+        p++;
+        s++;
+    }
+    return !*s;
+}
+
+/// @brief Shell-style match of a '/'-separated relative path: `*`, `?` and
+/// `[...]` stay within one segment, `**` spans any number of them and
+/// `**/` may also match none, so `src/**/*.c` matches `src/main.c`.
+/// As in the shell, wildcards skip names starting with a dot.
+Bool globMatch(CharSeq pattern, CharSeq path)
+{
+    return globMatchAt(pattern, path, path);
+}
+
+/// @brief path matches one of the patterns held in v
+static Bool globAny(ShipVector* v, CharSeq path)
+{
+    for(Size i = 0; i < v->length; i++)
+    {
+        if(globMatch((CharSeq)v->data[i], path)) return true;
+    }
+    return false;
+}
+
+Void listFail(ShipListContext* ctx, CharSeq path)
+{
+    Int32 err = errno ? errno : EIO;
+    pthread_mutex_lock(&ctx->lock);
+    if(!ctx->error)
+    {
+        ctx->error = err;
+        ctx->error_path = stringFrom(path).data;
+    }
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+/// @brief Worker job: match the entries of one directory and hand its
+/// subdirectories to the pool as new work items
+Void listDirJob(Any arg)
+{
+    ShipListJob* job = (ShipListJob*)arg;
+    ShipListContext* ctx = job->ctx;
+    Int8* dir = job->rel[0] ? pathJoin(ctx->root, job->rel) : stringFrom(ctx->root).data;
+    Int32 fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    ShipDirReader r;
+    if(fd < 0 || !dirOpen(&r, fd))
+    {
+        listFail(ctx, dir);
+        if(fd >= 0) close(fd);
+        free(dir);
+        free(job->rel);
+        free(job);
+        return;
+    }
+    ShipVector found;
+    vectorInit(&found);
+    CharSeq name;
+    UInt8 type;
+    while(dirNext(&r, &name, &type))
+    {
+        if(type == DT_UNKNOWN)
+        {
+            struct stat sb;
+            if(fstatat(fd, name, &sb, AT_SYMLINK_NOFOLLOW) == 0)
+            {
+                type = S_ISDIR(sb.st_mode) ? DT_DIR : S_ISLNK(sb.st_mode) ? DT_LNK : DT_REG;
+            }
+        }
+        Int8* rel = job->rel[0] ? pathJoin(job->rel, name) : stringFrom(name).data;
+        if(globAny(&ctx->exclude, rel))
+        {
+            free(rel);
+            continue;
+        }
+        Bool wanted = ctx->type == 0 || (ctx->type == DT_DIR) == (type == DT_DIR);
+        if(wanted && globAny(&ctx->include, rel))
+        {
+            vectorPush(&found, stringFrom(rel).data);
+        }
+        if(type == DT_DIR && ctx->recursive)
+        {
+            ShipListJob* child = (ShipListJob*)malloc(sizeof(ShipListJob));
+            child->ctx = ctx;
+            child->rel = rel;
+            poolSubmit(&ctx->pool, listDirJob, child);
+        }
+        else
+        {
+            free(rel);
+        }
+    }
+    dirClose(&r);
+    if(found.length > 0)
+    {
+        pthread_mutex_lock(&ctx->lock);
+        for(Size i = 0; i < found.length; i++)
+        {
+            vectorPush(&ctx->matches, found.data[i]);
+        }
+        pthread_mutex_unlock(&ctx->lock);
+    }
+    free(found.data);
+    free(dir);
+    free(job->rel);
+    free(job);
+}
+
+static Int32 listCompare(const Void* a, const Void* b)
+{
+    return strcmp(*(CharSeq*)a, *(CharSeq*)b);
+}
+
+/// @brief Walk ctx->root, descending only when a pattern spans directories,
+/// and leave the sorted root-relative matches in ctx->matches. Excluded
+/// directories are not entered.
+Bool listTree(ShipListContext* ctx)
+{
+    ctx->recursive = false;
+    for(Size i = 0; i < ctx->include.length; i++)
+    {
+        if(strchr((CharSeq)ctx->include.data[i], '/') || strstr((CharSeq)ctx->include.data[i], "**"))
+        {
+            ctx->recursive = true;
+        }
+    }
+    vectorInit(&ctx->matches);
+    ctx->error = 0;
+    ctx->error_path = null;
+    pthread_mutex_init(&ctx->lock, null);
+    poolInit(&ctx->pool, ctx->recursive ? (Size)cpuCount() * 2 : 1);
+    ShipListJob* root = (ShipListJob*)malloc(sizeof(ShipListJob));
+    root->ctx = ctx;
+    root->rel = stringFrom("").data;
+    poolSubmit(&ctx->pool, listDirJob, root);
+    poolDestroy(&ctx->pool);
+    pthread_mutex_destroy(&ctx->lock);
+    qsort(ctx->matches.data, ctx->matches.length, sizeof(Any), listCompare);
+    return ctx->error == 0;
+}
+
+/// @brief rename(2) when possible, otherwise copy across devices and remove the source
+Bool movePath(CharSeq src, CharSeq dst, ShipString* err)
+{
+    if(rename(src, dst) == 0)
+    {
+        return true;
+    }
+    if(errno != EXDEV)
+    {
+        Int8 msg[1024];
+        snprintf(msg, sizeof(msg), "%s: %s", src, strerror(errno));
+        stringFree(err);
+        *err = stringFrom(msg);
+        return false;
+    }
+    if(!copyTree(src, dst, err, null, null))
+    {
+        return false;
+    }
+    return removeTree(src, false, err, null);
+}
+
+/// @brief cp/mv target rule: an existing directory receives src by its basename;
+/// null (with err set) when the target would land on or inside src
+Int8* copyTarget(CharSeq src, CharSeq dst, CharSeq verb, ShipString* err)
+{
+    struct stat sb;
+    Int8* out = null;
+    if(stat(dst, &sb) == 0 && S_ISDIR(sb.st_mode))
+    {
+        Size len = strlen(src);
+        while(len > 1 && src[len - 1] == '/') len--;
+        Size start = len;
+        while(start > 0 && src[start - 1] != '/') start--;
+        Int8* base = (Int8*)malloc(len - start + 1);
+        memcpy(base, src + start, len - start);
+        base[len - start] = '\0';
+        out = pathJoin(dst, base);
+        free(base);
+    }
+    else
+    {
+        out = stringFrom(dst).data;
+    }
+    // a symlink is copied or moved as the link itself, never into its target
+    if(lstat(src, &sb) == 0 && !S_ISLNK(sb.st_mode) && pathWithin(out, src))
+    {
+        Int8 msg[1024];
+        snprintf(msg, sizeof(msg), "Cannot %s %s into itself: %s", verb, src, out);
+        stringFree(err);
+        *err = stringFrom(msg);
+        free(out);
+        return null;
+    }
+    pathMakeParents(out);
+    return out;
+}
+
+ShipResult shipCopy(ShipMap args)
+{
+    ShipString* src = valueAsString(mapGetStr(&args, "src"));
+    ShipString* dst = valueAsString(mapGetStr(&args, "dst"));
+    ShipResult res = {0};
+    res.returncode = 0;
+    res.stdout_str = stringFrom("");
+    res.stderr_str = stringFrom("");
+    if(src && dst)
+    {
+        Int8* target = copyTarget(src->data, dst->data, "copy", &res.stderr_str);
+        UInt64 files = 0;
+        UInt64 bytes = 0;
+        if(!target)
+        {
+            res.returncode = 1;
+        }
+        else if(copyTree(src->data, target, &res.stderr_str, &files, &bytes))
+        {
+            Int8 msg[256];
+            snprintf(msg, sizeof(msg), "Copied %lu files (%.2f MB)", files, (Float64)bytes / (1024 * 1024));
+            stringFree(&res.stdout_str);
+            res.stdout_str = stringFrom(msg);
+        }
+        else
+        {
+            res.returncode = 1;
+        }
+        free(target);
+    }
+    return res;
+}
+
+ShipResult shipMove(ShipMap args)
+{
+    ShipString* src = valueAsString(mapGetStr(&args, "src"));
+    ShipString* dst = valueAsString(mapGetStr(&args, "dst"));
+    ShipResult res = {0};
+    res.returncode = 0;
+    res.stdout_str = stringFrom("");
+    res.stderr_str = stringFrom("");
+    if(src && dst)
+    {
+        Int8* target = copyTarget(src->data, dst->data, "move", &res.stderr_str);
+        if(!target || !movePath(src->data, target, &res.stderr_str))
+        {
+            res.returncode = 1;
+        }
+        free(target);
+    }
+    return res;
+}
+
+/// @brief Extensions whose content is already compressed and is stored as-is
+Bool zipIsCompressed(CharSeq name)
+{
+    static CharSeq exts[] = {
+        ".zip", ".gz", ".tgz", ".bz2", ".xz", ".zst", ".7z", ".rar", ".jar", ".whl", ".apk",
+        ".png", ".jpg", ".jpeg", ".gif", ".webp", ".mp3", ".mp4", ".mkv", ".ogg", ".woff", ".woff2", null
+    };
+    CharSeq dot = strrchr(name, '.');
+    if(!dot) return false;
+    for(Size i = 0; exts[i]; i++)
+    {
+        if(strcasecmp(dot, exts[i]) == 0) return true;
+    }
+    return false;
+}
+
+Void zipAddEntry(ShipZipWriter* w, CharSeq path, CharSeq name, struct stat* sb)
+{
+    if(w->count == w->capacity)
+    {
+        w->capacity = w->capacity == 0 ? 64 : w->capacity * 2;
+        w->entries = (ShipZipEntry*)realloc(w->entries, w->capacity * sizeof(ShipZipEntry));
+    }
+    ShipZipEntry* e = &w->entries[w->count++];
+    memset(e, 0, sizeof(ShipZipEntry));
+    e->path = stringFrom(path).data;
+    e->name = stringFrom(name).data;
+    e->size = (UInt64)sb->st_size;
+    e->mode = (UInt32)sb->st_mode;
+    e->mtime = (Int64)sb->st_mtime;
+    e->writer = w;
+}
+
+/// @brief Collect regular files below dir; name is the archive-relative prefix
+Void zipCollect(ShipZipWriter* w, CharSeq dir, CharSeq prefix, struct stat* skip)
+{
+    DIR* d = opendir(dir);
+    if(!d)
+    {
+        return;
+    }
+    struct dirent* ent;
+    while((ent = readdir(d)) != null)
+    {
+        if(strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) continue;
+        Int8* path = pathJoin(dir, ent->d_name);
+        Int8* name = prefix[0] ? pathJoin(prefix, ent->d_name) : stringFrom(ent->d_name).data;
+        struct stat sb;
+        if(lstat(path, &sb) == 0)
+        {
+            if(S_ISDIR(sb.st_mode))
+            {
+                zipCollect(w, path, name, skip);
+            }
+            else if((S_ISREG(sb.st_mode) || (S_ISLNK(sb.st_mode) && stat(path, &sb) == 0 && S_ISREG(sb.st_mode)))
+                    && !(sb.st_dev == skip->st_dev && sb.st_ino == skip->st_ino))
+            {
+                zipAddEntry(w, path, name, &sb);
+            }
+        }
+        free(path);
+        free(name);
+    }
+    closedir(d);
+}
+
+Int32 zipCompareEntries(const Void* a, const Void* b)
+{
+    return strcmp(((const ShipZipEntry*)a)->name, ((const ShipZipEntry*)b)->name);
+}
+
+Bool zipReadWhole(CharSeq path, UInt8* buf, UInt64 size)
+{
+    Int32 fd = open(path, O_RDONLY);
+    if(fd < 0)
+    {
+        return false;
+    }
+    UInt64 done = 0;
+    while(done < size)
+    {
+        ssize_t n = read(fd, buf + done, size - done);
+        if(n <= 0) break;
+        done += (UInt64)n;
+    }
+    close(fd);
+    return done == size;
+}
+
+/// @brief Worker job: read one small entry and deflate it into memory
+Void zipCompressJob(Any arg)
+{
+    ShipZipEntry* e = (ShipZipEntry*)arg;
+    ShipZipWriter* w = e->writer;
+    UInt8* raw = (UInt8*)malloc(e->size ? e->size : 1);
+    Bool ok = zipReadWhole(e->path, raw, e->size);
+    if(ok)
+    {
+        e->crc = (UInt32)crc32(0L, raw, (uInt)e->size);
+        e->method = 0;
+        e->csize = e->size;
+        e->data = raw;
+        if(!w->store_only && e->size > 0 && !zipIsCompressed(e->name))
+        {
+            z_stream zs;
+            memset(&zs, 0, sizeof(zs));
+            deflateInit2(&zs, w->level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+            uLong bound = deflateBound(&zs, (uLong)e->size);
+            UInt8* packed_data = (UInt8*)malloc(bound);
+            zs.next_in = raw;
+            zs.avail_in = (uInt)e->size;
+            zs.next_out = packed_data;
+            zs.avail_out = (uInt)bound;
+            if(deflate(&zs, Z_FINISH) == Z_STREAM_END && zs.total_out < e->size)
+            {
+                e->method = 8;
+                e->csize = zs.total_out;
+                e->data = packed_data;
+                free(raw);
+            }
+            else
+            {
+                free(packed_data);
+            }
+            deflateEnd(&zs);
+        }
+    }
+    else
+    {
+        free(raw);
+    }
+    pthread_mutex_lock(&w->lock);
+    e->ready = true;
+    e->failed = !ok;
+    pthread_cond_broadcast(&w->done);
+    pthread_mutex_unlock(&w->lock);
+}
+
+simple Void zipPut16(UInt8* p, UInt16 v) { p[0] = (UInt8)v; p[1] = (UInt8)(v >> 8); }
+simple Void zipPut32(UInt8* p, UInt32 v) { zipPut16(p, (UInt16)v); zipPut16(p + 2, (UInt16)(v >> 16)); }
+simple Void zipPut64(UInt8* p, UInt64 v) { zipPut32(p, (UInt32)v); zipPut32(p + 4, (UInt32)(v >> 32)); }
+
+Void zipDosTime(Int64 mtime, UInt16* dos_time, UInt16* dos_date)
+{
+    time_t t = (time_t)mtime;
+    struct tm tm;
+    localtime_r(&t, &tm);
+    if(tm.tm_year < 80)
+    {
+        tm.tm_year = 80; tm.tm_mon = 0; tm.tm_mday = 1;
+        tm.tm_hour = 0; tm.tm_min = 0; tm.tm_sec = 0;
+    }
+    *dos_time = (UInt16)((tm.tm_hour << 11) | (tm.tm_min << 5) | (tm.tm_sec / 2));
+    *dos_date = (UInt16)(((tm.tm_year - 80) << 9) | ((tm.tm_mon + 1) << 5) | tm.tm_mday);
+}
+
+/// @brief Write a local file header; zip64 entries carry their sizes in the extra field
+Bool zipWriteLocal(FILE* out, ShipZipEntry* e, UInt64* offset)
+{
+    UInt8 h[30 + 20];
+    Size name_len = strlen(e->name);
+    UInt16 dos_time, dos_date;
+    zipDosTime(e->mtime, &dos_time, &dos_date);
+    zipPut32(h, 0x04034b50);
+    zipPut16(h + 4, e->zip64 ? 45 : 20);
+    zipPut16(h + 6, 0x0800);
+    zipPut16(h + 8, e->method);
+    zipPut16(h + 10, dos_time);
+    zipPut16(h + 12, dos_date);
+    zipPut32(h + 14, e->crc);
+    zipPut32(h + 18, e->zip64 ? 0xFFFFFFFF : (UInt32)e->csize);
+    zipPut32(h + 22, e->zip64 ? 0xFFFFFFFF : (UInt32)e->size);
+    zipPut16(h + 26, (UInt16)name_len);
+    zipPut16(h + 28, e->zip64 ? 20 : 0);
+    e->offset = *offset;
+    if(fwrite(h, 1, 30, out) != 30 || fwrite(e->name, 1, name_len, out) != name_len)
+    {
+        return false;
+    }
+    *offset += 30 + name_len;
+    if(e->zip64)
+    {
+        UInt8* x = h + 30;
+        zipPut16(x, 0x0001);
+        zipPut16(x + 2, 16);
+        zipPut64(x + 4, e->size);
+        zipPut64(x + 12, e->csize);
+        if(fwrite(x, 1, 20, out) != 20) return false;
+        *offset += 20;
+    }
+    return true;
+}
+
+/// @brief Worker job: read one slice of a large entry and deflate it with a
+/// full flush, so it needs nothing from the slices around it
+Void zipChunkJob(Any arg)
+{
+    ShipZipChunk* c = (ShipZipChunk*)arg;
+    ShipZipEntry* e = c->entry;
+    ShipZipWriter* w = e->writer;
+    UInt8* raw = (UInt8*)malloc(c->length);
+    Size done = 0;
+    while(done < c->length)
+    {
+        ssize_t n = pread(c->fd, raw + done, c->length - done, (off_t)(c->offset + done));
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0) break;
+        done += (Size)n;
+    }
+    Bool ok = done == c->length;
+    if(ok)
+    {
+        c->crc = (UInt32)crc32(0L, raw, (uInt)c->length);
+        c->data = raw;
+        c->csize = c->length;
+        if(e->method == 8)
+        {
+            z_stream zs;
+            memset(&zs, 0, sizeof(zs));
+            deflateInit2(&zs, w->level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+            // deflateBound covers Z_FINISH; a flush adds a few bytes of its own
+            uLong bound = deflateBound(&zs, (uLong)c->length) + 64;
+            UInt8* packed_data = (UInt8*)malloc(bound);
+            zs.next_in = raw;
+            zs.avail_in = (uInt)c->length;
+            zs.next_out = packed_data;
+            zs.avail_out = (uInt)bound;
+            Int32 zr = deflate(&zs, c->last ? Z_FINISH : Z_FULL_FLUSH);
+            ok = c->last ? zr == Z_STREAM_END : zr == Z_OK && zs.avail_in == 0 && zs.avail_out > 0;
+            c->data = packed_data;
+            c->csize = zs.total_out;
+            deflateEnd(&zs);
+            free(raw);
+        }
+    }
+    else
+    {
+        free(raw);
+    }
+    pthread_mutex_lock(&w->lock);
+    c->ready = true;
+    c->failed = !ok;
+    pthread_cond_broadcast(&w->done);
+    pthread_mutex_unlock(&w->lock);
+}
+
+/// @brief Write a large entry whose slices are read and deflated on the pool,
+/// keeping a bounded window in flight; then patch crc and size
+Bool zipStreamEntry(ShipZipWriter* w, ShipPool* pool, ShipZipEntry* e, FILE* out, UInt64* offset)
+{
+    Int32 fd = open(e->path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+    {
+        return false;
+    }
+    e->method = (w->store_only || zipIsCompressed(e->name)) ? 0 : 8;
+    e->zip64 = true;
+    e->crc = 0;
+    e->csize = 0;
+    if(!zipWriteLocal(out, e, offset))
+    {
+        close(fd);
+        return false;
+    }
+
+    Size count = (Size)((e->size + SHIP_ZIP_CHUNK - 1) / SHIP_ZIP_CHUNK);
+    Size window = pool->thread_count * 2;
+    ShipZipChunk* chunks = (ShipZipChunk*)calloc(count, sizeof(ShipZipChunk));
+    UInt32 crc = (UInt32)crc32(0L, null, 0);
+    Size next = 0;
+    Bool ok = true;
+    for(Size i = 0; i < count; i++)
+    {
+        while(ok && next < count && next - i < window)
+        {
+            ShipZipChunk* c = &chunks[next];
+            c->entry = e;
+            c->fd = fd;
+            c->offset = (UInt64)next * SHIP_ZIP_CHUNK;
+            c->length = (Size)(e->size - c->offset < SHIP_ZIP_CHUNK ? e->size - c->offset : SHIP_ZIP_CHUNK);
+            c->last = next == count - 1;
+            poolSubmit(pool, zipChunkJob, c);
+            next++;
+        }
+        if(i == next)
+        {
+            // a slice failed and nothing later was started
+            break;
+        }
+        ShipZipChunk* c = &chunks[i];
+        pthread_mutex_lock(&w->lock);
+        while(!c->ready)
+        {
+            pthread_cond_wait(&w->done, &w->lock);
+        }
+        pthread_mutex_unlock(&w->lock);
+        ok = ok && !c->failed && fwrite(c->data, 1, c->csize, out) == c->csize;
+        crc = (UInt32)crc32_combine(crc, c->crc, (z_off_t)c->length);
+        e->csize += c->csize;
+        free(c->data);
+    }
+    free(chunks);
+    close(fd);
+    e->crc = crc;
+    *offset += e->csize;
+
+    UInt8 patch[8];
+    Size name_len = strlen(e->name);
+    zipPut32(patch, crc);
+    ok = ok && fseeko(out, (off_t)(e->offset + 14), SEEK_SET) == 0 && fwrite(patch, 1, 4, out) == 4;
+    zipPut64(patch, e->csize);
+    ok = ok && fseeko(out, (off_t)(e->offset + 30 + name_len + 12), SEEK_SET) == 0 && fwrite(patch, 1, 8, out) == 8;
+    ok = ok && fseeko(out, (off_t)*offset, SEEK_SET) == 0;
+    return ok;
+}
+
+Bool zipWriteCentral(FILE* out, ShipZipEntry* e)
+{
+    Bool big_sizes = e->zip64 || e->size >= SHIP_ZIP64_LIMIT || e->csize >= SHIP_ZIP64_LIMIT;
+    Bool big_offset = e->offset >= SHIP_ZIP64_LIMIT;
+    Size name_len = strlen(e->name);
+    UInt8 h[46];
+    UInt8 x[28];
+    Size xlen = 0;
+    if(big_sizes || big_offset)
+    {
+        zipPut16(x, 0x0001);
+        xlen = 4;
+        if(big_sizes)
+        {
+            zipPut64(x + xlen, e->size);
+            zipPut64(x + xlen + 8, e->csize);
+            xlen += 16;
+        }
+        if(big_offset)
+        {
+            zipPut64(x + xlen, e->offset);
+            xlen += 8;
+        }
+        zipPut16(x + 2, (UInt16)(xlen - 4));
+    }
+    UInt16 dos_time, dos_date;
+    zipDosTime(e->mtime, &dos_time, &dos_date);
+    zipPut32(h, 0x02014b50);
+    zipPut16(h + 4, (3 << 8) | 45);
+    zipPut16(h + 6, xlen ? 45 : 20);
+    zipPut16(h + 8, 0x0800);
+    zipPut16(h + 10, e->method);
+    zipPut16(h + 12, dos_time);
+    zipPut16(h + 14, dos_date);
+    zipPut32(h + 16, e->crc);
+    zipPut32(h + 20, big_sizes ? 0xFFFFFFFF : (UInt32)e->csize);
+    zipPut32(h + 24, big_sizes ? 0xFFFFFFFF : (UInt32)e->size);
+    zipPut16(h + 28, (UInt16)name_len);
+    zipPut16(h + 30, (UInt16)xlen);
+    zipPut16(h + 32, 0);
+    zipPut16(h + 34, 0);
+    zipPut16(h + 36, 0);
+    zipPut32(h + 38, e->mode << 16);
+    zipPut32(h + 42, big_offset ? 0xFFFFFFFF : (UInt32)e->offset);
+    return fwrite(h, 1, 46, out) == 46
+        && fwrite(e->name, 1, name_len, out) == name_len
+        && fwrite(x, 1, xlen, out) == xlen;
+}
+
+/// @brief End of central directory, with the zip64 record and locator when needed
+Bool zipWriteEnd(FILE* out, UInt64 entries, UInt64 cd_offset, UInt64 cd_size)
+{
+    Bool zip64 = entries >= 0xFFFF || cd_offset >= SHIP_ZIP64_LIMIT || cd_size >= SHIP_ZIP64_LIMIT;
+    if(zip64)
+    {
+        UInt8 r[56 + 20];
+        zipPut32(r, 0x06064b50);
+        zipPut64(r + 4, 44);
+        zipPut16(r + 12, (3 << 8) | 45);
+        zipPut16(r + 14, 45);
+        zipPut32(r + 16, 0);
+        zipPut32(r + 20, 0);
+        zipPut64(r + 24, entries);
+        zipPut64(r + 32, entries);
+        zipPut64(r + 40, cd_size);
+        zipPut64(r + 48, cd_offset);
+        zipPut32(r + 56, 0x07064b50);
+        zipPut32(r + 60, 0);
+        zipPut64(r + 64, cd_offset + cd_size);
+        zipPut32(r + 72, 1);
+        if(fwrite(r, 1, sizeof(r), out) != sizeof(r)) return false;
+    }
+    UInt8 e[22];
+    zipPut32(e, 0x06054b50);
+    zipPut16(e + 4, 0);
+    zipPut16(e + 6, 0);
+    zipPut16(e + 8, zip64 ? 0xFFFF : (UInt16)entries);
+    zipPut16(e + 10, zip64 ? 0xFFFF : (UInt16)entries);
+    zipPut32(e + 12, zip64 ? 0xFFFFFFFF : (UInt32)cd_size);
+    zipPut32(e + 16, zip64 ? 0xFFFFFFFF : (UInt32)cd_offset);
+    zipPut16(e + 20, 0);
+    return fwrite(e, 1, 22, out) == 22;
+}
+
+/// @brief Write every entry in order. Small files are read and deflated on the
+/// pool ahead of the writer, bounded by SHIP_ZIP_INFLIGHT_BYTES; large ones are
+/// streamed by the writer itself so memory stays flat.
+Bool zipWriteArchive(ShipZipWriter* w, FILE* out, ShipString* err)
+{
+    ShipPool pool;
+    poolInit(&pool, (Size)cpuCount());
+    Size window = pool.thread_count * 4;
+    Size next = 0;
+    UInt64 inflight = 0;
+    UInt64 offset = 0;
+    Bool ok = true;
+    for(Size i = 0; i < w->count && ok; i++)
+    {
+        while(next < w->count && next - i < window && (inflight < SHIP_ZIP_INFLIGHT_BYTES || next == i))
+        {
+            ShipZipEntry* e = &w->entries[next++];
+            if(e->size > SHIP_ZIP_STREAM_THRESHOLD) continue;
+            inflight += e->size;
+            poolSubmit(&pool, zipCompressJob, e);
+        }
+        ShipZipEntry* e = &w->entries[i];
+        if(e->size > SHIP_ZIP_STREAM_THRESHOLD)
+        {
+            ok = zipStreamEntry(w, &pool, e, out, &offset);
+        }
+        else
+        {
+            pthread_mutex_lock(&w->lock);
+            while(!e->ready)
+            {
+                pthread_cond_wait(&w->done, &w->lock);
+            }
+            pthread_mutex_unlock(&w->lock);
+            inflight -= e->size;
+            ok = !e->failed && zipWriteLocal(out, e, &offset) && fwrite(e->data, 1, e->csize, out) == e->csize;
+            offset += e->csize;
+            free(e->data);
+            e->data = null;
+        }
+        if(!ok)
+        {
+            Int8 buf[1024];
+            snprintf(buf, sizeof(buf), "Failed to add %s: %s", e->path, strerror(errno));
+            stringFree(err);
+            *err = stringFrom(buf);
+        }
+    }
+    poolDestroy(&pool);
+    for(Size i = 0; i < w->count; i++)
+    {
+        free(w->entries[i].data);
+    }
+    if(!ok)
+    {
+        return false;
+    }
+
+    UInt64 cd_offset = offset;
+    for(Size i = 0; i < w->count && ok; i++)
+    {
+        ok = zipWriteCentral(out, &w->entries[i]);
+    }
+    UInt64 cd_size = (UInt64)ftello(out) - cd_offset;
+    ok = ok && zipWriteEnd(out, w->count, cd_offset, cd_size);
+    if(!ok)
+    {
+        stringFree(err);
+        *err = stringFrom("Failed to write central directory");
+    }
+    return ok;
+}
+
+ShipResult shipZip(ShipMap args)
+{
+    ShipString* src = valueAsString(mapGetStr(&args, "src"));
+    ShipValue* files = mapGetStr(&args, "files");
+    ShipString* zip_path = valueAsString(mapGetStr(&args, "zip_path"));
+    ShipValue* level = mapGetStr(&args, "level");
+    Bool store = valueAsBool(mapGetStr(&args, "store"), false);
+    ShipResult res = {0};
+    res.returncode = 0;
+    res.stdout_str = stringFrom("");
+    res.stderr_str = stringFrom("");
+    if((!src && !files) || !zip_path)
+    {
+        res.returncode = -1;
+        return res;
+    }
+    Int8 msg[1024];
+    struct stat sb;
+    if(src && stat(src->data, &sb) != 0)
+    {
+        snprintf(msg, sizeof(msg), "Source directory not found: %s", src->data);
+        stringFree(&res.stderr_str);
+        res.stderr_str = stringFrom(msg);
+        res.returncode = 1;
+        return res;
+    }
+    pathMakeParents(zip_path->data);
+    FILE* out = fopen(zip_path->data, "wb");
+    if(!out)
+    {
+        snprintf(msg, sizeof(msg), "Cannot create %s: %s", zip_path->data, strerror(errno));
+        stringFree(&res.stderr_str);
+        res.stderr_str = stringFrom(msg);
+        res.returncode = 1;
+        return res;
+    }
+    setvbuf(out, null, _IOFBF, 1 << 20);
+    struct stat self;
+    fstat(fileno(out), &self);
+
+    ShipZipWriter w;
+    memset(&w, 0, sizeof(w));
+    w.level = (Int32)valueAsNumber(level, Z_DEFAULT_COMPRESSION);
+    w.store_only = store;
+    pthread_mutex_init(&w.lock, null);
+    pthread_cond_init(&w.done, null);
+    if(!src)
+    {
+        // an explicit file list, typically "@id" of a list task; entries
+        // keep their paths, and directories in it are skipped
+        Size count = files->type == SHIP_VALUE_LIST ? files->list.count : 1;
+        for(Size i = 0; i < count; i++)
+        {
+            ShipString* f = valueAsString(files->type == SHIP_VALUE_LIST ? &files->list.items[i] : files);
+            if(!f || stat(f->data, &sb) != 0 || !S_ISREG(sb.st_mode)) continue;
+            if(sb.st_dev == self.st_dev && sb.st_ino == self.st_ino) continue;
+            CharSeq name = f->data;
+            while(name[0] == '.' && name[1] == '/') name += 2;
+            zipAddEntry(&w, f->data, name, &sb);
+        }
+    }
+    else if(S_ISDIR(sb.st_mode))
+    {
+        zipCollect(&w, src->data, "", &self);
+    }
+    else
+    {
+        CharSeq base = strrchr(src->data, '/');
+        zipAddEntry(&w, src->data, base ? base + 1 : src->data, &sb);
+    }
+    qsort(w.entries, w.count, sizeof(ShipZipEntry), zipCompareEntries);
+
+    Bool ok = zipWriteArchive(&w, out, &res.stderr_str);
+    ok = fclose(out) == 0 && ok;
+    if(ok)
+    {
+        stat(zip_path->data, &sb);
+        snprintf(msg, sizeof(msg), "Zipped %lu files (%.2f MB)", (UInt64)w.count, (Float64)sb.st_size / (1024 * 1024));
+        stringFree(&res.stdout_str);
+        res.stdout_str = stringFrom(msg);
+    }
+    else
+    {
+        unlink(zip_path->data);
+        res.returncode = 1;
+    }
+    for(Size i = 0; i < w.count; i++)
+    {
+        free(w.entries[i].path);
+        free(w.entries[i].name);
+    }
+    free(w.entries);
+    pthread_mutex_destroy(&w.lock);
+    pthread_cond_destroy(&w.done);
+    return res;
+}
+
+/// @brief Collect glob patterns from a string or list argument
+static Void listPatterns(ShipValue* v, ShipVector* out)
+{
+    vectorInit(out);
+    if(v && v->type == SHIP_VALUE_LIST)
+    {
+        for(Size i = 0; i < v->list.count; i++)
+        {
+            ShipString* item = valueAsString(&v->list.items[i]);
+            if(item) vectorPush(out, item->data);
+        }
+    }
+    else if(valueAsString(v))
+    {
+        vectorPush(out, valueAsString(v)->data);
+    }
+}
+
+/// @brief Natively list `path` (default ".") for entries matching `pattern`
+/// (a glob or list of globs, default "*") and not `exclude`; `type` narrows
+/// it to "file" or "dir". The matches become the task's list value, which
+/// later tasks read through an "@id" argument, and are printed one per line.
+ShipResult shipList(ShipMap args)
+{
+    ShipString* path = valueAsString(mapGetStr(&args, "path"));
+    ShipString* type = valueAsString(mapGetStr(&args, "type"));
+    ShipResult res = {0};
+    res.returncode = 0;
+    res.stdout_str = stringFrom("");
+    res.stderr_str = stringFrom("");
+
+    ShipListContext ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.root = path ? path->data : ".";
+    listPatterns(mapGetStr(&args, "pattern"), &ctx.include);
+    listPatterns(mapGetStr(&args, "exclude"), &ctx.exclude);
+    if(ctx.include.length == 0)
+    {
+        vectorPush(&ctx.include, "*");
+    }
+    ctx.type = !type ? 0 : strcmp(type->data, "dir") == 0 ? DT_DIR : strcmp(type->data, "file") == 0 ? DT_REG : 0;
+    if(!listTree(&ctx))
+    {
+        Int8 msg[1024];
+        snprintf(msg, sizeof(msg), "%s: %s", ctx.error_path, strerror(ctx.error));
+        stringFree(&res.stderr_str);
+        res.stderr_str = stringFrom(msg);
+        res.returncode = 1;
+        free(ctx.error_path);
+    }
+
+    Bool prefixed = strcmp(ctx.root, ".") != 0;
+    res.value.type = SHIP_VALUE_LIST;
+    res.value.list.count = ctx.matches.length;
+    res.value.list.items = (ShipValue*)malloc((ctx.matches.length ? ctx.matches.length : 1) * sizeof(ShipValue));
+    for(Size i = 0; i < ctx.matches.length; i++)
+    {
+        Int8* rel = (Int8*)ctx.matches.data[i];
+        Int8* full = prefixed ? pathJoin(ctx.root, rel) : rel;
+        res.value.list.items[i] = valueFromString(stringFrom(full));
+        stringAppend(&res.stdout_str, full, strlen(full));
+        stringAppend(&res.stdout_str, "\n", 1);
+        if(prefixed) free(full);
+        free(rel);
+    }
+    free(ctx.matches.data);
+    free(ctx.include.data);
+    free(ctx.exclude.data);
+    return res;
+}
+
+ShipResult shipMoveAll(ShipMap args)
+{
+    ShipString* src = valueAsString(mapGetStr(&args, "src"));
+    ShipString* dst = valueAsString(mapGetStr(&args, "dst"));
+    ShipResult res = {0};
+    res.returncode = 0;
+    res.stdout_str = stringFrom("");
+    res.stderr_str = stringFrom("");
+    if(src && dst)
+    {
+        DIR* d = opendir(src->data);
+        if(!d)
+        {
+            Int8 msg[1024];
+            snprintf(msg, sizeof(msg), "Source not found: %s", src->data);
+            stringFree(&res.stderr_str);
+            res.stderr_str = stringFrom(msg);
+            res.returncode = 1;
+            return res;
+        }
+        Int8* marker = pathJoin(dst->data, ".");
+        pathMakeParents(marker);
+        free(marker);
+        UInt64 count = 0;
+        struct dirent* ent;
+        while(res.returncode == 0 && (ent = readdir(d)) != null)
+        {
+            if(strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) continue;
+            Int8* from = pathJoin(src->data, ent->d_name);
+            Int8* to = pathJoin(dst->data, ent->d_name);
+            if(movePath(from, to, &res.stderr_str))
+            {
+                count++;
+            }
+            else
+            {
+                res.returncode = 1;
+            }
+            free(from);
+            free(to);
+        }
+        closedir(d);
+        Int8 msg[1024];
+        snprintf(msg, sizeof(msg), "Moved %lu items from %s", count, src->data);
+        stringFree(&res.stdout_str);
+        res.stdout_str = stringFrom(msg);
+    }
+    return res;
+}
+
+ShipResult shipEcho(ShipMap args)
+{
+    ShipValue* msg = mapGetStr(&args, "message");
+    ShipResult r = {0};
+    r.stdout_str = msg ? valueToString(msg) : stringFrom("");
+    if(msg)
+    {
+        printf("  " CYAN ">" ENDC " %s\n", r.stdout_str.data);
+    }
+    r.returncode = 0;
+    r.stderr_str = stringFrom("");
+    return r;
+}
+
+ShipString stringEmpty()
+{
+    return stringFrom("");
+}
+
+/// @brief Load the incremental build state; a missing file yields an empty state
+Void stateLoad(ShipState* st, CharSeq path)
+{
+    mapInit(&st->files);
+    mapInit(&st->tasks);
+    st->dirty = false;
+    pthread_mutex_init(&st->lock, null);
+    FILE* f = fopen(path, "r");
+    if(!f)
+    {
+        return;
+    }
+    Int8* line = null;
+    Size cap = 0;
+    ssize_t n;
+    while((n = getline(&line, &cap, f)) > 0)
+    {
+        if(line[n - 1] == '\n') line[--n] = '\0';
+        Int32 used = 0;
+        if(line[0] == 'F')
+        {
+            ShipFileRecord* rec = (ShipFileRecord*)malloc(sizeof(ShipFileRecord));
+            if(sscanf(line, "F %ld %ld %lx %n", &rec->size, &rec->mtime_ns, &rec->hash, &used) == 3 && used > 0)
+            {
+                mapSet(&st->files, stringView(line + used), valueFromPointer(rec));
+            }
+            else
+            {
+                free(rec);
+            }
+        }
+        else if(line[0] == 'T')
+        {
+            ShipTaskRecord* rec = (ShipTaskRecord*)malloc(sizeof(ShipTaskRecord));
+            if(sscanf(line, "T %lx %lx %lx %n", &rec->args_hash, &rec->inputs_hash, &rec->outputs_hash, &used) == 3 && used > 0)
+            {
+                mapSet(&st->tasks, stringView(line + used), valueFromPointer(rec));
+            }
+            else
+            {
+                free(rec);
+            }
+        }
+    }
+    free(line);
+    fclose(f);
+}
+
+Void stateFree(ShipState* st)
+{
+    for(Size i = 0; i < st->files.count; i++)
+    {
+        free(st->files.items[i].value.pointer);
+    }
+    for(Size i = 0; i < st->tasks.count; i++)
+    {
+        free(st->tasks.items[i].value.pointer);
+    }
+    mapFree(&st->files);
+    mapFree(&st->tasks);
+    pthread_mutex_destroy(&st->lock);
+}
+
+/// @brief Write the state atomically through a temp file and rename
+Bool stateSave(ShipState* st, CharSeq path)
+{
+    if(!st->dirty)
+    {
+        return true;
+    }
+    mkdir(SHIP_STATE_DIR, 0755);
+    Int8 tmp[1024];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE* f = fopen(tmp, "w");
+    if(!f)
+    {
+        return false;
+    }
+    for(Size i = 0; i < st->files.count; i++)
+    {
+        ShipFileRecord* rec = (ShipFileRecord*)st->files.items[i].value.pointer;
+        fprintf(f, "F %ld %ld %lx %s\n", rec->size, rec->mtime_ns, rec->hash, st->files.items[i].key.data);
+    }
+    for(Size i = 0; i < st->tasks.count; i++)
+    {
+        ShipTaskRecord* rec = (ShipTaskRecord*)st->tasks.items[i].value.pointer;
+        fprintf(f, "T %lx %lx %lx %s\n", rec->args_hash, rec->inputs_hash, rec->outputs_hash, st->tasks.items[i].key.data);
+    }
+    Bool ok = fclose(f) == 0 && rename(tmp, path) == 0;
+    st->dirty = !ok;
+    return ok;
+}
+
+/// @brief Content hash of a file, served from the state while size and mtime match
+UInt64 stateFileHash(ShipState* st, CharSeq path, struct stat* sb, Bool* ok)
+{
+    ShipString key = { (Int8*)path, strlen(path), 0 };
+    Int64 mtime = (Int64)sb->st_mtim.tv_sec * 1000000000LL + sb->st_mtim.tv_nsec;
+    pthread_mutex_lock(&st->lock);
+    ShipFileRecord* rec = (ShipFileRecord*)mapGetPointer(&st->files, key);
+    if(rec && rec->size == (Int64)sb->st_size && rec->mtime_ns == mtime)
+    {
+        UInt64 h = rec->hash;
+        pthread_mutex_unlock(&st->lock);
+        *ok = true;
+        return h;
+    }
+    pthread_mutex_unlock(&st->lock);
+
+    UInt64 h = hashFile(path, ok);
+    // A file touched within the last second may still change without moving
+    // its mtime, so only trust the cache for files that have settled.
+    if(*ok && sb->st_mtim.tv_sec + 1 < time(null))
+    {
+        pthread_mutex_lock(&st->lock);
+        if(!rec)
+        {
+            rec = (ShipFileRecord*)malloc(sizeof(ShipFileRecord));
+            mapSet(&st->files, key, valueFromPointer(rec));
+        }
+        rec->size = (Int64)sb->st_size;
+        rec->mtime_ns = mtime;
+        rec->hash = h;
+        st->dirty = true;
+        pthread_mutex_unlock(&st->lock);
+    }
+    return h;
+}
+
+/// @brief Fold one entry already stat'ed into acc. A symlink counts as its
+/// target string and is never followed, so `ln -s . loop` cannot recurse.
+static Bool stateEntryHash(ShipState* st, CharSeq path, struct stat* sb, UInt64* acc)
+{
+    UInt64 name = hashBytes(SHIP_HASH_SEED, path, strlen(path));
+    if(S_ISLNK(sb->st_mode))
+    {
+        Int8 target[PATH_MAX];
+        ssize_t n = readlink(path, target, sizeof(target));
+        if(n < 0)
+        {
+            *acc += name * 0xD6E8FEB86659FD93ULL;
+            return false;
+        }
+        *acc += hashBytes(hashBytes(name, "->", 2), target, (Size)n);
+        return true;
+    }
+    if(S_ISDIR(sb->st_mode))
+    {
+        Int32 fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        ShipDirReader r;
+        if(fd < 0 || !dirOpen(&r, fd))
+        {
+            if(fd >= 0) close(fd);
+            return false;
+        }
+        Bool ok = true;
+        CharSeq entry;
+        UInt8 type;
+        while(dirNext(&r, &entry, &type))
+        {
+            Int8* child = pathJoin(path, entry);
+            struct stat child_sb;
+            if(lstat(child, &child_sb) != 0)
+            {
+                *acc += hashBytes(SHIP_HASH_SEED, child, strlen(child)) * 0xD6E8FEB86659FD93ULL;
+                ok = false;
+            }
+            else
+            {
+                ok = stateEntryHash(st, child, &child_sb, acc) && ok;
+            }
+            free(child);
+        }
+        dirClose(&r);
+        return ok;
+    }
+    Bool ok;
+    UInt64 h = stateFileHash(st, path, sb, &ok);
+    h = hashBytes(name, &h, sizeof(h));
+    *acc += h;
+    return ok;
+}
+
+/// @brief Order-independent hash of a file or directory tree; false if
+/// missing. A declared path is followed if it is a link; links below it are not.
+Bool statePathHash(ShipState* st, CharSeq path, UInt64* acc)
+{
+    struct stat sb;
+    if(stat(path, &sb) != 0)
+    {
+        *acc += hashBytes(SHIP_HASH_SEED, path, strlen(path)) * 0xD6E8FEB86659FD93ULL;
+        return false;
+    }
+    return stateEntryHash(st, path, &sb, acc);
+}
+
+UInt64 statePathsHash(ShipState* st, CharSeq spec, Bool* all_present)
+{
+    UInt64 acc = SHIP_HASH_SEED;
+    *all_present = true;
+    CharSeq c = spec;
+    CharSeq start;
+    Size len;
+    while(listNext(&c, &start, &len))
+    {
+        Int8* path = (Int8*)malloc(len + 1);
+        memcpy(path, start, len);
+        path[len] = '\0';
+        if(!statePathHash(st, path, &acc))
+        {
+            *all_present = false;
+        }
+        free(path);
+    }
+    return acc;
+}
+
+/// @brief Hash a path-list argument, given either as "a b" or ["a", "b"]
+UInt64 stateValueHash(ShipState* st, ShipValue* v, Bool* all_present)
+{
+    if(!v)
+    {
+        return SHIP_HASH_SEED;
+    }
+    ShipString text = valueToString(v);
+    UInt64 h = statePathsHash(st, text.data, all_present);
+    stringFree(&text);
+    return h;
+}
+
+/// @brief Key a task by name plus its id, or its args hash when anonymous
+ShipString stateTaskKey(ShipTask* t)
+{
+    Int8 buf[512];
+    ShipString* id = valueAsString(mapGetStr(&t->args, "id"));
+    if(id)
+    {
+        snprintf(buf, sizeof(buf), "%s:%s", t->task_name.data, id->data);
+    }
+    else
+    {
+        snprintf(buf, sizeof(buf), "%s#%016lx", t->task_name.data, t->args_hash);
+    }
+    return stringFrom(buf);
+}
+
+/// @brief Tasks opt into incremental execution by declaring inputs or outputs
+Bool stateTracked(ShipTask* t)
+{
+    return mapGetStr(&t->args, "inputs") || mapGetStr(&t->args, "outputs");
+}
+
+/// @brief Check whether a tracked task's last run is still valid
+Bool stateCheck(ShipState* st, ShipTask* t, UInt64* inputs_hash)
+{
+    ShipValue* outputs = mapGetStr(&t->args, "outputs");
+    Bool present = true;
+    *inputs_hash = stateValueHash(st, mapGetStr(&t->args, "inputs"), &present);
+    if(!present)
+    {
+        return false;
+    }
+
+    ShipString key = stateTaskKey(t);
+    pthread_mutex_lock(&st->lock);
+    ShipTaskRecord* rec = (ShipTaskRecord*)mapGetPointer(&st->tasks, key);
+    ShipTaskRecord copy = rec ? *rec : (ShipTaskRecord){0};
+    pthread_mutex_unlock(&st->lock);
+    stringFree(&key);
+    if(!rec || copy.args_hash != t->args_hash || copy.inputs_hash != *inputs_hash)
+    {
+        return false;
+    }
+    if(outputs)
+    {
+        UInt64 out_hash = stateValueHash(st, outputs, &present);
+        if(!present || out_hash != copy.outputs_hash)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// @brief Remember a successful run of a tracked task
+Void stateRecord(ShipState* st, ShipTask* t, UInt64 inputs_hash)
+{
+    Bool present = true;
+    UInt64 out_hash = stateValueHash(st, mapGetStr(&t->args, "outputs"), &present);
+    ShipString key = stateTaskKey(t);
+    pthread_mutex_lock(&st->lock);
+    ShipTaskRecord* rec = (ShipTaskRecord*)mapGetPointer(&st->tasks, key);
+    if(!rec)
+    {
+        rec = (ShipTaskRecord*)malloc(sizeof(ShipTaskRecord));
+        mapSet(&st->tasks, key, valueFromPointer(rec));
+    }
+    rec->args_hash = t->args_hash;
+    rec->inputs_hash = inputs_hash;
+    rec->outputs_hash = out_hash;
+    st->dirty = true;
+    pthread_mutex_unlock(&st->lock);
+    stringFree(&key);
+}
+
+/// @brief Load the durations log; a missing file yields an empty log
+Void durationsLoad(ShipDurationLog* log, CharSeq path)
+{
+    mapInit(&log->records);
+    log->dirty = false;
+    FILE* f = fopen(path, "r");
+    if(!f)
+    {
+        return;
+    }
+    Int8* line = null;
+    Size cap = 0;
+    ssize_t n;
+    while((n = getline(&line, &cap, f)) > 0)
+    {
+        if(line[n - 1] == '\n') line[--n] = '\0';
+        Int32 used = 0;
+        ShipDurationRecord* rec = (ShipDurationRecord*)malloc(sizeof(ShipDurationRecord));
+        if(sscanf(line, "%lx %lu %ld %n", &rec->args_hash, &rec->wall_ms, &rec->seen, &used) == 3 && used > 0)
+        {
+            mapSet(&log->records, stringView(line + used), valueFromPointer(rec));
+        }
+        else
+        {
+            free(rec);
+        }
+    }
+    free(line);
+    fclose(f);
+}
+
+/// @brief Rewrite the log with one line per task, dropping tasks that have
+/// not run for SHIP_DURATIONS_MAX_AGE so renamed or edited tasks age out
+Bool durationsSave(ShipDurationLog* log, CharSeq path)
+{
+    if(!log->dirty)
+    {
+        return true;
+    }
+    mkdir(SHIP_STATE_DIR, 0755);
+    Int8 tmp[1024];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE* f = fopen(tmp, "w");
+    if(!f)
+    {
+        return false;
+    }
+    Int64 now = (Int64)time(null);
+    for(Size i = 0; i < log->records.count; i++)
+    {
+        ShipDurationRecord* rec = (ShipDurationRecord*)log->records.items[i].value.pointer;
+        if(now - rec->seen > SHIP_DURATIONS_MAX_AGE) continue;
+        fprintf(f, "%lx %lu %ld %s\n", rec->args_hash, rec->wall_ms, rec->seen, log->records.items[i].key.data);
+    }
+    Bool ok = fclose(f) == 0 && rename(tmp, path) == 0;
+    log->dirty = !ok;
+    return ok;
+}
+
+/// @brief Remember how long a task took; caller serialises access
+Void durationsRecord(ShipDurationLog* log, ShipTask* t, UInt64 wall_ns)
+{
+    ShipString key = stateTaskKey(t);
+    ShipDurationRecord* rec = (ShipDurationRecord*)mapGetPointer(&log->records, key);
+    if(!rec)
+    {
+        rec = (ShipDurationRecord*)malloc(sizeof(ShipDurationRecord));
+        mapSet(&log->records, key, valueFromPointer(rec));
+    }
+    rec->args_hash = t->args_hash;
+    rec->wall_ms = wall_ns / 1000000;
+    rec->seen = (Int64)time(null);
+    log->dirty = true;
+    stringFree(&key);
+}
+
+Void durationsFree(ShipDurationLog* log)
+{
+    for(Size i = 0; i < log->records.count; i++)
+    {
+        free(log->records.items[i].value.pointer);
+    }
+    mapFree(&log->records);
+}
+
+/// @brief Fill priority[i] with the longest remaining path (in seconds) from
+/// task i to the end of the build, weighting each task by its last recorded
+/// duration. Tasks without history weigh the mean of those with one, or one
+/// second when nothing is known. Returns the estimated wall time of the
+/// build, or 0 when no selected task has history.
+Float64 planPriorities(ShipVector* tasks, ShipBuildOptions* options, ShipDurationLog* log, Float64* priority)
+{
+    Size n = tasks->length;
+    Float64* cost = (Float64*)malloc((n + 1) * sizeof(Float64));
+    Bool* known = (Bool*)malloc((n + 1) * sizeof(Bool));
+    Float64 known_sum = 0;
+    Size known_count = 0;
+    for(Size i = 0; i < n; i++)
+    {
+        ShipTask* t = (ShipTask*)tasks->data[i];
+        ShipString key = stateTaskKey(t);
+        ShipDurationRecord* rec = (ShipDurationRecord*)mapGetPointer(&log->records, key);
+        stringFree(&key);
+        known[i] = rec && rec->args_hash == t->args_hash;
+        cost[i] = known[i] ? rec->wall_ms / 1000.0 : 0;
+        if(known[i] && (!options->selected || options->selected[i]))
+        {
+            known_sum += cost[i];
+            known_count++;
+        }
+    }
+    Float64 fallback = known_count ? known_sum / known_count : 1.0;
+    Float64 work = 0;
+    for(Size i = 0; i < n; i++)
+    {
+        if(options->selected && !options->selected[i]) cost[i] = 0;
+        else if(!known[i]) cost[i] = fallback;
+        work += cost[i];
+    }
+
+    // reverse topological order: every dependent is finished before its dependency
+    Size* pending = (Size*)malloc((n + 1) * sizeof(Size));
+    Size* order = (Size*)malloc((n + 1) * sizeof(Size));
+    Size head = 0, tail = 0;
+    for(Size i = 0; i < n; i++)
+    {
+        pending[i] = ((ShipTask*)tasks->data[i])->dep_count;
+        if(pending[i] == 0) order[tail++] = i;
+    }
+    while(head < tail)
+    {
+        ShipTask* t = (ShipTask*)tasks->data[order[head++]];
+        for(Size d = 0; d < t->dependent_count; d++)
+        {
+            if(--pending[t->dependents[d]] == 0) order[tail++] = t->dependents[d];
+        }
+    }
+    Float64 critical = 0;
+    for(Size k = tail; k > 0; k--)
+    {
+        Size i = order[k - 1];
+        ShipTask* t = (ShipTask*)tasks->data[i];
+        Float64 longest = 0;
+        for(Size d = 0; d < t->dependent_count; d++)
+        {
+            if(priority[t->dependents[d]] > longest) longest = priority[t->dependents[d]];
+        }
+        priority[i] = cost[i] + longest;
+        if(priority[i] > critical) critical = priority[i];
+    }
+    free(pending);
+    free(order);
+    free(cost);
+    free(known);
+
+    if(known_count == 0)
+    {
+        return 0;
+    }
+    // neither the longest chain nor the total work spread over the workers
+    // can finish sooner; the larger of the two is the estimate
+    Float64 workers = options->jobs > 0 ? options->jobs : 1;
+    Float64 cpus = options->cpus > 0 ? options->cpus : (Float64)cpuCount();
+    if(cpus < workers) workers = cpus;
+    return critical > work / workers ? critical : work / workers;
+}
+
+/// @brief Feed a value into a digest with its type and lengths, so distinct
+/// values never serialise to the same bytes
+static Void artifactDigestValue(ShipSha256* c, ShipValue* v)
+{
+    UInt8 type = (UInt8)v->type;
+    sha256Update(c, &type, 1);
+    switch(v->type)
+    {
+        case SHIP_VALUE_STRING:
+            sha256Update(c, &v->string.length, sizeof(Size));
+            sha256Update(c, v->string.data, v->string.length);
+            break;
+        case SHIP_VALUE_NUMBER:
+            sha256Update(c, &v->number, sizeof(Float64));
+            break;
+        case SHIP_VALUE_BOOL:
+            sha256Update(c, &v->boolean, sizeof(Bool));
+            break;
+        case SHIP_VALUE_LIST:
+            sha256Update(c, &v->list.count, sizeof(Size));
+            for(Size i = 0; i < v->list.count; i++)
+            {
+                artifactDigestValue(c, &v->list.items[i]);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/// @brief Append SHA-256(path, content) for every file under path; false
+/// when something is missing or unreadable
+static Bool artifactDigestInputs(CharSeq path, ShipVector* digests)
+{
+    struct stat sb;
+    if(stat(path, &sb) != 0)
+    {
+        return false;
+    }
+    if(S_ISDIR(sb.st_mode))
+    {
+        DIR* d = opendir(path);
+        if(!d)
+        {
+            return false;
+        }
+        Bool ok = true;
+        struct dirent* e;
+        while(ok && (e = readdir(d)) != null)
+        {
+            if(strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0) continue;
+            Int8* child = pathJoin(path, e->d_name);
+            ok = artifactDigestInputs(child, digests);
+            free(child);
+        }
+        closedir(d);
+        return ok;
+    }
+    ShipDigest content;
+    if(!sha256File(path, &content))
+    {
+        return false;
+    }
+    ShipSha256 c;
+    sha256Init(&c);
+    sha256Update(&c, path, strlen(path) + 1);
+    sha256Update(&c, content.bytes, sizeof(content.bytes));
+    ShipDigest* entry = (ShipDigest*)malloc(sizeof(ShipDigest));
+    sha256Final(&c, entry);
+    vectorPush(digests, entry);
+    return true;
+}
+
+static Int32 artifactCompareDigest(const Void* a, const Void* b)
+{
+    return memcmp((*(ShipDigest**)a)->bytes, (*(ShipDigest**)b)->bytes, sizeof(((ShipDigest*)0)->bytes));
+}
+
+/// @brief Artifact store key of a tracked task: SHA-256 over the ship
+/// version, its function, its (resolved) args and the path and content of
+/// each input file in a stable order; false if an input can't be read
+Bool artifactKey(ShipTask* t, ShipDigest* key)
+{
+    ShipSha256 c;
+    sha256Init(&c);
+    sha256Update(&c, SHIP_VERSION, strlen(SHIP_VERSION) + 1);
+    sha256Update(&c, t->task_name.data, t->task_name.length + 1);
+    for(Size i = 0; i < t->args.count; i++)
+    {
+        KVPair* kv = &t->args.items[i];
+        sha256Update(&c, kv->key.data, kv->key.length + 1);
+        artifactDigestValue(&c, &kv->value);
+    }
+    ShipVector digests;
+    vectorInit(&digests);
+    Bool ok = true;
+    ShipValue* inputs = mapGetStr(&t->args, "inputs");
+    if(inputs)
+    {
+        ShipString spec = valueToString(inputs);
+        CharSeq p = spec.data;
+        CharSeq start;
+        Size len;
+        while(ok && listNext(&p, &start, &len))
+        {
+            ShipString path = stringFromLength(start, len);
+            ok = artifactDigestInputs(path.data, &digests);
+            stringFree(&path);
+        }
+        stringFree(&spec);
+    }
+    qsort(digests.data, digests.length, sizeof(Any), artifactCompareDigest);
+    for(Size i = 0; i < digests.length; i++)
+    {
+        sha256Update(&c, ((ShipDigest*)digests.data[i])->bytes, sizeof(key->bytes));
+        free(digests.data[i]);
+    }
+    free(digests.data);
+    sha256Final(&c, key);
+    return ok;
+}
+
+static Void digestHex(ShipDigest* d, Int8* out)
+{
+    for(Int32 i = 0; i < 32; i++)
+    {
+        snprintf(out + i * 2, 3, "%02x", d->bytes[i]);
+    }
+}
+
+static Bool digestParse(CharSeq hex, ShipDigest* d)
+{
+    for(Int32 i = 0; i < 32; i++)
+    {
+        UInt32 byte;
+        if(!isxdigit((UInt8)hex[i * 2]) || !isxdigit((UInt8)hex[i * 2 + 1]) || sscanf(hex + i * 2, "%2x", &byte) != 1)
+        {
+            return false;
+        }
+        d->bytes[i] = (UInt8)byte;
+    }
+    return hex[64] == '\0';
+}
+
+/// @brief <dir>/<kind>/<first byte>/<rest of digest>, fanned out like git objects
+static Void artifactPath(Int8* out, Size cap, CharSeq dir, CharSeq kind, ShipDigest* digest)
+{
+    Int8 hex[65];
+    digestHex(digest, hex);
+    snprintf(out, cap, "%s/%s/%.2s/%s", dir, kind, hex, hex + 2);
+}
+
+/// @brief True when blob exists and its content still hashes to digest;
+/// a truncated or corrupted blob of the right size is not trusted
+static Bool artifactVerify(CharSeq blob, ShipDigest* digest)
+{
+    ShipDigest actual;
+    return sha256File(blob, &actual) && memcmp(actual.bytes, digest->bytes, sizeof(actual.bytes)) == 0;
+}
+
+/// @brief Write path via a unique temporary and rename it into place, so
+/// concurrent checkouts sharing the store never see a partial file
+static Bool artifactPublish(CharSeq src, CharSeq dst, struct stat* sb)
+{
+    static UInt64 serial;
+    Int8 tmp[PATH_MAX + 64];
+    snprintf(tmp, sizeof(tmp), "%s.%d.%lu.tmp", dst, (Int32)getpid(), (UInt64)__atomic_add_fetch(&serial, 1, __ATOMIC_RELAXED));
+    pathMakeParents(dst);
+    if(!copyFile(src, tmp, sb) || rename(tmp, dst) != 0)
+    {
+        unlink(tmp);
+        return false;
+    }
+    return true;
+}
+
+/// @brief Add the regular files under an output path to the store, appending
+/// a "mode size hash path" manifest line for each
+static Bool artifactCollect(CharSeq dir, CharSeq path, ShipString* manifest)
+{
+    struct stat sb;
+    if(stat(path, &sb) != 0)
+    {
+        return false;
+    }
+    if(S_ISDIR(sb.st_mode))
+    {
+        DIR* d = opendir(path);
+        if(!d)
+        {
+            return false;
+        }
+        Bool ok = true;
+        struct dirent* e;
+        while(ok && (e = readdir(d)) != null)
+        {
+            if(strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0) continue;
+            Int8* child = pathJoin(path, e->d_name);
+            ok = artifactCollect(dir, child, manifest);
+            free(child);
+        }
+        closedir(d);
+        return ok;
+    }
+    if(!S_ISREG(sb.st_mode))
+    {
+        return true;
+    }
+    ShipDigest digest;
+    if(!sha256File(path, &digest))
+    {
+        return false;
+    }
+    Int8 blob[PATH_MAX];
+    artifactPath(blob, sizeof(blob), dir, "objects", &digest);
+    if(artifactVerify(blob, &digest))
+    {
+        utimensat(AT_FDCWD, blob, null, 0);
+    }
+    else
+    {
+        // blobs are read-only and stamped with the time they were last used,
+        // which is the clock LRU eviction goes by
+        struct stat fresh = sb;
+        fresh.st_mode = S_IFREG | 0444;
+        fresh.st_atim.tv_nsec = UTIME_NOW;
+        fresh.st_mtim.tv_nsec = UTIME_NOW;
+        if(!artifactPublish(path, blob, &fresh))
+        {
+            return false;
+        }
+    }
+    Int8 hex[65];
+    digestHex(&digest, hex);
+    Int8 line[PATH_MAX + 128];
+    Int32 n = snprintf(line, sizeof(line), "%o %ld %s %s\n", (UInt32)(sb.st_mode & 07777), (Int64)sb.st_size, hex, path);
+    stringAppend(manifest, line, (Size)n);
+    return true;
+}
+
+/// @brief Record a finished task's declared outputs under key
+Bool artifactStore(CharSeq dir, ShipDigest* key, ShipValue* outputs)
+{
+    ShipString manifest = stringFrom(SHIP_ARTIFACT_MAGIC "\n");
+    ShipString spec = valueToString(outputs);
+    Bool ok = true;
+    CharSeq c = spec.data;
+    CharSeq start;
+    Size len;
+    while(ok && listNext(&c, &start, &len))
+    {
+        ShipString path = stringFromLength(start, len);
+        ok = artifactCollect(dir, path.data, &manifest);
+        stringFree(&path);
+    }
+    stringFree(&spec);
+    if(ok)
+    {
+        Int8 entry[PATH_MAX];
+        Int8 tmp[PATH_MAX + 32];
+        artifactPath(entry, sizeof(entry), dir, "tasks", key);
+        snprintf(tmp, sizeof(tmp), "%s.%d.%lx.tmp", entry, (Int32)getpid(), (UInt64)pthread_self());
+        pathMakeParents(entry);
+        FILE* f = fopen(tmp, "w");
+        ok = f && fwrite(manifest.data, 1, manifest.length, f) == manifest.length;
+        ok = f && fclose(f) == 0 && ok;
+        ok = ok && rename(tmp, entry) == 0;
+        if(!ok) unlink(tmp);
+    }
+    stringFree(&manifest);
+    return ok;
+}
+
+/// @brief Recreate the outputs stored under key by reflinking (or copying)
+/// their blobs into place; false on a miss or an evicted blob
+Bool artifactRestore(CharSeq dir, ShipDigest* key, Size* files)
+{
+    Int8 entry[PATH_MAX];
+    artifactPath(entry, sizeof(entry), dir, "tasks", key);
+    FILE* f = fopen(entry, "r");
+    if(!f)
+    {
+        return false;
+    }
+    Int8 line[PATH_MAX + 128];
+    Bool ok = fgets(line, sizeof(line), f) && strcmp(line, SHIP_ARTIFACT_MAGIC "\n") == 0;
+    *files = 0;
+    while(ok && fgets(line, sizeof(line), f))
+    {
+        UInt32 mode;
+        Int64 size;
+        Int8 hex[65];
+        ShipDigest hash;
+        Int32 at = 0;
+        Size len = strlen(line);
+        if(len > 0 && line[len - 1] == '\n') line[--len] = '\0';
+        if(sscanf(line, "%o %ld %64s %n", &mode, &size, hex, &at) != 3 || at <= 0 || !digestParse(hex, &hash))
+        {
+            ok = false;
+            break;
+        }
+        Int8 blob[PATH_MAX];
+        artifactPath(blob, sizeof(blob), dir, "objects", &hash);
+        struct stat sb;
+        if(stat(blob, &sb) != 0 || sb.st_size != size || !artifactVerify(blob, &hash))
+        {
+            ok = false;
+            break;
+        }
+        // restored files look freshly built; the blob's use time is bumped
+        sb.st_mode = S_IFREG | mode;
+        sb.st_atim.tv_nsec = UTIME_NOW;
+        sb.st_mtim.tv_nsec = UTIME_NOW;
+        pathMakeParents(line + at);
+        ok = copyFile(blob, line + at, &sb);
+        utimensat(AT_FDCWD, blob, null, 0);
+        (*files)++;
+    }
+    fclose(f);
+    if(ok)
+    {
+        utimensat(AT_FDCWD, entry, null, 0);
+    }
+    return ok;
+}
+
+static Void artifactScan(CharSeq path, ShipVector* files, UInt64* total)
+{
+    DIR* d = opendir(path);
+    if(!d)
+    {
+        return;
+    }
+    struct dirent* e;
+    while((e = readdir(d)) != null)
+    {
+        if(strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0) continue;
+        Int8* child = pathJoin(path, e->d_name);
+        struct stat sb;
+        if(lstat(child, &sb) != 0)
+        {
+            free(child);
+        }
+        else if(S_ISDIR(sb.st_mode))
+        {
+            artifactScan(child, files, total);
+            free(child);
+        }
+        else
+        {
+            ShipArtifactFile* a = (ShipArtifactFile*)malloc(sizeof(ShipArtifactFile));
+            a->path = child;
+            a->size = (Int64)sb.st_blocks * 512;
+            a->mtime_ns = (Int64)sb.st_mtim.tv_sec * 1000000000LL + sb.st_mtim.tv_nsec;
+            *total += (UInt64)a->size;
+            vectorPush(files, a);
+        }
+    }
+    closedir(d);
+}
+
+static Int32 artifactCompareAge(const Void* a, const Void* b)
+{
+    Int64 x = (*(ShipArtifactFile**)a)->mtime_ns;
+    Int64 y = (*(ShipArtifactFile**)b)->mtime_ns;
+    return x < y ? -1 : x > y;
+}
+
+/// @brief Once the store exceeds limit bytes, delete its least recently used
+/// files until it is back under 90% of the limit. Tasks whose blobs are gone
+/// simply miss on their next restore.
+Void artifactEvict(CharSeq dir, UInt64 limit)
+{
+    ShipVector files;
+    vectorInit(&files);
+    UInt64 total = 0;
+    artifactScan(dir, &files, &total);
+    if(total > limit)
+    {
+        qsort(files.data, files.length, sizeof(Any), artifactCompareAge);
+        UInt64 target = limit - limit / 10;
+        for(Size i = 0; i < files.length && total > target; i++)
+        {
+            ShipArtifactFile* a = (ShipArtifactFile*)files.data[i];
+            if(unlink(a->path) == 0) total -= (UInt64)a->size;
+        }
+    }
+    for(Size i = 0; i < files.length; i++)
+    {
+        free(((ShipArtifactFile*)files.data[i])->path);
+        free(files.data[i]);
+    }
+    free(files.data);
+}
+
+/// @brief Cache key: the script bytes salted with the ship version and the
+/// registry's names in index order, so a cache never outlives its registry
+UInt64 cacheKey(CharSeq content, Size length)
+{
+    UInt64 h = hashBytes(SHIP_HASH_SEED, SHIP_VERSION, strlen(SHIP_VERSION));
+    // tasks are stored by registry index, so the table's order is part of
+    // what a cache was built against
+    for(Size i = 0; i < global_registry.length; i++)
+    {
+        ShipRegistryEntry* entry = (ShipRegistryEntry*)global_registry.data[i];
+        h = hashBytes(h, entry->name.data, entry->name.length + 1);
+    }
+    return hashBytes(h, content, length);
+}
+
+/// @brief .ship/<script name>.shipc, next to the incremental state
+Void cachePath(CharSeq script_path, Int8* out, Size cap)
+{
+    CharSeq base = strrchr(script_path, '/');
+    snprintf(out, cap, "%s/%s.shipc", SHIP_STATE_DIR, base ? base + 1 : script_path);
+}
+
+simple Void cachePutU32(ShipString* b, UInt32 v) { stringAppend(b, (const Int8*)&v, sizeof(v)); }
+simple Void cachePutU64(ShipString* b, UInt64 v) { stringAppend(b, (const Int8*)&v, sizeof(v)); }
+
+/// @brief Strings are written NUL-terminated so loads can point into the mapping
+Void cachePutString(ShipString* b, ShipString s)
+{
+    cachePutU32(b, (UInt32)s.length);
+    stringAppend(b, s.data, s.length);
+    stringAppend(b, "", 1);
+}
+
+Void cachePutValue(ShipString* b, ShipValue* v)
+{
+    UInt8 type = (UInt8)v->type;
+    stringAppend(b, (const Int8*)&type, 1);
+    switch(v->type)
+    {
+        case SHIP_VALUE_STRING:
+            cachePutString(b, v->string);
+            break;
+        case SHIP_VALUE_NUMBER:
+            stringAppend(b, (const Int8*)&v->number, sizeof(Float64));
+            break;
+        case SHIP_VALUE_BOOL:
+            stringAppend(b, (const Int8*)&v->boolean, 1);
+            break;
+        case SHIP_VALUE_LIST:
+            cachePutU32(b, (UInt32)v->list.count);
+            for(Size i = 0; i < v->list.count; i++)
+            {
+                cachePutValue(b, &v->list.items[i]);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/// @brief Serialize the resolved task list. Layout (host endianness):
+/// magic, key, title, task count, then per task the registry index, group,
+/// args hash and its typed args as (key, tag, payload) triples.
+Bool cacheSave(CharSeq path, UInt64 key, ShipString title, ShipVector tasks)
+{
+    ShipString b = stringFrom("");
+    stringAppend(&b, SHIP_CACHE_MAGIC, SHIP_CACHE_MAGIC_LEN);
+    cachePutU64(&b, key);
+    cachePutString(&b, title);
+    cachePutU32(&b, (UInt32)tasks.length);
+    for(Size i = 0; i < tasks.length; i++)
+    {
+        ShipTask* t = (ShipTask*)tasks.data[i];
+        UInt32 index = 0;
+        while(index < global_registry.length && ((ShipRegistryEntry*)global_registry.data[index])->func != t->func)
+        {
+            index++;
+        }
+        cachePutU32(&b, index);
+        cachePutU32(&b, (UInt32)t->group);
+        cachePutU64(&b, t->args_hash);
+        cachePutU32(&b, (UInt32)t->args.count);
+        for(Size j = 0; j < t->args.count; j++)
+        {
+            cachePutString(&b, t->args.items[j].key);
+            cachePutValue(&b, &t->args.items[j].value);
+        }
+    }
+
+    mkdir(SHIP_STATE_DIR, 0755);
+    Int8 tmp[PATH_MAX];
+    snprintf(tmp, sizeof(tmp), "%s.%d.tmp", path, (Int32)getpid());
+    FILE* f = fopen(tmp, "wb");
+    Bool ok = f != null;
+    if(f)
+    {
+        ok = fwrite(b.data, 1, b.length, f) == b.length;
+        ok = fclose(f) == 0 && ok;
+        ok = ok && rename(tmp, path) == 0;
+        if(!ok) unlink(tmp);
+    }
+    stringFree(&b);
+    return ok;
+}
+
+simple Bool cacheHas(ShipCacheReader* r, Size n)
+{
+    if(!r->ok || r->size - r->pos < n)
+    {
+        r->ok = false;
+        return false;
+    }
+    return true;
+}
+
+UInt32 cacheGetU32(ShipCacheReader* r)
+{
+    UInt32 v = 0;
+    if(cacheHas(r, sizeof(v)))
+    {
+        memcpy(&v, r->data + r->pos, sizeof(v));
+        r->pos += sizeof(v);
+    }
+    return v;
+}
+
+UInt64 cacheGetU64(ShipCacheReader* r)
+{
+    UInt64 v = 0;
+    if(cacheHas(r, sizeof(v)))
+    {
+        memcpy(&v, r->data + r->pos, sizeof(v));
+        r->pos += sizeof(v);
+    }
+    return v;
+}
+
+/// @brief Borrow a string from the mapping; capacity 0 marks it as not owned
+ShipString cacheGetString(ShipCacheReader* r)
+{
+    ShipString s = { (Int8*)"", 0, 0 };
+    Size len = cacheGetU32(r);
+    if(cacheHas(r, len + 1) && r->data[r->pos + len] == '\0')
+    {
+        s.data = (Int8*)r->data + r->pos;
+        s.length = len;
+        r->pos += len + 1;
+    }
+    else
+    {
+        r->ok = false;
+    }
+    return s;
+}
+
+ShipValue cacheGetValue(ShipCacheReader* r, ShipArena* arena)
+{
+    ShipValue v = valueNull();
+    if(!cacheHas(r, 1))
+    {
+        return v;
+    }
+    v.type = (ShipValueType)r->data[r->pos++];
+    switch(v.type)
+    {
+        case SHIP_VALUE_STRING:
+            v.string = cacheGetString(r);
+            break;
+        case SHIP_VALUE_NUMBER:
+            if(cacheHas(r, sizeof(Float64)))
+            {
+                memcpy(&v.number, r->data + r->pos, sizeof(Float64));
+                r->pos += sizeof(Float64);
+            }
+            break;
+        case SHIP_VALUE_BOOL:
+            if(cacheHas(r, 1))
+            {
+                v.boolean = r->data[r->pos++] != 0;
+            }
+            break;
+        case SHIP_VALUE_LIST:
+            v.list.count = cacheGetU32(r);
+            if(!cacheHas(r, v.list.count))
+            {
+                v.list.count = 0;
+                break;
+            }
+            v.list.items = (ShipValue*)arenaAlloc(arena, (v.list.count ? v.list.count : 1) * sizeof(ShipValue));
+            for(Size i = 0; i < v.list.count; i++)
+            {
+                v.list.items[i] = cacheGetValue(r, arena);
+            }
+            break;
+        case SHIP_VALUE_NULL:
+            break;
+        default:
+            r->ok = false;
+            break;
+    }
+    return v;
+}
+
+/// @brief Map a .shipc and rebuild the task list from it, skipping lexing and
+/// parsing. Returns false (leaving nothing to clean up) on a missing, stale or
+/// malformed cache.
+Bool cacheLoad(CharSeq path, UInt64 key, ShipArena* arena, ShipCache* cache, ShipString* title, ShipVector* tasks)
+{
+    cache->data = null;
+    cache->size = 0;
+    Int32 fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+    {
+        return false;
+    }
+    struct stat sb;
+    if(fstat(fd, &sb) != 0 || sb.st_size < SHIP_CACHE_MAGIC_LEN + (Int64)sizeof(UInt64))
+    {
+        close(fd);
+        return false;
+    }
+    Any data = mmap(null, (Size)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED)
+    {
+        return false;
+    }
+    cache->data = (UInt8*)data;
+    cache->size = (Size)sb.st_size;
+
+    ShipCacheReader r = { cache->data, cache->size, SHIP_CACHE_MAGIC_LEN, true };
+    if(memcmp(cache->data, SHIP_CACHE_MAGIC, SHIP_CACHE_MAGIC_LEN) != 0 || cacheGetU64(&r) != key)
+    {
+        cacheClose(cache);
+        return false;
+    }
+    *title = cacheGetString(&r);
+    UInt32 count = cacheGetU32(&r);
+    vectorInit(tasks);
+    for(UInt32 i = 0; i < count && r.ok; i++)
+    {
+        UInt32 index = cacheGetU32(&r);
+        if(index >= global_registry.length)
+        {
+            r.ok = false;
+            break;
+        }
+        ShipRegistryEntry* entry = (ShipRegistryEntry*)global_registry.data[index];
+        ShipTask* t = (ShipTask*)arenaAlloc(arena, sizeof(ShipTask));
+        memset(t, 0, sizeof(ShipTask));
+        t->func = entry->func;
+        t->task_name = entry->name;
+        t->group = (Int32)cacheGetU32(&r);
+        t->args_hash = cacheGetU64(&r);
+        mapInitArena(&t->args, arena);
+        UInt32 args = cacheGetU32(&r);
+        for(UInt32 j = 0; j < args && r.ok; j++)
+        {
+            ShipString k = cacheGetString(&r);
+            mapSet(&t->args, k, cacheGetValue(&r, arena));
+        }
+        vectorPush(tasks, t);
+    }
+    if(!r.ok || r.pos != r.size)
+    {
+        free(tasks->data);
+        vectorInit(tasks);
+        cacheClose(cache);
+        return false;
+    }
+    return true;
+}
+
+Void cacheClose(ShipCache* cache)
+{
+    if(cache->data)
+    {
+        munmap(cache->data, cache->size);
+    }
+    cache->data = null;
+    cache->size = 0;
+}
+
+/// @brief Monotonic clock in nanoseconds, for phase and task timing
+UInt64 clockNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (UInt64)ts.tv_sec * 1000000000ULL + (UInt64)ts.tv_nsec;
+}
+
+/// @brief Kernel thread id on Linux, so trace rows match top/perf
+Int32 traceThreadId()
+{
+#ifdef __linux__
+    return (Int32)syscall(SYS_gettid);
+#else
+    return (Int32)(UPtr)pthread_self();
+#endif
+}
+
+/// @brief Enable event collection; timestamps are relative to this call
+Void traceStart()
+{
+    pthread_mutex_init(&global_trace.lock, null);
+    global_trace.origin_ns = clockNs();
+    global_trace.events = null;
+    global_trace.count = 0;
+    global_trace.capacity = 0;
+    global_trace.enabled = true;
+}
+
+Void tracePush(Int8 phase, CharSeq category, CharSeq name, UInt64 start_ns, UInt64 end_ns, Int64 child_pid)
+{
+    ShipTraceEvent e;
+    e.phase = phase;
+    e.name = stringFrom(name);
+    e.category = category;
+    e.start_ns = start_ns;
+    e.end_ns = end_ns;
+    e.tid = traceThreadId();
+    e.child_pid = child_pid;
+    pthread_mutex_lock(&global_trace.lock);
+    if(global_trace.count == global_trace.capacity)
+    {
+        global_trace.capacity = global_trace.capacity ? global_trace.capacity * 2 : 256;
+        global_trace.events = (ShipTraceEvent*)realloc(global_trace.events, global_trace.capacity * sizeof(ShipTraceEvent));
+    }
+    global_trace.events[global_trace.count++] = e;
+    pthread_mutex_unlock(&global_trace.lock);
+}
+
+/// @brief Label the calling thread's row in the timeline
+Void traceThreadName(CharSeq name)
+{
+    if(global_trace.enabled)
+    {
+        tracePush('M', "__metadata", name, 0, 0, -1);
+    }
+}
+
+/// @brief Record a finished span on the calling thread; child_pid < 0 for none
+Void traceSpan(CharSeq category, CharSeq name, UInt64 start_ns, UInt64 end_ns, Int64 child_pid)
+{
+    if(global_trace.enabled)
+    {
+        tracePush('X', category, name, start_ns, end_ns, child_pid);
+    }
+}
+
+Void jsonWriteString(FILE* f, CharSeq s)
+{
+    fputc('"', f);
+    for(; *s; s++)
+    {
+        UInt8 c = (UInt8)*s;
+        if(c == '"' || c == '\\') fprintf(f, "\\%c", c);
+        else if(c == '\n') fputs("\\n", f);
+        else if(c == '\t') fputs("\\t", f);
+        else if(c < 0x20) fprintf(f, "\\u%04x", c);
+        else fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+/// @brief Write the collected events as a Chrome trace-event JSON file,
+/// loadable in chrome://tracing or ui.perfetto.dev, and release them
+Bool traceWrite(CharSeq path)
+{
+    FILE* f = fopen(path, "w");
+    if(f)
+    {
+        fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    }
+    Int32 pid = (Int32)getpid();
+    for(Size i = 0; i < global_trace.count; i++)
+    {
+        ShipTraceEvent* e = &global_trace.events[i];
+        if(f)
+        {
+            if(e->phase == 'M')
+            {
+                fprintf(f, "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":", pid, e->tid);
+                jsonWriteString(f, e->name.data);
+                fprintf(f, "}}");
+            }
+            else
+            {
+                fprintf(f, "{\"ph\":\"X\",\"cat\":\"%s\",\"name\":", e->category);
+                jsonWriteString(f, e->name.data);
+                fprintf(f, ",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f", pid, e->tid,
+                    (e->start_ns - global_trace.origin_ns) / 1e3, (e->end_ns - e->start_ns) / 1e3);
+                if(e->child_pid >= 0)
+                {
+                    fprintf(f, ",\"args\":{\"pid\":%ld}", e->child_pid);
+                }
+                fprintf(f, "}");
+            }
+            fprintf(f, "%s\n", i + 1 < global_trace.count ? "," : "");
+        }
+        stringFree(&e->name);
+    }
+    free(global_trace.events);
+    global_trace.events = null;
+    global_trace.count = 0;
+    global_trace.capacity = 0;
+    if(!f)
+    {
+        fprintf(stderr, FAIL "Error: Cannot write trace to %s\n" ENDC, path);
+        return false;
+    }
+    fprintf(f, "]}\n");
+    return fclose(f) == 0;
+}
+
+/// @brief Number of online processors, used as the default job count
+Int32 cpuCount()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (Int32)info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (Int32)n : 1;
+#endif
+}
+
+/// @brief Memory tasks may claim: physical RAM, or the cgroup v2 limit when
+/// the build runs in a container with a smaller one
+UInt64 memoryCapacity()
+{
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long page = sysconf(_SC_PAGESIZE);
+    UInt64 total = pages > 0 && page > 0 ? (UInt64)pages * (UInt64)page : 0;
+    FILE* f = fopen("/sys/fs/cgroup/memory.max", "r");
+    if(f)
+    {
+        UInt64 limit;
+        if(fscanf(f, "%lu", &limit) == 1 && limit > 0 && (total == 0 || limit < total))
+        {
+            total = limit;
+        }
+        fclose(f);
+    }
+    return total;
+}
+
+/// @brief Parse "4G", "512M", "1.5g", "64K" or a bare number of MiB
+Bool parseMemory(CharSeq text, UInt64* bytes)
+{
+    Int8* end;
+    Float64 n = strtod(text, &end);
+    if(end == text || n < 0)
+    {
+        return false;
+    }
+    while(*end == ' ') end++;
+    Float64 unit = 1024.0 * 1024.0;
+    switch(toupper((UInt8)*end))
+    {
+        case 'K': unit = 1024.0; break;
+        case 'M': unit = 1024.0 * 1024.0; break;
+        case 'G': unit = 1024.0 * 1024.0 * 1024.0; break;
+        case 'T': unit = 1024.0 * 1024.0 * 1024.0 * 1024.0; break;
+        case 'B': unit = 1.0; break;
+        case '\0': break;
+        default: return false;
+    }
+    *bytes = (UInt64)(n * unit);
+    return true;
+}
+
+/// @brief Pick up a jobserver advertised in MAKEFLAGS by a parent make:
+/// --jobserver-auth=R,W, --jobserver-auth=fifo:PATH or the older
+/// --jobserver-fds=R,W. The last one wins, as in make itself.
+static Bool jobserverInherit(ShipJobserver* js)
+{
+    CharSeq flags = getenv("MAKEFLAGS");
+    CharSeq auth = null;
+    for(CharSeq c = flags; c && (c = strstr(c, "--jobserver-")) != null; c++)
+    {
+        if(strncmp(c, "--jobserver-auth=", 17) == 0) auth = c + 17;
+        else if(strncmp(c, "--jobserver-fds=", 16) == 0) auth = c + 16;
+    }
+    if(!auth)
+    {
+        return false;
+    }
+    if(strncmp(auth, "fifo:", 5) == 0)
+    {
+        Size len = strcspn(auth + 5, " ");
+        Int8* path = stringFromLength(auth + 5, len).data;
+        js->read_fd = open(path, O_RDWR | O_CLOEXEC);
+        js->write_fd = js->read_fd;
+        free(path);
+        return js->read_fd >= 0;
+    }
+    Int32 r;
+    Int32 w;
+    if(sscanf(auth, "%d,%d", &r, &w) != 2 || r < 0 || w < 0)
+    {
+        return false;
+    }
+    // make only passes the pipe to recipes it knows are recursive (+ or $(MAKE))
+    if(fcntl(r, F_GETFD) < 0 || fcntl(w, F_GETFD) < 0)
+    {
+        fprintf(stderr, WARNING "Warning: MAKEFLAGS names jobserver fds %d,%d that are not open; mark the recipe with '+'\n" ENDC, r, w);
+        return false;
+    }
+    js->read_fd = r;
+    js->write_fd = w;
+    return true;
+}
+
+/// @brief Join the parent's jobserver or create one with jobs - 1 tokens,
+/// advertising it to children through MAKEFLAGS in both the current and the
+/// pre-4.2 spelling. Pipe fds are left inheritable on purpose.
+Bool jobserverInit(ShipJobserver* js, Int32 jobs)
+{
+    js->read_fd = -1;
+    js->write_fd = -1;
+    js->owner = false;
+    js->implicit_free = 1;
+    js->saved_makeflags = null;
+    // releasing the implicit slot must wake a worker already blocked on the
+    // token pipe, so waiters poll this private pipe as well
+    if(pipe2(js->wake, O_CLOEXEC | O_NONBLOCK) != 0)
+    {
+        return false;
+    }
+    if(jobserverInherit(js))
+    {
+        return true;
+    }
+    Int32 fds[2];
+    if(jobs < 1 || pipe(fds) != 0)
+    {
+        close(js->wake[0]);
+        close(js->wake[1]);
+        js->read_fd = -1;
+        return false;
+    }
+    js->read_fd = fds[0];
+    js->write_fd = fds[1];
+    js->owner = true;
+    for(Int32 i = 1; i < jobs; i++)
+    {
+        if(write(js->write_fd, "+", 1) != 1) break;
+    }
+    CharSeq old = getenv("MAKEFLAGS");
+    js->saved_makeflags = old ? stringFrom(old).data : null;
+    Int8 flags[256];
+    snprintf(flags, sizeof(flags), " -j%d --jobserver-auth=%d,%d --jobserver-fds=%d,%d", jobs, fds[0], fds[1], fds[0], fds[1]);
+    ShipString value = stringFrom(old ? old : "");
+    stringAppend(&value, flags, strlen(flags));
+    setenv("MAKEFLAGS", value.data, 1);
+    stringFree(&value);
+    return true;
+}
+
+/// @brief Take a job slot, blocking until one is free. Returns the token
+/// byte read from the pipe, SHIP_JOB_IMPLICIT for the implicit slot, or
+/// SHIP_JOB_ERROR when the pipe failed or closed (nothing to release then).
+Int32 jobserverAcquire(ShipJobserver* js)
+{
+    while(true)
+    {
+        if(__atomic_exchange_n(&js->implicit_free, 0, __ATOMIC_ACQ_REL))
+        {
+            return SHIP_JOB_IMPLICIT;
+        }
+        // a parent make may have made the pipe non-blocking, so wait first
+        struct pollfd p[2] = { { js->read_fd, POLLIN, 0 }, { js->wake[0], POLLIN, 0 } };
+        if(poll(p, 2, -1) < 0)
+        {
+            if(errno == EINTR) continue;
+            return SHIP_JOB_ERROR;
+        }
+        if(p[1].revents & POLLIN)
+        {
+            UInt8 drain[16];
+            while(read(js->wake[0], drain, sizeof(drain)) > 0);
+            continue;
+        }
+        if(!(p[0].revents & (POLLIN | POLLHUP | POLLERR)))
+        {
+            continue;
+        }
+        UInt8 token;
+        ssize_t n = read(js->read_fd, &token, 1);
+        if(n == 1)
+        {
+            return token;
+        }
+        if(n == 0 || (errno != EINTR && errno != EAGAIN))
+        {
+            return SHIP_JOB_ERROR;
+        }
+    }
+}
+
+/// @brief Give a slot back; tokens return to the pipe byte for byte and the
+/// implicit slot wakes any worker waiting in jobserverAcquire
+Void jobserverRelease(ShipJobserver* js, Int32 token)
+{
+    if(token == SHIP_JOB_ERROR)
+    {
+        return;
+    }
+    if(token == SHIP_JOB_IMPLICIT)
+    {
+        __atomic_store_n(&js->implicit_free, 1, __ATOMIC_RELEASE);
+        while(write(js->wake[1], "", 1) < 0 && errno == EINTR);
+        return;
+    }
+    UInt8 byte = (UInt8)token;
+    while(write(js->write_fd, &byte, 1) < 0 && errno == EINTR);
+}
+
+/// @brief Close an owned jobserver and restore the caller's MAKEFLAGS
+Void jobserverFree(ShipJobserver* js)
+{
+    if(js->read_fd < 0)
+    {
+        return;
+    }
+    close(js->wake[0]);
+    close(js->wake[1]);
+    if(!js->owner)
+    {
+        js->read_fd = -1;
+        return;
+    }
+    close(js->read_fd);
+    close(js->write_fd);
+    if(js->saved_makeflags)
+    {
+        setenv("MAKEFLAGS", js->saved_makeflags, 1);
+        free(js->saved_makeflags);
+    }
+    else
+    {
+        unsetenv("MAKEFLAGS");
+    }
+    js->owner = false;
+    js->read_fd = -1;
+}
+
+/// @brief Append dep to a scratch list unless already present
+Void planAddDep(Size** deps, Size* count, Size* capacity, Size dep)
+{
+    for(Size i = 0; i < *count; i++)
+    {
+        if((*deps)[i] == dep) return;
+    }
+    if(*count == *capacity)
+    {
+        *capacity = *capacity ? *capacity * 2 : 16;
+        *deps = (Size*)realloc(*deps, *capacity * sizeof(Size));
+    }
+    (*deps)[(*count)++] = dep;
+}
+
+/// @brief v is an "@id" reference to another task's result; sets *dep to its index
+static Bool taskRef(ShipMap* ids, ShipValue* v, Size* dep)
+{
+    if(v->type != SHIP_VALUE_STRING || v->string.length < 2 || v->string.data[0] != '@')
+    {
+        return false;
+    }
+    CharSeq id = v->string.data + 1;
+    Size len = v->string.length - 1;
+    KVPair* kv = mapLookup(ids, id, len, hashBytes(SHIP_HASH_SEED, id, len));
+    if(!kv)
+    {
+        return false;
+    }
+    *dep = (Size)kv->value.number;
+    return true;
+}
+
+/// @brief Resolve task dependencies into an execution graph.
+/// Tasks run in plan order by default; a `parallel` group runs its members
+/// concurrently, and an explicit `after: "a, b"` replaces the implicit edge
+/// with edges to the tasks whose `id` is listed. An argument of the form
+/// "@id" consumes that task's result and adds an edge to it as well.
+Bool planBuild(ShipVector tasks, ShipArena* arena)
+{
+    ShipMap ids;
+    mapInitArena(&ids, arena);
+    for(Size i = 0; i < tasks.length; i++)
+    {
+        ShipTask* t = (ShipTask*)tasks.data[i];
+        ShipString* id = valueAsString(mapGetStr(&t->args, "id"));
+        if(id)
+        {
+            mapSet(&ids, *id, valueFromNumber((Float64)i));
+        }
+    }
+
+    Size* scratch = null;
+    Size scratch_cap = 0;
+    Size unit_start = 0;
+    Size prev_start = 0;
+    for(Size i = 0; i < tasks.length; i++)
+    {
+        ShipTask* t = (ShipTask*)tasks.data[i];
+        ShipTask* prev = i > 0 ? (ShipTask*)tasks.data[i - 1] : null;
+        if(i > 0 && (t->group == 0 || t->group != prev->group))
+        {
+            prev_start = unit_start;
+            unit_start = i;
+        }
+        Size count = 0;
+
+        ShipValue* after = mapGetStr(&t->args, "after");
+        if(after)
+        {
+            ShipString text = valueToString(after);
+            CharSeq c = text.data;
+            CharSeq start;
+            Size len;
+            while(listNext(&c, &start, &len))
+            {
+                KVPair* kv = mapLookup(&ids, start, len, hashBytes(SHIP_HASH_SEED, start, len));
+                if(!kv)
+                {
+                    fprintf(stderr, FAIL "Error: Task %s depends on unknown id '%.*s'\n" ENDC, t->task_name.data, (Int32)len, start);
+                    stringFree(&text);
+                    free(scratch);
+                    return false;
+                }
+                Size dep = (Size)kv->value.number;
+                if(dep == i)
+                {
+                    fprintf(stderr, FAIL "Error: Task %s depends on itself\n" ENDC, t->task_name.data);
+                    stringFree(&text);
+                    free(scratch);
+                    return false;
+                }
+                planAddDep(&scratch, &count, &scratch_cap, dep);
+            }
+            stringFree(&text);
+        }
+        else if(unit_start > 0)
+        {
+            for(Size d = prev_start; d < unit_start; d++)
+            {
+                planAddDep(&scratch, &count, &scratch_cap, d);
+            }
+        }
+        for(Size a = 0; a < t->args.count; a++)
+        {
+            Size dep;
+            if(!taskRef(&ids, &t->args.items[a].value, &dep))
+            {
+                continue;
+            }
+            if(dep == i)
+            {
+                fprintf(stderr, FAIL "Error: Task %s consumes its own result\n" ENDC, t->task_name.data);
+                free(scratch);
+                return false;
+            }
+            Bool known = false;
+            for(Size d = 0; d < count; d++)
+            {
+                known = known || scratch[d] == dep;
+            }
+            if(!known) planAddDep(&scratch, &count, &scratch_cap, dep);
+        }
+        t->dep_count = count;
+        t->deps = (Size*)arenaAlloc(arena, (count ? count : 1) * sizeof(Size));
+        if(count) memcpy(t->deps, scratch, count * sizeof(Size));
+        t->dependent_count = 0;
+    }
+    free(scratch);
+
+    for(Size i = 0; i < tasks.length; i++)
+    {
+        ShipTask* t = (ShipTask*)tasks.data[i];
+        for(Size d = 0; d < t->dep_count; d++)
+        {
+            ((ShipTask*)tasks.data[t->deps[d]])->dependent_count++;
+        }
+    }
+    for(Size i = 0; i < tasks.length; i++)
+    {
+        ShipTask* t = (ShipTask*)tasks.data[i];
+        t->dependents = (Size*)arenaAlloc(arena, (t->dependent_count ? t->dependent_count : 1) * sizeof(Size));
+        t->dependent_count = 0;
+    }
+    for(Size i = 0; i < tasks.length; i++)
+    {
+        ShipTask* t = (ShipTask*)tasks.data[i];
+        for(Size d = 0; d < t->dep_count; d++)
+        {
+            ShipTask* dt = (ShipTask*)tasks.data[t->deps[d]];
+            dt->dependents[dt->dependent_count++] = i;
+        }
+    }
+
+    // Kahn's algorithm only to reject cycles before any worker starts
+    Size* pending = (Size*)malloc((tasks.length + 1) * sizeof(Size));
+    Size* queue = (Size*)malloc((tasks.length + 1) * sizeof(Size));
+    Size head = 0, tail = 0;
+    for(Size i = 0; i < tasks.length; i++)
+    {
+        pending[i] = ((ShipTask*)tasks.data[i])->dep_count;
+        if(pending[i] == 0) queue[tail++] = i;
+    }
+    while(head < tail)
+    {
+        ShipTask* t = (ShipTask*)tasks.data[queue[head++]];
+        for(Size d = 0; d < t->dependent_count; d++)
+        {
+            if(--pending[t->dependents[d]] == 0) queue[tail++] = t->dependents[d];
+        }
+    }
+    free(pending);
+    free(queue);
+    if(tail != tasks.length)
+    {
+        fprintf(stderr, FAIL "Error: Task dependencies contain a cycle\n" ENDC);
+        return false;
+    }
+    return true;
+}
+
+CharSeq taskLabel(ShipTask* t)
+{
+    // Fix for potential NULL task_name
+    return t->task_name.data ? t->task_name.data : "Unknown Task";
+}
+
+/// @brief Indented, dimmed dump of captured output, as in ship.py
+Void printVerboseBlock(CharSeq title, ShipString* content)
+{
+    printf(DIM "   ┌─ [%s] ──────────────────────────\n", title);
+    CharSeq line = content->data;
+    while(*line)
+    {
+        CharSeq end = strchr(line, '\n');
+        Size len = end ? (Size)(end - line) : strlen(line);
+        printf("   │ %.*s\n", (Int32)len, line);
+        line += len + (end ? 1 : 0);
+    }
+    printf("   └──────────────────────────────────────────" ENDC "\n");
+}
+
+/// @brief Print finished tasks in plan order. Caller holds the lock.
+Void schedulerReport(ShipScheduler* s)
+{
+    Size total = s->tasks->length;
+    while(s->next_report < total)
+    {
+        Size i = s->next_report;
+        if(s->states[i] == TASK_UNSELECTED)
+        {
+        }
+        else if(s->states[i] == TASK_SKIPPED)
+        {
+            printf(DIM "[%lu/%lu]" ENDC " " CHECK " %s " DIM "(Up to date)" ENDC "\n", (UInt64)(i+1), (UInt64)total, taskLabel((ShipTask*)s->tasks->data[i]));
+        }
+        else if(s->states[i] == TASK_RESTORED)
+        {
+            printf(DIM "[%lu/%lu]" ENDC " " CHECK " %s " DIM "(Restored from cache)" ENDC "\n", (UInt64)(i+1), (UInt64)total, taskLabel((ShipTask*)s->tasks->data[i]));
+        }
+        else if(s->states[i] == TASK_DONE)
+        {
+            ShipTask* t = (ShipTask*)s->tasks->data[i];
+            printf(DIM "[%lu/%lu]" ENDC " " CHECK " %s " DIM "(Done)" ENDC "\n", (UInt64)(i+1), (UInt64)total, taskLabel(t));
+            Bool verbose = valueAsBool(mapGetStr(&t->args, "verbose"), false);
+            if(verbose && s->results[i].stdout_str.length > 0)
+            {
+                printVerboseBlock("STDOUT", &s->results[i].stdout_str);
+            }
+        }
+        else if(s->states[i] == TASK_FAILED)
+        {
+            ShipResult* r = &s->results[i];
+            printf(DIM "[%lu/%lu]" ENDC " " CROSS " %s " FAIL "(FAILED, exit %d)" ENDC "\n", (UInt64)(i+1), (UInt64)total, taskLabel((ShipTask*)s->tasks->data[i]), r->returncode);
+            printf("\n" FAIL ">> ERROR DETAILS:" ENDC "\n");
+            if(r->stdout_str.length > 0)
+            {
+                printf(DIM "%.*s" ENDC "\n", (Int32)stringTrimmedLength(&r->stdout_str), r->stdout_str.data);
+            }
+            if(r->stderr_str.length > 0)
+            {
+                printf(WARNING "%.*s" ENDC "\n", (Int32)stringTrimmedLength(&r->stderr_str), r->stderr_str.data);
+            }
+        }
+        else if(!s->failed || s->running > 0)
+        {
+            break;
+        }
+        s->next_report++;
+    }
+    fflush(stdout);
+}
+
+/// @brief .ship/logs/<NNN>-<label>.log, with the label reduced to file-safe characters
+static Void taskLogPath(Int8* out, Size cap, Size index, CharSeq label)
+{
+    Int32 n = snprintf(out, cap, SHIP_LOG_DIR "/%03lu-", (UInt64)(index + 1));
+    Size at = n > 0 && (Size)n < cap ? (Size)n : 0;
+    for(CharSeq c = label; *c && at + 5 < cap; c++)
+    {
+        out[at++] = isalnum((UInt8)*c) || *c == '-' || *c == '.' ? *c : '_';
+    }
+    snprintf(out + at, cap - at, ".log");
+}
+
+/// @brief Copy t's args with every "@id" replaced by that task's result
+/// value; false (and nothing to free) when it has no references
+static Bool schedulerResolveArgs(ShipScheduler* s, ShipTask* t, ShipMap* out)
+{
+    Size dep;
+    Bool any = false;
+    for(Size a = 0; a < t->args.count && !any; a++)
+    {
+        any = taskRef(&s->ids, &t->args.items[a].value, &dep);
+    }
+    if(!any)
+    {
+        return false;
+    }
+    mapInit(out);
+    for(Size a = 0; a < t->args.count; a++)
+    {
+        KVPair* kv = &t->args.items[a];
+        mapSet(out, kv->key, taskRef(&s->ids, &kv->value, &dep) ? s->results[dep].value : kv->value);
+    }
+    return true;
+}
+
+/// @brief Mark every task whose result another task consumes through "@id".
+/// With a selection, the producers of selected consumers are selected too
+/// (transitively), since a consumer can only see a value its producer
+/// computed in this build. Returns the referenced flags; *selected is
+/// replaced by an expanded copy when there was a selection.
+static Bool* schedulerProducers(ShipVector* tasks, ShipMap* ids, Bool** selected)
+{
+    Size n = tasks->length;
+    Bool* referenced = (Bool*)calloc(n + 1, sizeof(Bool));
+    Bool* expanded = null;
+    if(*selected)
+    {
+        expanded = (Bool*)malloc((n + 1) * sizeof(Bool));
+        memcpy(expanded, *selected, n * sizeof(Bool));
+    }
+    // producers always come before their consumers in the graph, but not
+    // necessarily in plan order, so sweep until nothing changes
+    for(Bool changed = true; changed;)
+    {
+        changed = false;
+        for(Size i = 0; i < n; i++)
+        {
+            ShipTask* t = (ShipTask*)tasks->data[i];
+            for(Size a = 0; a < t->args.count; a++)
+            {
+                Size dep;
+                if(!taskRef(ids, &t->args.items[a].value, &dep))
+                {
+                    continue;
+                }
+                referenced[dep] = true;
+                if(expanded && expanded[i] && !expanded[dep])
+                {
+                    expanded[dep] = true;
+                    changed = true;
+                }
+            }
+        }
+    }
+    if(expanded)
+    {
+        *selected = expanded;
+    }
+    return referenced;
+}
+
+/// @brief Move the ready task with the longest remaining path whose
+/// cpus/memory fit what is left to the head of the ready queue (ties go to
+/// plan order); false when none fits (or none is ready). Caller holds the lock.
+static Bool schedulerPick(ShipScheduler* s)
+{
+    Size best = s->ready_tail;
+    for(Size r = s->ready_head; r < s->ready_tail; r++)
+    {
+        Size i = s->ready[r];
+        if(s->cpus[i] > s->cpus_free + 1e-9 || s->memory[i] > s->memory_free)
+        {
+            continue;
+        }
+        if(best == s->ready_tail || s->priority[i] > s->priority[s->ready[best]] ||
+            (s->priority[i] == s->priority[s->ready[best]] && i < s->ready[best]))
+        {
+            best = r;
+        }
+    }
+    if(best == s->ready_tail)
+    {
+        return false;
+    }
+    Size i = s->ready[best];
+    s->ready[best] = s->ready[s->ready_head];
+    s->ready[s->ready_head] = i;
+    return true;
+}
+
+Any schedulerWorker(Any arg)
+{
+    ShipScheduler* s = (ShipScheduler*)arg;
+    Size total = s->tasks->length;
+    traceThreadName("worker");
+    pthread_mutex_lock(&s->lock);
+    while(true)
+    {
+        Bool picked = false;
+        while(!s->failed && !(picked = schedulerPick(s)) && s->running > 0)
+        {
+            pthread_cond_wait(&s->cond, &s->lock);
+        }
+        if(s->failed || !picked)
+        {
+            break;
+        }
+        Size i = s->ready[s->ready_head++];
+        s->cpus_free -= s->cpus[i];
+        s->memory_free -= s->memory[i];
+        ShipTask* t = (ShipTask*)s->tasks->data[i];
+        Bool selected = !s->options->selected || s->options->selected[i];
+        s->states[i] = TASK_RUNNING;
+        s->running++;
+        if(selected)
+        {
+            printf(DIM "[%lu/%lu]" ENDC " " INFO " %s...\n", (UInt64)(i+1), (UInt64)total, taskLabel(t));
+            fflush(stdout);
+        }
+        pthread_mutex_unlock(&s->lock);
+
+        UInt64 start_ns = global_trace.enabled ? clockNs() : 0;
+        ShipTask* declared = t;
+        ShipTask resolved_task;
+        ShipMap resolved;
+        Bool has_refs = schedulerResolveArgs(s, t, &resolved);
+        if(has_refs)
+        {
+            resolved_task = *t;
+            resolved_task.args = resolved;
+            t = &resolved_task;
+        }
+        // a task whose result is consumed through "@id" always runs: neither
+        // the incremental state nor the artifact store keeps its value
+        Bool tracked = selected && stateTracked(t);
+        UInt64 inputs_hash = 0;
+        Bool fresh = tracked && stateCheck(s->state, t, &inputs_hash);
+        Bool skip = !selected || (fresh && !s->referenced[i] && !s->options->force);
+        ShipResult res = {0};
+        Bool restored = false;
+        Bool cacheable = !skip && tracked && !s->referenced[i] && s->options->artifact_dir && mapGetStr(&t->args, "outputs");
+        ShipDigest artifact;
+        cacheable = cacheable && artifactKey(t, &artifact);
+        Size restored_files = 0;
+        UInt64 ran_ns = 0;
+        if(cacheable && !s->options->force && artifactRestore(s->options->artifact_dir, &artifact, &restored_files))
+        {
+            Int8 msg[128];
+            snprintf(msg, sizeof(msg), "Restored %lu files from the artifact cache", (UInt64)restored_files);
+            res.stdout_str = stringFrom(msg);
+            res.stderr_str = stringEmpty();
+            stateRecord(s->state, t, inputs_hash);
+            restored = true;
+        }
+        else if(!skip)
+        {
+            // a broken token pipe degrades to running under -j alone
+            Bool slotted = s->jobserver.read_fd >= 0;
+            Int32 token = slotted ? jobserverAcquire(&s->jobserver) : SHIP_JOB_ERROR;
+            UInt64 wall = clockNs();
+            Int8 log_path[256];
+            taskLogPath(log_path, sizeof(log_path), i, taskLabel(t));
+            task_log_path = log_path;
+            // native tasks fan out onto pools; poolDestroy adds their threads here
+            ShipUsage pooled;
+            memset(&pooled, 0, sizeof(pooled));
+            task_usage = &pooled;
+            ShipUsage before = usageThread();
+            res = t->func(t->args);
+            ShipUsage after = usageThread();
+            task_usage = null;
+            task_log_path = null;
+            after.user_sec -= before.user_sec;
+            after.sys_sec -= before.sys_sec;
+            after.in_blocks -= before.in_blocks;
+            after.out_blocks -= before.out_blocks;
+            after.vol_switches -= before.vol_switches;
+            after.invol_switches -= before.invol_switches;
+            after.wall_ns = clockNs() - wall;
+            ran_ns = after.wall_ns;
+            if(slotted)
+            {
+                jobserverRelease(&s->jobserver, token);
+            }
+            usageAdd(&res.usage, &after);
+            usageAdd(&res.usage, &pooled);
+            if(tracked && res.returncode == 0)
+            {
+                stateRecord(s->state, t, inputs_hash);
+                if(cacheable && artifactStore(s->options->artifact_dir, &artifact, mapGetStr(&t->args, "outputs")))
+                {
+                    __atomic_add_fetch(&s->stored, 1, __ATOMIC_RELAXED);
+                }
+            }
+        }
+        if(global_trace.enabled && selected)
+        {
+            Int8 name[128];
+            snprintf(name, sizeof(name), "[%lu] %s", (UInt64)(i + 1), taskLabel(t));
+            traceSpan(skip ? "task.skipped" : "task", name, start_ns, clockNs(), -1);
+        }
+        if(has_refs)
+        {
+            mapFree(&resolved);
+            t = declared;
+        }
+
+        pthread_mutex_lock(&s->lock);
+        s->running--;
+        s->cpus_free += s->cpus[i];
+        s->memory_free += s->memory[i];
+        s->results[i] = res;
+        if(ran_ns && res.returncode == 0)
+        {
+            durationsRecord(s->durations, t, ran_ns);
+        }
+        if(res.returncode == 0)
+        {
+            s->states[i] = !selected ? TASK_UNSELECTED : skip ? TASK_SKIPPED : restored ? TASK_RESTORED : TASK_DONE;
+            for(Size d = 0; d < t->dependent_count; d++)
+            {
+                Size next = t->dependents[d];
+                if(--s->pending[next] == 0)
+                {
+                    s->states[next] = TASK_READY;
+                    s->ready[s->ready_tail++] = next;
+                }
+            }
+        }
+        else
+        {
+            s->states[i] = TASK_FAILED;
+            s->failed = true;
+        }
+        schedulerReport(s);
+        pthread_cond_broadcast(&s->cond);
+    }
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+    return null;
+}
+
+/// @brief End-of-build table of the heaviest tasks by CPU time, plus totals
+Void printStats(ShipScheduler* s)
+{
+    Size total = s->tasks->length;
+    Size* order = (Size*)malloc(total * sizeof(Size));
+    Size count = 0;
+    Size unmeasured = 0;
+    ShipUsage sum;
+    memset(&sum, 0, sizeof(sum));
+    for(Size i = 0; i < total; i++)
+    {
+        if(s->states[i] == TASK_DONE || s->states[i] == TASK_FAILED)
+        {
+            order[count++] = i;
+            if(s->results[i].usage.unmeasured)
+            {
+                sum.wall_ns += s->results[i].usage.wall_ns;
+                unmeasured++;
+            }
+            else
+            {
+                usageAdd(&sum, &s->results[i].usage);
+            }
+        }
+    }
+    for(Size i = 1; i < count; i++)
+    {
+        Size v = order[i];
+        ShipUsage* u = &s->results[v].usage;
+        Size j = i;
+        while(j > 0)
+        {
+            ShipUsage* w = &s->results[order[j - 1]].usage;
+            if(w->user_sec + w->sys_sec >= u->user_sec + u->sys_sec) break;
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = v;
+    }
+
+    printf("\n" BOLD "Resource usage (top %lu of %lu tasks by CPU):" ENDC "\n", (UInt64)(count < SHIP_STATS_TOP ? count : SHIP_STATS_TOP), (UInt64)count);
+    printf(DIM "  %-5s %-12s %9s %9s %9s %9s %9s %9s %9s %5s" ENDC "\n",
+        "step", "task", "wall s", "user s", "sys s", "rss MB", "blk in", "blk out", "ctx v/i", "procs");
+    for(Size k = 0; k < count && k < SHIP_STATS_TOP; k++)
+    {
+        Size i = order[k];
+        ShipUsage* u = &s->results[i].usage;
+        if(u->unmeasured)
+        {
+            printf("  %-5lu %-12.12s %9.3f %9s %9s %9s %9s %9s %9s %5s\n", (UInt64)(i + 1), taskLabel((ShipTask*)s->tasks->data[i]),
+                u->wall_ns / 1e9, "n/a", "n/a", "n/a", "n/a", "n/a", "n/a", "n/a");
+            continue;
+        }
+        Int8 ctx[32];
+        snprintf(ctx, sizeof(ctx), "%ld/%ld", u->vol_switches, u->invol_switches);
+        printf("  %-5lu %-12.12s %9.3f %9.3f %9.3f %9.1f %9ld %9ld %9s %5d\n", (UInt64)(i + 1), taskLabel((ShipTask*)s->tasks->data[i]),
+            u->wall_ns / 1e9, u->user_sec, u->sys_sec, u->max_rss_kb / 1024.0, u->in_blocks, u->out_blocks, ctx, u->children);
+    }
+    Int8 ctx[32];
+    snprintf(ctx, sizeof(ctx), "%ld/%ld", sum.vol_switches, sum.invol_switches);
+    printf(BOLD "  %-5s %-12s %9.3f %9.3f %9.3f %9.1f %9ld %9ld %9s %5d" ENDC "\n", "", "total",
+        sum.wall_ns / 1e9, sum.user_sec, sum.sys_sec, sum.max_rss_kb / 1024.0, sum.in_blocks, sum.out_blocks, ctx, sum.children);
+    if(unmeasured)
+    {
+        printf(DIM "  n/a: %lu task(s) ran on a remote executor or in the persistent shell; their CPU is not counted" ENDC "\n", (UInt64)unmeasured);
+    }
+    free(order);
+}
+
+/// @brief Human-readable duration: "0.4s", "42s", "3m 05s", "1h 20m"
+Void formatSeconds(Int8* buf, Size cap, Float64 seconds)
+{
+    UInt64 whole = (UInt64)(seconds + 0.5);
+    if(seconds < 10)
+    {
+        snprintf(buf, cap, "%.1fs", seconds);
+    }
+    else if(whole < 60)
+    {
+        snprintf(buf, cap, "%lus", whole);
+    }
+    else if(whole < 3600)
+    {
+        snprintf(buf, cap, "%lum %02lus", whole / 60, whole % 60);
+    }
+    else
+    {
+        snprintf(buf, cap, "%luh %02lum", whole / 3600, whole / 60 % 60);
+    }
+}
+
+Bool runBuild(ShipString title, ShipVector tasks, ShipBuildOptions* options)
+{
+    ShipMap ids;
+    mapInit(&ids);
+    for(Size i = 0; i < tasks.length; i++)
+    {
+        ShipString* id = valueAsString(mapGetStr(&((ShipTask*)tasks.data[i])->args, "id"));
+        if(id) mapSet(&ids, *id, valueFromNumber((Float64)i));
+    }
+    ShipBuildOptions effective = *options;
+    Bool* selected_by_caller = options->selected;
+    Bool* referenced = schedulerProducers(&tasks, &ids, &effective.selected);
+    options = &effective;
+
+    Size steps = tasks.length;
+    if(options->selected)
+    {
+        steps = 0;
+        for(Size i = 0; i < tasks.length; i++)
+        {
+            if(options->selected[i]) steps++;
+        }
+    }
+    ShipDurationLog durations;
+    durationsLoad(&durations, SHIP_DURATIONS_FILE);
+    Float64* priority = (Float64*)calloc(tasks.length + 1, sizeof(Float64));
+    Float64 estimate = planPriorities(&tasks, options, &durations, priority);
+    printHeader(title.data);
+    if(estimate > 0)
+    {
+        Int8 eta[32];
+        formatSeconds(eta, sizeof(eta), estimate);
+        printf(BOLD "Plan: %lu steps to execute (about %s)." ENDC "\n\n", (UInt64)steps, eta);
+    }
+    else
+    {
+        printf(BOLD "Plan: %lu steps to execute." ENDC "\n\n", (UInt64)steps);
+    }
+    if(options->dry_run)
+    {
+        for(Size i = 0; i < tasks.length; i++)
+        {
+            printf(DIM "[%lu/%lu]" ENDC " " INFO " %s...\n", (UInt64)(i+1), (UInt64)tasks.length, taskLabel((ShipTask*)tasks.data[i]));
+        }
+        durationsFree(&durations);
+        free(priority);
+        mapFree(&ids);
+        free(referenced);
+        if(effective.selected != selected_by_caller) free(effective.selected);
+        return true;
+    }
+    if(tasks.length == 0)
+    {
+        durationsFree(&durations);
+        free(priority);
+        mapFree(&ids);
+        free(referenced);
+        if(effective.selected != selected_by_caller) free(effective.selected);
+        return true;
+    }
+
+    ShipState state;
+    if(global_daemon && global_daemon->state_loaded)
+    {
+        state = global_daemon->state;
+    }
+    else
+    {
+        stateLoad(&state, SHIP_STATE_FILE);
+    }
+
+    ShipScheduler s;
+    s.tasks = &tasks;
+    s.options = options;
+    s.state = &state;
+    s.durations = &durations;
+    s.priority = priority;
+    s.states = (ShipTaskState*)malloc(tasks.length * sizeof(ShipTaskState));
+    s.results = (ShipResult*)calloc(tasks.length, sizeof(ShipResult));
+    s.pending = (Size*)malloc(tasks.length * sizeof(Size));
+    s.ready = (Size*)malloc(tasks.length * sizeof(Size));
+    s.ready_head = 0;
+    s.ready_tail = 0;
+    s.running = 0;
+    s.next_report = 0;
+    s.failed = false;
+    s.stored = 0;
+    // declared cpus/memory are clamped to the capacity so that an oversized
+    // task still runs, alone, instead of waiting forever
+    s.cpus_free = options->cpus > 0 ? options->cpus : (Float64)cpuCount();
+    s.memory_free = options->memory > 0 ? options->memory : memoryCapacity();
+    s.cpus = (Float64*)malloc(tasks.length * sizeof(Float64));
+    s.memory = (UInt64*)malloc(tasks.length * sizeof(UInt64));
+    for(Size i = 0; i < tasks.length; i++)
+    {
+        ShipTask* t = (ShipTask*)tasks.data[i];
+        Bool selected = !options->selected || options->selected[i];
+        ShipValue* mem = mapGetStr(&t->args, "memory");
+        UInt64 bytes = 0;
+        if(mem && mem->type == SHIP_VALUE_NUMBER && mem->number > 0)
+        {
+            bytes = (UInt64)(mem->number * 1024.0 * 1024.0);
+        }
+        else if(valueAsString(mem) && !parseMemory(valueAsString(mem)->data, &bytes))
+        {
+            fprintf(stderr, WARNING "Warning: %s: cannot parse memory '%s'\n" ENDC, taskLabel(t), valueAsString(mem)->data);
+        }
+        Float64 cpus = valueAsNumber(mapGetStr(&t->args, "cpus"), 1);
+        s.cpus[i] = !selected || cpus < 0 ? 0 : cpus < s.cpus_free ? cpus : s.cpus_free;
+        s.memory[i] = !selected ? 0 : bytes < s.memory_free ? bytes : s.memory_free;
+    }
+    memset(&s.jobserver, 0, sizeof(s.jobserver));
+    s.jobserver.read_fd = -1;
+    if(options->jobserver)
+    {
+        jobserverInit(&s.jobserver, options->jobs);
+    }
+    s.ids = ids;
+    s.referenced = referenced;
+    pthread_mutex_init(&s.lock, null);
+    pthread_cond_init(&s.cond, null);
+    for(Size i = 0; i < tasks.length; i++)
+    {
+        ShipTask* t = (ShipTask*)tasks.data[i];
+        s.pending[i] = t->dep_count;
+        s.states[i] = t->dep_count == 0 ? TASK_READY : TASK_WAITING;
+        if(t->dep_count == 0) s.ready[s.ready_tail++] = i;
+    }
+
+    Size workers = options->jobs > 0 ? (Size)options->jobs : 1;
+    if(workers > tasks.length) workers = tasks.length;
+    pthread_t* threads = (pthread_t*)malloc(workers * sizeof(pthread_t));
+    for(Size w = 0; w < workers; w++)
+    {
+        pthread_create(&threads[w], null, schedulerWorker, &s);
+    }
+    for(Size w = 0; w < workers; w++)
+    {
+        pthread_join(threads[w], null);
+    }
+    logWriterDrain();
+    schedulerReport(&s);
+    if(options->stats)
+    {
+        printStats(&s);
+    }
+    if(s.failed)
+    {
+        printf(FAIL "Failed!\n" ENDC);
+    }
+    jobserverFree(&s.jobserver);
+    if(s.stored > 0)
+    {
+        artifactEvict(options->artifact_dir, options->artifact_limit);
+    }
+    if(!stateSave(&state, SHIP_STATE_FILE))
+    {
+        fprintf(stderr, WARNING "Warning: could not write %s\n" ENDC, SHIP_STATE_FILE);
+    }
+    if(!durationsSave(&durations, SHIP_DURATIONS_FILE))
+    {
+        fprintf(stderr, WARNING "Warning: could not write %s\n" ENDC, SHIP_DURATIONS_FILE);
+    }
+
+    Bool ok = !s.failed;
+    shellClose(&global_shell);
+    stateFree(&state);
+    durationsFree(&durations);
+    pthread_mutex_destroy(&s.lock);
+    pthread_cond_destroy(&s.cond);
+    free(threads);
+    for(Size i = 0; i < tasks.length; i++)
+    {
+        stringFree(&s.results[i].stdout_str);
+        stringFree(&s.results[i].stderr_str);
+        valueFree(&s.results[i].value);
+    }
+    mapFree(&s.ids);
+    free(s.referenced);
+    if(effective.selected != selected_by_caller) free(effective.selected);
+    free(s.cpus);
+    free(s.memory);
+    free(s.priority);
+    free(s.states);
+    free(s.results);
+    free(s.pending);
+    free(s.ready);
+    return ok;
+}
+
+Void printHeader(CharSeq title)
+{
+    printf("\n" HEADER BOLD "============================================================" ENDC "\n");
+    printf(HEADER BOLD "   %s" ENDC "\n", title);
+    printf(HEADER BOLD "============================================================" ENDC "\n\n");
+}
+
+/// @brief Append formatted text to a string builder
+Void benchAppendf(ShipString* s, CharSeq fmt, ...)
+{
+    Int8 buf[512];
+    va_list ap;
+    va_start(ap, fmt);
+    Int32 n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if(n > 0) stringAppend(s, buf, (Size)n < sizeof(buf) ? (Size)n : sizeof(buf) - 1);
+}
+
+/// @brief Deterministic synthetic Shipfile: config->vars string variables
+/// (escape_pct percent of them with escape sequences) and config->tasks tasks
+/// in chunks wrapped in config->depth nested if blocks, each with a dead else
+ShipString benchGenerate(ShipBenchConfig* config)
+{
+    ShipString s = stringFrom("ship {\n  title: \"Bench\"\n  var {\n    mode = \"bench\"\n");
+    for(Size i = 0; i < config->vars; i++)
+    {
+        if((Int32)(i % 100) < config->escape_pct)
+        {
+            benchAppendf(&s, "    v%lu = \"value \\\"%lu\\\"\\tend\\n\"\n", (UInt64)i, (UInt64)i);
+        }
+        else
+        {
+            benchAppendf(&s, "    v%lu = \"value %lu\"\n", (UInt64)i, (UInt64)i);
+        }
+    }
+    stringAppend(&s, "  }\n", 4);
+    Size chunk = config->depth > 0 ? 16 : (config->tasks ? config->tasks : 1);
+    for(Size i = 0; i < config->tasks;)
+    {
+        for(Int32 d = 0; d < config->depth; d++)
+        {
+            benchAppendf(&s, "  if %d < %d && (mode == \"bench\" || !false) {\n", d, d + 1);
+        }
+        for(Size k = 0; k < chunk && i < config->tasks; k++, i++)
+        {
+            if(i % 2 == 0 && config->vars > 0)
+            {
+                benchAppendf(&s, "    echo { message: v%lu }\n", (UInt64)(i % config->vars));
+            }
+            else
+            {
+                benchAppendf(&s, "    run { command: \"echo task %lu\", id: \"t%lu\" }\n", (UInt64)i, (UInt64)i);
+            }
+        }
+        for(Int32 d = 0; d < config->depth; d++)
+        {
+            benchAppendf(&s, "  } else { echo { message: \"dead\" } }\n");
+        }
+    }
+    stringAppend(&s, "}\n", 2);
+    return s;
+}
+
+Void benchSample(ShipBenchResult* r, UInt64 ns, Size items)
+{
+    r->items = items;
+    r->min_ns = r->runs == 0 || ns < r->min_ns ? ns : r->min_ns;
+    r->max_ns = ns > r->max_ns ? ns : r->max_ns;
+    r->total_ns += ns;
+    r->runs++;
+}
+
+/// @brief Time tokenize, parserParse, mapSet/mapGet, planBuild and a dry-run
+/// runBuild over a generated script, and write the samples as JSON
+Bool benchRun(ShipBenchConfig* config, CharSeq out_path)
+{
+    ShipString src = benchGenerate(config);
+    ShipBenchResult results[] = {
+        { "tokenize", 0, 0, 0, 0, 0 },
+        { "parse", 0, 0, 0, 0, 0 },
+        { "map_set", 0, 0, 0, 0, 0 },
+        { "map_get", 0, 0, 0, 0, 0 },
+        { "plan", 0, 0, 0, 0, 0 },
+        { "run_dry", 0, 0, 0, 0, 0 },
+    };
+    Size phases = sizeof(results) / sizeof(results[0]);
+    Size key_count = config->vars ? config->vars : 1;
+    ShipString* keys = (ShipString*)malloc(key_count * sizeof(ShipString));
+    for(Size i = 0; i < key_count; i++)
+    {
+        Int8 buf[32];
+        snprintf(buf, sizeof(buf), "v%lu", (UInt64)i);
+        keys[i] = stringFrom(buf);
+    }
+    ShipBuildOptions options = { true, 1, false, false, null, null, 0, false, 0, 0 };
+    Int32 devnull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    printf(BOLD "Benchmark: %lu vars, %lu tasks, depth %d, %d%% escapes, %lu KB script" ENDC "\n",
+        (UInt64)config->vars, (UInt64)config->tasks, config->depth, config->escape_pct, (UInt64)(src.length >> 10));
+
+    for(Int32 it = 0; it < config->iterations; it++)
+    {
+        ShipArena arena;
+        arenaInit(&arena);
+        UInt64 t0 = clockNs();
+        ShipTokenList tokens = tokenize(&arena, src.data, src.length);
+        benchSample(&results[0], clockNs() - t0, tokens.length);
+
+        ShipParser parser;
+        parserInit(&parser, tokens, &arena);
+        t0 = clockNs();
+        parserParse(&parser);
+        benchSample(&results[1], clockNs() - t0, tokens.length);
+
+        ShipMap m;
+        mapInit(&m);
+        t0 = clockNs();
+        for(Size i = 0; i < key_count; i++)
+        {
+            mapSet(&m, keys[i], valueFromNumber((Float64)i));
+        }
+        benchSample(&results[2], clockNs() - t0, key_count);
+        Float64 sum = 0;
+        t0 = clockNs();
+        for(Size i = 0; i < key_count; i++)
+        {
+            sum += valueAsNumber(mapGet(&m, keys[i]), 0);
+        }
+        benchSample(&results[3], clockNs() - t0, key_count);
+        use(sum);
+        mapFree(&m);
+
+        t0 = clockNs();
+        Bool planned = planBuild(parser.tasks, &arena);
+        benchSample(&results[4], clockNs() - t0, parser.tasks.length);
+
+        fflush(stdout);
+        Int32 saved = dup(STDOUT_FILENO);
+        if(devnull >= 0) dup2(devnull, STDOUT_FILENO);
+        t0 = clockNs();
+        if(planned) runBuild(parser.title, parser.tasks, &options);
+        fflush(stdout);
+        benchSample(&results[5], clockNs() - t0, parser.tasks.length);
+        dup2(saved, STDOUT_FILENO);
+        close(saved);
+
+        free(tokens.data);
+        free(parser.tasks.data);
+        arenaFree(&arena);
+    }
+
+    FILE* f = fopen(out_path, "w");
+    if(f)
+    {
+        fprintf(f, "{\n  \"version\": \"%s\",\n", SHIP_VERSION);
+        fprintf(f, "  \"config\": { \"vars\": %lu, \"tasks\": %lu, \"depth\": %d, \"escape_pct\": %d, \"iterations\": %d, \"script_bytes\": %lu },\n",
+            (UInt64)config->vars, (UInt64)config->tasks, config->depth, config->escape_pct, config->iterations, (UInt64)src.length);
+        fprintf(f, "  \"results\": [\n");
+    }
+    printf("\n  %-10s %10s %12s %12s %12s %12s\n", "phase", "items", "min ms", "mean ms", "max ms", "ns/item");
+    for(Size i = 0; i < phases; i++)
+    {
+        ShipBenchResult* r = &results[i];
+        Float64 mean = r->runs ? (Float64)r->total_ns / r->runs : 0;
+        Float64 per_item = r->items ? mean / r->items : 0;
+        printf("  %-10s %10lu %12.3f %12.3f %12.3f %12.1f\n", r->phase, (UInt64)r->items,
+            r->min_ns / 1e6, mean / 1e6, r->max_ns / 1e6, per_item);
+        if(f)
+        {
+            fprintf(f, "    { \"phase\": \"%s\", \"items\": %lu, \"runs\": %d, \"min_ns\": %lu, \"mean_ns\": %.0f, \"max_ns\": %lu, \"ns_per_item\": %.2f }%s\n",
+                r->phase, (UInt64)r->items, r->runs, r->min_ns, mean, r->max_ns, per_item, i + 1 < phases ? "," : "");
+        }
+    }
+    Bool ok = f != null;
+    if(f)
+    {
+        fprintf(f, "  ]\n}\n");
+        ok = fclose(f) == 0;
+        printf("\n" DIM "Results written to %s" ENDC "\n", out_path);
+    }
+    else
+    {
+        fprintf(stderr, FAIL "Error: Cannot write %s\n" ENDC, out_path);
+    }
+
+    if(devnull >= 0) close(devnull);
+    for(Size i = 0; i < key_count; i++)
+    {
+        stringFree(&keys[i]);
+    }
+    free(keys);
+    stringFree(&src);
+    return ok;
+}
+
+/// @brief Parse argv into cli; on failure err holds the message to print
+Bool cliParse(ShipCli* cli, Int32 argc, Int8** argv, Int8* err, Size err_cap)
+{
+    ShipBenchConfig bench_config = { 10000, 2000, 3, 10, 5 };
+    cli->script_path = "Shipfile";
+    cli->options.dry_run = false;
+    cli->options.jobs = cpuCount();
+    cli->options.force = false;
+    cli->options.stats = false;
+    cli->options.selected = null;
+    cli->options.jobserver = true;
+    cli->options.cpus = 0;
+    cli->options.memory = 0;
+    cli->options.artifact_dir = getenv(SHIP_ARTIFACT_ENV);
+    if(cli->options.artifact_dir && !cli->options.artifact_dir[0]) cli->options.artifact_dir = null;
+    CharSeq limit = getenv(SHIP_ARTIFACT_LIMIT_ENV);
+    cli->options.artifact_limit = (UInt64)(limit ? atoll(limit) : SHIP_ARTIFACT_LIMIT_MB) << 20;
+    cli->use_cache = true;
+    cli->bench = false;
+    cli->bench_config = bench_config;
+    cli->trace_path = null;
+    cli->daemon = false;
+    cli->client = false;
+    cli->watch = false;
+    cli->remote = getenv(SHIP_REMOTE_ENV);
+    cli->worker = null;
+    for(Int32 i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--dry-run") == 0)
+        {
+            cli->options.dry_run = true;
+        }
+        else if(strcmp(argv[i], "--force") == 0)
+        {
+            cli->options.force = true;
+        }
+        else if(strcmp(argv[i], "--stats") == 0)
+        {
+            cli->options.stats = true;
+        }
+        else if(strcmp(argv[i], "--no-cache") == 0)
+        {
+            cli->use_cache = false;
+        }
+        else if(strcmp(argv[i], "--daemon") == 0)
+        {
+            cli->daemon = true;
+        }
+        else if(strcmp(argv[i], "--client") == 0)
+        {
+            cli->client = true;
+        }
+        else if(strcmp(argv[i], "--watch") == 0)
+        {
+            cli->watch = true;
+        }
+        else if(strcmp(argv[i], "--trace") == 0)
+        {
+            if(i + 1 >= argc)
+            {
+                snprintf(err, err_cap, "Error: %s requires a value", argv[i]);
+                return false;
+            }
+            cli->trace_path = argv[++i];
+        }
+        else if(strcmp(argv[i], "--artifact-cache") == 0)
+        {
+            if(i + 1 >= argc)
+            {
+                snprintf(err, err_cap, "Error: %s requires a value", argv[i]);
+                return false;
+            }
+            cli->options.artifact_dir = argv[++i];
+        }
+        else if(strcmp(argv[i], "--artifact-limit") == 0)
+        {
+            if(i + 1 >= argc)
+            {
+                snprintf(err, err_cap, "Error: %s requires a value", argv[i]);
+                return false;
+            }
+            cli->options.artifact_limit = (UInt64)atoll(argv[++i]) << 20;
+        }
+        else if(strcmp(argv[i], "--remote") == 0)
+        {
+            if(i + 1 >= argc)
+            {
+                snprintf(err, err_cap, "Error: %s requires a value", argv[i]);
+                return false;
+            }
+            cli->remote = argv[++i];
+        }
+        else if(strcmp(argv[i], "--worker") == 0)
+        {
+            if(i + 1 >= argc)
+            {
+                snprintf(err, err_cap, "Error: %s requires a value", argv[i]);
+                return false;
+            }
+            cli->worker = argv[++i];
+        }
+        else if(strcmp(argv[i], "--cpus") == 0)
+        {
+            if(i + 1 >= argc)
+            {
+                snprintf(err, err_cap, "Error: %s requires a value", argv[i]);
+                return false;
+            }
+            cli->options.cpus = atof(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--memory") == 0)
+        {
+            if(i + 1 >= argc || !parseMemory(argv[i + 1], &cli->options.memory))
+            {
+                snprintf(err, err_cap, "Error: %s requires a size such as 16G", argv[i]);
+                return false;
+            }
+            i++;
+        }
+        else if(strcmp(argv[i], "--no-jobserver") == 0)
+        {
+            cli->options.jobserver = false;
+        }
+        else if(strcmp(argv[i], "--no-artifacts") == 0)
+        {
+            cli->options.artifact_dir = null;
+        }
+        else if(strcmp(argv[i], "--bench") == 0)
+        {
+            cli->bench = true;
+        }
+        else if(strncmp(argv[i], "--bench-", 8) == 0)
+        {
+            if(i + 1 >= argc)
+            {
+                snprintf(err, err_cap, "Error: %s requires a value", argv[i]);
+                return false;
+            }
+            CharSeq name = argv[i] + 8;
+            Int64 value = atoll(argv[++i]);
+            if(value < 0) value = 0;
+            if(strcmp(name, "vars") == 0) cli->bench_config.vars = (Size)value;
+            else if(strcmp(name, "tasks") == 0) cli->bench_config.tasks = (Size)value;
+            else if(strcmp(name, "depth") == 0) cli->bench_config.depth = (Int32)value;
+            else if(strcmp(name, "escapes") == 0) cli->bench_config.escape_pct = value > 100 ? 100 : (Int32)value;
+            else if(strcmp(name, "iterations") == 0) cli->bench_config.iterations = value < 1 ? 1 : (Int32)value;
+            else
+            {
+                snprintf(err, err_cap, "Error: Unknown option %s", argv[i - 1]);
+                return false;
+            }
+            cli->bench = true;
+        }
+        else if(strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--jobs") == 0)
+        {
+            if(i + 1 >= argc)
+            {
+                snprintf(err, err_cap, "Error: %s requires a value", argv[i]);
+                return false;
+            }
+            cli->options.jobs = atoi(argv[++i]);
+        }
+        else if(strncmp(argv[i], "-j", 2) == 0)
+        {
+            cli->options.jobs = atoi(argv[i] + 2);
+        }
+        else
+        {
+            cli->script_path = argv[i];
+        }
+    }
+    if(cli->options.jobs < 1)
+    {
+        cli->options.jobs = 1;
+    }
+    return true;
+}
+
+/// @brief Open a script, trying the `.ship` suffix too, and map its bytes
+Bool sourceOpen(CharSeq script_path, ShipSource* src)
+{
+    src->data = null;
+    src->size = 0;
+    src->mapped = false;
+    Int32 fd = open(script_path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+    {
+        Int8 buf[PATH_MAX];
+        snprintf(buf, sizeof(buf), "%s.ship", script_path);
+        fd = open(buf, O_RDONLY | O_CLOEXEC);
+        if(fd < 0)
+        {
+            printf(FAIL "Error: Script not found: %s\n" ENDC, script_path);
+            return false;
+        }
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0)
+    {
+        printf(FAIL "Error: Cannot stat script: %s\n" ENDC, script_path);
+        close(fd);
+        return false;
+    }
+    src->size = (Size)st.st_size;
+    if(src->size > 0)
+    {
+        src->data = (Int8*)mmap(null, src->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(src->data != MAP_FAILED)
+        {
+            src->mapped = true;
+        }
+        else
+        {
+            src->data = (Int8*)malloc(src->size);
+            Size got = 0;
+            while(got < src->size)
+            {
+                ssize_t n = read(fd, src->data + got, src->size - got);
+                if(n <= 0) break;
+                got += (Size)n;
+            }
+            src->size = got;
+        }
+    }
+    close(fd);
+    return true;
+}
+
+Void sourceClose(ShipSource* src)
+{
+    if(src->mapped) munmap(src->data, src->size);
+    else free(src->data);
+    src->data = null;
+    src->size = 0;
+    src->mapped = false;
+}
+
+/// @brief Resolve a script to its task list: from the daemon's memory, the
+/// .shipc cache, or a fresh lex and parse
+Bool scriptLoad(ShipCli* cli, ShipScript* script)
+{
+    UInt64 phase_ns = clockNs();
+    arenaInit(&script->arena);
+    script->cache.data = null;
+    script->cache.size = 0;
+    script->tokens.data = null;
+    ShipSource src;
+    if(!sourceOpen(cli->script_path, &src))
+    {
+        arenaFree(&script->arena);
+        return false;
+    }
+    CharSeq content = src.data ? src.data : "";
+    UInt64 key = cacheKey(content, src.size);
+    Int8 cache_path[PATH_MAX];
+    cachePath(cli->script_path, cache_path, sizeof(cache_path));
+    traceSpan("phase", "read", phase_ns, clockNs(), -1);
+    phase_ns = clockNs();
+    ShipWarmScript* warm = global_daemon ? (ShipWarmScript*)mapGetPointer(&global_daemon->scripts, stringView(cli->script_path)) : null;
+    Bool cached = false;
+    if(warm && warm->key == key)
+    {
+        script->title = warm->title;
+        vectorInit(&script->tasks);
+        for(Size i = 0; i < warm->tasks.length; i++)
+        {
+            vectorPush(&script->tasks, warm->tasks.data[i]);
+        }
+        cached = true;
+        traceSpan("phase", "daemon", phase_ns, clockNs(), -1);
+    }
+    else if(cli->use_cache)
+    {
+        cached = cacheLoad(cache_path, key, &script->arena, &script->cache, &script->title, &script->tasks);
+        traceSpan("phase", cached ? "cache load" : "cache miss", phase_ns, clockNs(), -1);
+    }
+    if(!cached)
+    {
+        phase_ns = clockNs();
+        script->tokens = tokenize(&script->arena, content, src.size);
+        traceSpan("phase", "lex", phase_ns, clockNs(), -1);
+        phase_ns = clockNs();
+        ShipParser parser;
+        parserInit(&parser, script->tokens, &script->arena);
+        Bool parsed = parserParse(&parser);
+        script->title = parser.title;
+        script->tasks = parser.tasks;
+        traceSpan("phase", "parse", phase_ns, clockNs(), -1);
+        if(!parsed)
+        {
+            sourceClose(&src);
+            scriptFree(script);
+            return false;
+        }
+        if(cli->use_cache)
+        {
+            phase_ns = clockNs();
+            cacheSave(cache_path, key, script->title, script->tasks);
+            traceSpan("phase", "cache save", phase_ns, clockNs(), -1);
+        }
+    }
+    sourceClose(&src);
+    phase_ns = clockNs();
+    Bool ok = planBuild(script->tasks, &script->arena);
+    traceSpan("phase", "plan", phase_ns, clockNs(), -1);
+    if(!ok)
+    {
+        scriptFree(script);
+    }
+    return ok;
+}
+
+Void scriptFree(ShipScript* script)
+{
+    free(script->tokens.data);
+    free(script->tasks.data);
+    script->tokens.data = null;
+    script->tasks.data = null;
+    cacheClose(&script->cache);
+    arenaFree(&script->arena);
+}
+
+/// @brief Load, plan and run a script once
+Int32 buildScript(ShipCli* cli)
+{
+    if(cli->trace_path)
+    {
+        traceStart();
+        traceThreadName("main");
+    }
+    ShipScript script;
+    Bool ok = scriptLoad(cli, &script);
+    if(ok)
+    {
+        UInt64 phase_ns = clockNs();
+        ok = runBuild(script.title, script.tasks, &cli->options);
+        traceSpan("phase", "build", phase_ns, clockNs(), -1);
+        scriptFree(&script);
+    }
+    if(cli->trace_path)
+    {
+        traceWrite(cli->trace_path);
+    }
+    return ok ? 0 : 1;
+}
+
+#ifdef __linux__
+Bool watcherInit(ShipWatcher* w)
+{
+    w->fd = inotify_init1(IN_CLOEXEC);
+    vectorInit(&w->dirs);
+    return w->fd >= 0;
+}
+
+Void watcherAddDir(ShipWatcher* w, CharSeq dir)
+{
+    Int32 wd = inotify_add_watch(w->fd, dir, IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR);
+    if(wd < 0)
+    {
+        return;
+    }
+    while(w->dirs.length <= (Size)wd)
+    {
+        vectorPush(&w->dirs, null);
+    }
+    free(w->dirs.data[wd]);
+    w->dirs.data[wd] = stringFrom(dir).data;
+}
+
+/// @brief Watch a directory and everything below it, or the directory holding
+/// a file (editors often replace files by rename, which a file watch misses)
+Void watcherAddTree(ShipWatcher* w, CharSeq path)
+{
+    struct stat sb;
+    if(stat(path, &sb) != 0 || !S_ISDIR(sb.st_mode))
+    {
+        CharSeq slash = strrchr(path, '/');
+        ShipString parent = slash ? stringFromLength(path, slash == path ? 1 : (Size)(slash - path)) : stringFrom(".");
+        if(stat(parent.data, &sb) == 0 && S_ISDIR(sb.st_mode))
+        {
+            watcherAddDir(w, parent.data);
+        }
+        stringFree(&parent);
+        return;
+    }
+    watcherAddDir(w, path);
+    Int32 fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    ShipDirReader r;
+    if(fd < 0 || !dirOpen(&r, fd))
+    {
+        return;
+    }
+    CharSeq name;
+    UInt8 type;
+    while(dirNext(&r, &name, &type))
+    {
+        if(type != DT_DIR && type != DT_UNKNOWN) continue;
+        if(strcmp(path, ".") == 0 && strcmp(name, SHIP_STATE_DIR) == 0) continue;
+        Int8* child = strcmp(path, ".") == 0 ? stringFrom(name).data : pathJoin(path, name);
+        if(type == DT_DIR || (stat(child, &sb) == 0 && S_ISDIR(sb.st_mode)))
+        {
+            watcherAddTree(w, child);
+        }
+        free(child);
+    }
+    dirClose(&r);
+}
+
+Void watcherFree(ShipWatcher* w)
+{
+    for(Size i = 0; i < w->dirs.length; i++)
+    {
+        free(w->dirs.data[i]);
+    }
+    free(w->dirs.data);
+    if(w->fd >= 0) close(w->fd);
+    w->fd = -1;
+}
+
+/// @brief Drain one batch of events into changed (malloc'd paths), following
+/// new subdirectories. Returns false on a read error.
+Bool watcherRead(ShipWatcher* w, ShipVector* changed)
+{
+    Int8 buffer[1 << 14] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t n = read(w->fd, buffer, sizeof(buffer));
+    if(n <= 0)
+    {
+        return n < 0 && errno == EINTR;
+    }
+    for(Int8* p = buffer; p < buffer + n;)
+    {
+        struct inotify_event* e = (struct inotify_event*)p;
+        p += sizeof(struct inotify_event) + e->len;
+        if(e->wd < 0 || (Size)e->wd >= w->dirs.length || !w->dirs.data[e->wd])
+        {
+            continue;
+        }
+        CharSeq dir = (CharSeq)w->dirs.data[e->wd];
+        if(e->mask & IN_IGNORED)
+        {
+            free(w->dirs.data[e->wd]);
+            w->dirs.data[e->wd] = null;
+            continue;
+        }
+        if(e->len == 0)
+        {
+            continue;
+        }
+        Int8* path = strcmp(dir, ".") == 0 ? stringFrom(e->name).data : pathJoin(dir, e->name);
+        if(strncmp(path, SHIP_STATE_DIR "/", sizeof(SHIP_STATE_DIR)) == 0)
+        {
+            free(path);
+            continue;
+        }
+        if((e->mask & (IN_CREATE | IN_MOVED_TO)) && (e->mask & IN_ISDIR))
+        {
+            watcherAddTree(w, path);
+        }
+        Bool seen = false;
+        for(Size i = changed->length; i > 0 && !seen; i--)
+        {
+            seen = strcmp((CharSeq)changed->data[i - 1], path) == 0;
+        }
+        if(seen)
+        {
+            free(path);
+            continue;
+        }
+        vectorPush(changed, path);
+    }
+    return true;
+}
+#else
+Bool watcherInit(ShipWatcher* w)
+{
+    w->fd = -1;
+    vectorInit(&w->dirs);
+    return false;
+}
+
+Void watcherAddTree(ShipWatcher* w, CharSeq path)
+{
+    use(w);
+    use(path);
+}
+
+Void watcherFree(ShipWatcher* w)
+{
+    free(w->dirs.data);
+}
+
+Bool watcherRead(ShipWatcher* w, ShipVector* changed)
+{
+    use(w);
+    use(changed);
+    return false;
+}
+#endif
+
+/// @brief Append the paths of a path-list arg, normalised like inotify
+/// reports them (no "./" prefix, no trailing slash)
+static Void watchAddPaths(ShipValue* v, ShipVector* paths)
+{
+    if(!v)
+    {
+        return;
+    }
+    ShipString text = valueToString(v);
+    CharSeq c = text.data;
+    CharSeq start;
+    Size len;
+    while(listNext(&c, &start, &len))
+    {
+        while(len > 1 && start[len - 1] == '/') len--;
+        if(len > 2 && start[0] == '.' && start[1] == '/')
+        {
+            start += 2;
+            len -= 2;
+        }
+        vectorPush(paths, stringFromLength(start, len).data);
+    }
+    stringFree(&text);
+}
+
+/// @brief Paths whose changes should rerun a task: its declared inputs, else
+/// the src of copy/move/zip style tasks, or the path a list task reads
+Void watchTaskRoots(ShipTask* t, ShipVector* roots)
+{
+    ShipValue* v = mapGetStr(&t->args, "inputs");
+    if(!v) v = mapGetStr(&t->args, "src");
+    if(!v && strcmp(t->task_name.data, "list") == 0) v = mapGetStr(&t->args, "path");
+    watchAddPaths(v, roots);
+}
+
+/// @brief Paths a task writes: declared outputs and the destination of
+/// copy/move/zip style tasks. Changes there are the build's own doing.
+Void watchTaskOutputs(ShipTask* t, ShipVector* outputs)
+{
+    watchAddPaths(mapGetStr(&t->args, "outputs"), outputs);
+    watchAddPaths(mapGetStr(&t->args, "dst"), outputs);
+    watchAddPaths(mapGetStr(&t->args, "zip_path"), outputs);
+}
+
+/// @brief path is one of the outputs, lies below one, or is a temporary
+/// sibling of one ("<output>.<anything>.tmp") written on the way to a rename
+static Bool watchIsOutput(CharSeq path, ShipVector* outputs)
+{
+    while(path[0] == '.' && path[1] == '/') path += 2;
+    for(Size i = 0; i < outputs->length; i++)
+    {
+        CharSeq out = (CharSeq)outputs->data[i];
+        Size n = strlen(out);
+        Size len = strlen(path);
+        if(strcmp(out, ".") == 0)
+        {
+            continue;
+        }
+        if(watchPathUnder(path, out))
+        {
+            return true;
+        }
+        if(len > n + 4 && strncmp(path, out, n) == 0 && path[n] == '.' && strcmp(path + len - 4, ".tmp") == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/// @brief path is root itself or lies below it
+Bool watchPathUnder(CharSeq path, CharSeq root)
+{
+    Size n = strlen(root);
+    if(strcmp(root, ".") == 0)
+    {
+        return true;
+    }
+    return strncmp(path, root, n) == 0 && (path[n] == '\0' || path[n] == '/');
+}
+
+/// @brief Build once, then rebuild on file changes. Tasks whose watched
+/// roots changed rerun together with everything that depends on them; an
+/// edit to the script itself reloads and rebuilds it in full.
+Int32 watchRun(ShipCli* cli)
+{
+    ShipWatcher w;
+    if(!watcherInit(&w))
+    {
+        fprintf(stderr, FAIL "Error: --watch needs inotify, which is unavailable here\n" ENDC);
+        return 1;
+    }
+    watcherFree(&w);
+    while(true)
+    {
+        ShipScript script;
+        Bool loaded = scriptLoad(cli, &script);
+        Size count = loaded ? script.tasks.length : 0;
+        if(loaded)
+        {
+            cli->options.selected = null;
+            runBuild(script.title, script.tasks, &cli->options);
+        }
+
+        if(!watcherInit(&w))
+        {
+            fprintf(stderr, FAIL "Error: Cannot restart the watcher: %s\n" ENDC, strerror(errno));
+            if(loaded)
+            {
+                scriptFree(&script);
+            }
+            return 1;
+        }
+        watcherAddTree(&w, cli->script_path);
+        Int8 script_alt[PATH_MAX];
+        snprintf(script_alt, sizeof(script_alt), "%s.ship", cli->script_path);
+        watcherAddTree(&w, script_alt);
+        ShipVector* roots = (ShipVector*)calloc(count ? count : 1, sizeof(ShipVector));
+        ShipVector outputs;
+        vectorInit(&outputs);
+        for(Size i = 0; i < count; i++)
+        {
+            watchTaskOutputs((ShipTask*)script.tasks.data[i], &outputs);
+            watchTaskRoots((ShipTask*)script.tasks.data[i], &roots[i]);
+            for(Size r = 0; r < roots[i].length; r++)
+            {
+                watcherAddTree(&w, (CharSeq)roots[i].data[r]);
+            }
+        }
+        Bool* selected = (Bool*)calloc(count ? count : 1, sizeof(Bool));
+        Size* stack = (Size*)malloc((count ? count : 1) * sizeof(Size));
+        printf("\n" DIM "Watching %lu directories for changes (Ctrl-C to stop)..." ENDC "\n", (UInt64)w.dirs.length);
+        fflush(stdout);
+
+        Bool reload = false;
+        Bool failed = false;
+        while(!reload && !failed)
+        {
+            ShipVector changed;
+            vectorInit(&changed);
+            failed = !watcherRead(&w, &changed);
+            struct pollfd pfd = { w.fd, POLLIN, 0 };
+            while(!failed && poll(&pfd, 1, SHIP_WATCH_DEBOUNCE_MS) > 0)
+            {
+                failed = !watcherRead(&w, &changed);
+            }
+            if(failed)
+            {
+                // a dead inotify fd reads as failed forever; rebuilding
+                // would only spin, so stop watching instead
+                fprintf(stderr, FAIL "Error: Watching stopped: %s\n" ENDC, strerror(errno));
+                for(Size c = 0; c < changed.length; c++)
+                {
+                    free(changed.data[c]);
+                }
+                free(changed.data);
+                break;
+            }
+
+            memset(selected, 0, count * sizeof(Bool));
+            Size top = 0;
+            for(Size c = 0; c < changed.length; c++)
+            {
+                CharSeq path = (CharSeq)changed.data[c];
+                if(strcmp(path, cli->script_path) == 0 || strcmp(path, script_alt) == 0)
+                {
+                    reload = true;
+                }
+                // a task writing under its own watched root (zip of "." into
+                // out.zip) must not retrigger itself after every rerun
+                if(watchIsOutput(path, &outputs))
+                {
+                    continue;
+                }
+                for(Size i = 0; i < count; i++)
+                {
+                    for(Size r = 0; r < roots[i].length && !selected[i]; r++)
+                    {
+                        if(watchPathUnder(path, (CharSeq)roots[i].data[r]))
+                        {
+                            selected[i] = true;
+                            stack[top++] = i;
+                        }
+                    }
+                }
+            }
+            while(top > 0)
+            {
+                ShipTask* t = (ShipTask*)script.tasks.data[stack[--top]];
+                for(Size d = 0; d < t->dependent_count; d++)
+                {
+                    if(!selected[t->dependents[d]])
+                    {
+                        selected[t->dependents[d]] = true;
+                        stack[top++] = t->dependents[d];
+                    }
+                }
+            }
+            Size rerun = 0;
+            for(Size i = 0; i < count; i++)
+            {
+                if(selected[i]) rerun++;
+            }
+            if(!reload && rerun > 0)
+            {
+                printf("\n" CYAN "%lu file change(s), rerunning %lu of %lu tasks" ENDC "\n", (UInt64)changed.length, (UInt64)rerun, (UInt64)count);
+                cli->options.selected = selected;
+                runBuild(script.title, script.tasks, &cli->options);
+                cli->options.selected = null;
+                printf("\n" DIM "Watching for changes..." ENDC "\n");
+                fflush(stdout);
+            }
+            for(Size c = 0; c < changed.length; c++)
+            {
+                free(changed.data[c]);
+            }
+            free(changed.data);
+        }
+
+        for(Size i = 0; i < count; i++)
+        {
+            for(Size r = 0; r < roots[i].length; r++)
+            {
+                free(roots[i].data[r]);
+            }
+            free(roots[i].data);
+        }
+        free(roots);
+        for(Size i = 0; i < outputs.length; i++)
+        {
+            free(outputs.data[i]);
+        }
+        free(outputs.data);
+        free(selected);
+        free(stack);
+        watcherFree(&w);
+        if(loaded)
+        {
+            scriptFree(&script);
+        }
+        if(failed)
+        {
+            return 1;
+        }
+        printf("\n" CYAN "%s changed, reloading" ENDC "\n", cli->script_path);
+    }
+}
+
+/// @brief Bring the daemon's copy of a script and of the file-hash state up
+/// to date. Scripts are taken from the .shipc a previous child wrote, so a
+/// parse error can never take the daemon down.
+Void daemonRefresh(ShipDaemon* d, CharSeq script_path)
+{
+    struct stat sb;
+    if(stat(SHIP_STATE_FILE, &sb) == 0)
+    {
+        Int64 mtime = (Int64)sb.st_mtim.tv_sec * 1000000000LL + sb.st_mtim.tv_nsec;
+        if(!d->state_loaded || mtime != d->state_mtime_ns || (Int64)sb.st_size != d->state_size)
+        {
+            if(d->state_loaded) stateFree(&d->state);
+            stateLoad(&d->state, SHIP_STATE_FILE);
+            d->state_loaded = true;
+            d->state_mtime_ns = mtime;
+            d->state_size = (Int64)sb.st_size;
+        }
+    }
+
+    Int32 saved = dup(STDOUT_FILENO);
+    Int32 devnull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    fflush(stdout);
+    if(devnull >= 0) dup2(devnull, STDOUT_FILENO);
+    ShipSource src;
+    Bool opened = sourceOpen(script_path, &src);
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    if(devnull >= 0) close(devnull);
+    if(!opened)
+    {
+        return;
+    }
+    UInt64 key = cacheKey(src.data ? src.data : "", src.size);
+    sourceClose(&src);
+    ShipString name = stringView(script_path);
+    ShipWarmScript* warm = (ShipWarmScript*)mapGetPointer(&d->scripts, name);
+    if(warm && warm->key == key)
+    {
+        return;
+    }
+    Int8 cache_path[PATH_MAX];
+    cachePath(script_path, cache_path, sizeof(cache_path));
+    ShipWarmScript* next = (ShipWarmScript*)malloc(sizeof(ShipWarmScript));
+    arenaInit(&next->arena);
+    next->key = key;
+    if(!cacheLoad(cache_path, key, &next->arena, &next->cache, &next->title, &next->tasks))
+    {
+        arenaFree(&next->arena);
+        free(next);
+        return;
+    }
+    if(warm)
+    {
+        free(warm->tasks.data);
+        cacheClose(&warm->cache);
+        arenaFree(&warm->arena);
+        free(warm);
+    }
+    mapSet(&d->scripts, name, valueFromPointer(next));
+}
+
+/// @brief Point remote execution at a comma/space separated executor list,
+/// replacing any earlier one; null disables it
+Void remoteConfigure(CharSeq spec)
+{
+    for(Size i = 0; i < global_remote.addrs.length; i++)
+    {
+        free(global_remote.addrs.data[i]);
+    }
+    global_remote.addrs.length = 0;
+    CharSeq c = spec;
+    CharSeq start;
+    Size len;
+    while(c && listNext(&c, &start, &len))
+    {
+        vectorPush(&global_remote.addrs, stringFromLength(start, len).data);
+    }
+}
+
+/// @brief Read `argc:u32 envc:u32` followed by argc args, envc "KEY=VALUE"
+/// entries and the client's cwd, all NUL-terminated
+Bool daemonReadRequest(Int32 conn, ShipString* buf, ShipVector* args, ShipVector* env, CharSeq* cwd)
+{
+    UInt32 counts[2] = { 0, 0 };
+    Size header = sizeof(counts);
+    Size scanned = header;
+    Size nuls = 0;
+    Int8 chunk[4096];
+    ssize_t n;
+    while((n = read(conn, chunk, sizeof(chunk))) > 0 || (n < 0 && errno == EINTR))
+    {
+        if(n < 0) continue;
+        stringAppend(buf, chunk, (Size)n);
+        if(buf->length >= header)
+        {
+            memcpy(counts, buf->data, header);
+            for(; scanned < buf->length; scanned++)
+            {
+                if(buf->data[scanned] == '\0') nuls++;
+            }
+            if(nuls >= (Size)counts[0] + counts[1] + 1) break;
+        }
+        if(buf->length > (8 << 20)) return false;
+    }
+    if(buf->length < header || nuls < (Size)counts[0] + counts[1] + 1)
+    {
+        return false;
+    }
+    Int8* p = buf->data + header;
+    vectorPush(args, (Any)"ship");
+    for(UInt32 i = 0; i < counts[0]; i++)
+    {
+        vectorPush(args, p);
+        p += strlen(p) + 1;
+    }
+    for(UInt32 i = 0; i < counts[1]; i++)
+    {
+        vectorPush(env, p);
+        p += strlen(p) + 1;
+    }
+    *cwd = p;
+    return true;
+}
+
+/// @brief Serve builds on a Unix socket. Each request runs in a forked child
+/// with its output streamed to the client, followed by a 5-byte trailer:
+/// a zero byte and the big-endian Int32 exit code.
+Int32 daemonServe(CharSeq socket_path)
+{
+    mkdir(SHIP_STATE_DIR, 0755);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(strlen(socket_path) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, FAIL "Error: Socket path too long: %s\n" ENDC, socket_path);
+        return 1;
+    }
+    strcpy(addr.sun_path, socket_path);
+    Int32 fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd >= 0 && connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0)
+    {
+        fprintf(stderr, FAIL "Error: A daemon is already listening on %s\n" ENDC, socket_path);
+        close(fd);
+        return 1;
+    }
+    if(fd >= 0) close(fd);
+    unlink(socket_path);
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd < 0 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0)
+    {
+        fprintf(stderr, FAIL "Error: Cannot listen on %s: %s\n" ENDC, socket_path, strerror(errno));
+        if(fd >= 0) close(fd);
+        return 1;
+    }
+
+    ShipDaemon daemon;
+    mapInit(&daemon.scripts);
+    daemon.state_loaded = false;
+    daemon.state_mtime_ns = 0;
+    daemon.state_size = 0;
+    global_daemon = &daemon;
+    printf(BOLD "Ship daemon listening on %s (pid %d)" ENDC "\n", socket_path, (Int32)getpid());
+    fflush(stdout);
+
+    while(true)
+    {
+        Int32 conn = accept4(fd, null, null, SOCK_CLOEXEC);
+        if(conn < 0)
+        {
+            if(errno == EINTR || errno == ECONNABORTED) continue;
+            break;
+        }
+        ShipString buf = stringFrom("");
+        ShipVector args;
+        ShipVector env;
+        CharSeq cwd = null;
+        vectorInit(&args);
+        vectorInit(&env);
+        if(!daemonReadRequest(conn, &buf, &args, &env, &cwd))
+        {
+            free(args.data);
+            free(env.data);
+            stringFree(&buf);
+            close(conn);
+            continue;
+        }
+        // warm scripts, state and relative paths all belong to the daemon's
+        // directory, so a client elsewhere would build the wrong tree
+        ShipCli cli;
+        Int8 err[PATH_MAX + 128];
+        Bool parsed = false;
+        struct stat here;
+        struct stat there;
+        if(stat(".", &here) != 0 || stat(cwd, &there) != 0 || here.st_dev != there.st_dev || here.st_ino != there.st_ino)
+        {
+            Int8 own[PATH_MAX];
+            snprintf(err, sizeof(err), "Error: This daemon serves %s, not %s", getcwd(own, sizeof(own)) ? own : "?", cwd);
+        }
+        else
+        {
+            parsed = cliParse(&cli, (Int32)args.length, (Int8**)args.data, err, sizeof(err));
+        }
+        if(parsed)
+        {
+            daemonRefresh(&daemon, cli.script_path);
+        }
+
+        fflush(stdout);
+        fflush(stderr);
+        pid_t pid = fork();
+        if(pid == 0)
+        {
+            close(fd);
+            dup2(conn, STDOUT_FILENO);
+            dup2(conn, STDERR_FILENO);
+            close(conn);
+            Int32 code = 1;
+            if(parsed)
+            {
+                // run tasks see the client's PATH and exports, and options
+                // read from the environment are parsed again under it
+                clearenv();
+                for(Size i = 0; i < env.length; i++)
+                {
+                    putenv((Int8*)env.data[i]);
+                }
+                parsed = cliParse(&cli, (Int32)args.length, (Int8**)args.data, err, sizeof(err));
+                remoteConfigure(cli.remote);
+            }
+            if(!parsed)
+            {
+                printf(FAIL "%s\n" ENDC, err);
+            }
+            else if(cli.bench)
+            {
+                code = benchRun(&cli.bench_config, SHIP_BENCH_OUTPUT) ? 0 : 1;
+            }
+            else
+            {
+                code = buildScript(&cli);
+            }
+            fflush(stdout);
+            fflush(stderr);
+            _exit(code);
+        }
+        Int32 code = 1;
+        if(pid > 0)
+        {
+            Int32 status = 0;
+            while(waitpid(pid, &status, 0) < 0 && errno == EINTR);
+            code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        }
+        UInt8 trailer[5];
+        UInt32 wire_code = htonl((UInt32)code);
+        trailer[0] = 0;
+        memcpy(trailer + 1, &wire_code, sizeof(wire_code));
+        if(write(conn, trailer, sizeof(trailer)) < 0)
+        {
+            printf(WARNING "Client went away before the result was sent\n" ENDC);
+        }
+        close(conn);
+        free(args.data);
+        free(env.data);
+        stringFree(&buf);
+    }
+    close(fd);
+    unlink(socket_path);
+    return 0;
+}
+
+/// @brief Forward argv, the environment and the cwd to a running daemon and relay its output. Holds back
+/// the last 5 bytes of the stream, which carry the exit code.
+Int32 clientRun(CharSeq socket_path, Int32 argc, Int8** argv, Bool* connected)
+{
+    *connected = false;
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+    Int32 fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+    {
+        if(fd >= 0) close(fd);
+        return 1;
+    }
+    *connected = true;
+
+    ShipString req = stringFrom("");
+    UInt32 counts[2] = { 0, 0 };
+    stringAppend(&req, (const Int8*)counts, sizeof(counts));
+    for(Int32 i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--client") == 0) continue;
+        stringAppend(&req, argv[i], strlen(argv[i]) + 1);
+        counts[0]++;
+    }
+    for(Int8** e = environ; *e; e++)
+    {
+        stringAppend(&req, *e, strlen(*e) + 1);
+        counts[1]++;
+    }
+    Int8 cwd[PATH_MAX];
+    if(!getcwd(cwd, sizeof(cwd))) strcpy(cwd, ".");
+    stringAppend(&req, cwd, strlen(cwd) + 1);
+    memcpy(req.data, counts, sizeof(counts));
+    Size sent = 0;
+    while(sent < req.length)
+    {
+        ssize_t n = write(fd, req.data + sent, req.length - sent);
+        if(n <= 0) break;
+        sent += (Size)n;
+    }
+    stringFree(&req);
+
+    Int8 buffer[(1 << 16) + 5];
+    Size held = 0;
+    ssize_t n;
+    while((n = read(fd, buffer + held, sizeof(buffer) - held)) > 0 || (n < 0 && errno == EINTR))
+    {
+        if(n < 0) continue;
+        Size total = held + (Size)n;
+        if(total > 5)
+        {
+            fwrite(buffer, 1, total - 5, stdout);
+            fflush(stdout);
+            memmove(buffer, buffer + total - 5, 5);
+            held = 5;
+        }
+        else
+        {
+            held = total;
+        }
+    }
+    close(fd);
+    Int32 code = 1;
+    if(held == 5 && buffer[0] == 0)
+    {
+        code = wireGetInt((CharSeq)buffer + 1);
+    }
+    else
+    {
+        fwrite(buffer, 1, held, stdout);
+        fprintf(stderr, FAIL "Error: Daemon closed the connection without a result\n" ENDC);
+    }
+    return code;
+}
+
+/// @brief Whether the connection's first frame is AUTH carrying token,
+/// compared in constant time
+static Bool workerAuthenticate(Int32 conn, CharSeq token)
+{
+    ShipString frame = stringEmpty();
+    UInt8 type;
+    Bool ok = wireRecv(conn, &type, &frame) && type == SHIP_WIRE_AUTH && frame.length == strlen(token);
+    UInt8 diff = 0;
+    for(Size i = 0; ok && i < frame.length; i++)
+    {
+        diff |= (UInt8)(frame.data[i] ^ token[i]);
+    }
+    stringFree(&frame);
+    return ok && diff == 0;
+}
+
+/// @brief Serve one client in a fresh sandbox directory: take its env, files
+/// and output list, run the command there while streaming its output, then
+/// send back the requested outputs and the exit code
+static Int32 workerHandle(Int32 conn, CharSeq token)
+{
+    if(token && !workerAuthenticate(conn, token))
+    {
+        CharSeq msg = "ship-worker: authentication failed\n";
+        wireSend(conn, SHIP_WIRE_STDERR, msg, strlen(msg));
+        wireSendInt(conn, SHIP_WIRE_EXIT, 127);
+        return 1;
+    }
+    Int8 sandbox[] = "/tmp/ship-worker-XXXXXX";
+    if(!mkdtemp(sandbox) || chdir(sandbox) != 0)
+    {
+        Int8 msg[256];
+        snprintf(msg, sizeof(msg), "ship-worker: cannot create a sandbox: %s\n", strerror(errno));
+        wireSend(conn, SHIP_WIRE_STDERR, msg, strlen(msg));
+        wireSendInt(conn, SHIP_WIRE_EXIT, 127);
+        return 1;
+    }
+    ShipVector env_pairs;
+    ShipVector outputs;
+    vectorInit(&env_pairs);
+    vectorInit(&outputs);
+    ShipString frame = stringEmpty();
+    Int8* cmd = null;
+    Int32 file = -1;
+    UInt8 type;
+    while(!cmd && wireRecv(conn, &type, &frame))
+    {
+        if(type == SHIP_WIRE_ENV)
+        {
+            vectorPush(&env_pairs, stringFrom(frame.data).data);
+        }
+        else if(type == SHIP_WIRE_FILE)
+        {
+            if(file >= 0) close(file);
+            file = wireOpenFile(&frame, null);
+        }
+        else if(type == SHIP_WIRE_DATA && file >= 0)
+        {
+            wireWriteAll(file, frame.data, frame.length);
+        }
+        else if(type == SHIP_WIRE_OUTPUT)
+        {
+            vectorPush(&outputs, stringFrom(frame.data).data);
+        }
+        else if(type == SHIP_WIRE_RUN)
+        {
+            cmd = stringFrom(frame.data).data;
+        }
+    }
+    if(file >= 0) close(file);
+
+    Int32 rc = 1;
+    if(cmd)
+    {
+        ShipValue* items = (ShipValue*)malloc((env_pairs.length + 1) * sizeof(ShipValue));
+        for(Size i = 0; i < env_pairs.length; i++)
+        {
+            items[i] = valueFromString(stringView((CharSeq)env_pairs.data[i]));
+        }
+        ShipValue list = valueNull();
+        list.type = SHIP_VALUE_LIST;
+        list.list.items = items;
+        list.list.count = env_pairs.length;
+        Int8** env = envMerge(&list);
+        ShipCapture out = { { null, 4096, 0 }, -1, conn, SHIP_WIRE_STDOUT };
+        ShipCapture err = { { null, 4096, 0 }, -1, conn, SHIP_WIRE_STDERR };
+        rc = processRun(cmd, env, &out, &err, null);
+        free(out.tail.data);
+        free(err.tail.data);
+        free(env);
+        free(items);
+        for(Size i = 0; i < outputs.length; i++)
+        {
+            wireSendPath(conn, (CharSeq)outputs.data[i], &err);
+        }
+        wireSendInt(conn, SHIP_WIRE_EXIT, rc);
+    }
+    stringFree(&frame);
+    free(cmd);
+    for(Size i = 0; i < env_pairs.length; i++) free(env_pairs.data[i]);
+    for(Size i = 0; i < outputs.length; i++) free(outputs.data[i]);
+    free(env_pairs.data);
+    free(outputs.data);
+    if(chdir("/") == 0)
+    {
+        ShipString ignored = stringEmpty();
+        removeTree(sandbox, true, &ignored, null);
+        stringFree(&ignored);
+    }
+    return cmd ? 0 : 1;
+}
+
+/// @brief ship-worker: execute remote run tasks sent to addr (a Unix socket
+/// path or a TCP host:port), each connection in its own forked child. Without
+/// SHIP_WORKER_TOKEN only a Unix socket or a loopback address is served; with
+/// it, any address, and every client must present the token first.
+Int32 workerServe(CharSeq addr)
+{
+    // keep the token out of the environment the commands inherit
+    CharSeq env_token = getenv(SHIP_WORKER_TOKEN_ENV);
+    Int8* token = env_token && env_token[0] ? stringFrom(env_token).data : null;
+    unsetenv(SHIP_WORKER_TOKEN_ENV);
+    if(!token && !wireIsLocal(addr))
+    {
+        fprintf(stderr, FAIL "Error: Refusing to listen on non-loopback %s without %s\n" ENDC, addr, SHIP_WORKER_TOKEN_ENV);
+        return 1;
+    }
+    Int32 fd = wireListen(addr);
+    if(fd < 0)
+    {
+        fprintf(stderr, FAIL "Error: Cannot listen on %s: %s\n" ENDC, addr, strerror(errno));
+        free(token);
+        return 1;
+    }
+    signal(SIGCHLD, SIG_IGN);
+    printf(BOLD "Ship worker listening on %s (pid %d)" ENDC "\n", addr, (Int32)getpid());
+    fflush(stdout);
+    while(true)
+    {
+        Int32 conn = accept4(fd, null, null, SOCK_CLOEXEC);
+        if(conn < 0)
+        {
+            if(errno == EINTR || errno == ECONNABORTED) continue;
+            break;
+        }
+        pid_t pid = fork();
+        if(pid == 0)
+        {
+            close(fd);
+            signal(SIGCHLD, SIG_DFL);
+            _exit(workerHandle(conn, token));
+        }
+        close(conn);
+    }
+    close(fd);
+    free(token);
+    return 0;
+}
+
+int main(int argc, Int8** argv)
+{
+    // writes to a peer that went away (a worker, a client, the persistent
+    // shell) must fail with EPIPE rather than kill ship; children get the
+    // default action back through spawnAttrInit
+    signal(SIGPIPE, SIG_IGN);
+    registryInit();
+    registryRegister("run", "Run Command", shipRun);
+    registryRegister("delete", "Delete", shipDelete);
+    registryRegister("mkdir", "Create Directory", shipMkdir);
+    registryRegister("copy", "Copy", shipCopy);
+    registryRegister("move", "Move", shipMove);
+    registryRegister("move_all", "Move Contents", shipMoveAll);
+    registryRegister("zip", "Create ZIP", shipZip);
+    registryRegister("list", "List Directory", shipList);
+    registryRegister("echo", "Echo", shipEcho);
+    CharSeq self = strrchr(argv[0], '/');
+    if(strcmp(self ? self + 1 : argv[0], SHIP_WORKER_NAME) == 0)
+    {
+        if(argc < 2)
+        {
+            mkdir(SHIP_STATE_DIR, 0755);
+        }
+        return workerServe(argc > 1 ? argv[1] : SHIP_WORKER_SOCKET);
+    }
+    ShipCli cli;
+    Int8 err[256];
+    if(!cliParse(&cli, argc, argv, err, sizeof(err)))
+    {
+        printf(FAIL "%s\n" ENDC, err);
+        return 1;
+    }
+    if(cli.worker)
+    {
+        return workerServe(cli.worker);
+    }
+    remoteConfigure(cli.remote);
+    if(cli.daemon)
+    {
+        return daemonServe(SHIP_DAEMON_SOCKET);
+    }
+    if(cli.client)
+    {
+        Bool connected = false;
+        Int32 code = clientRun(SHIP_DAEMON_SOCKET, argc, argv, &connected);
+        if(connected)
+        {
+            return code;
+        }
+    }
+    if(cli.bench)
+    {
+        return benchRun(&cli.bench_config, SHIP_BENCH_OUTPUT) ? 0 : 1;
+    }
+    if(cli.watch)
+    {
+        return watchRun(&cli);
+    }
+    return buildScript(&cli);
 }
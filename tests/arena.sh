@@ -0,0 +1,23 @@
+# Parse-time memory comes from the arena: strings larger than a chunk, a
+# script larger than the biggest chunk, and thousands of small escaped
+# values all come back intact.
+. "$(dirname "$0")/lib.sh"
+
+body=$(awk 'BEGIN {
+    for(i = 0; i < 5000; i++) printf "    var { s%d = \"tab\\there %d\" }\n", i, i
+    big = "x"
+    while(length(big) < 200000) big = big big
+    printf "    var { big = \"\\%s\" }\n", big
+    pad = "#"
+    while(length(pad) < 17000000) pad = pad pad
+    print pad
+    print "    echo { message: s0 }"
+    print "    echo { message: s4999 }"
+    print "    echo { message: big }"
+}')
+ship "$body" || fail "build failed: $(tail -c 300 ship.out)"
+said > got.txt
+[ "$(sed -n 1p got.txt)" = "$(printf 'tab\there 0')" ] || fail "first value: $(sed -n 1p got.txt)"
+[ "$(sed -n 2p got.txt)" = "$(printf 'tab\there 4999')" ] || fail "last value: $(sed -n 2p got.txt)"
+[ "$(sed -n 3p got.txt | tr -d '\n' | wc -c)" -eq 262144 ] || fail "big value has $(sed -n 3p got.txt | wc -c) bytes"
+exit 0
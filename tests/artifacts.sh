@@ -0,0 +1,39 @@
+# The shared artifact cache: a second checkout with the same inputs restores
+# declared outputs instead of running, --force and changed inputs run again,
+# and the store is trimmed back under its size limit.
+. "$(dirname "$0")/lib.sh"
+
+mkdir a b
+echo data > a/in.txt
+echo data > b/in.txt
+task='    run { command: "cat in.txt in.txt > out.txt; chmod 755 out.txt; echo ran >> ../runs.log", inputs: "in.txt", outputs: "out.txt" }'
+
+(cd a && ship "$task" --artifact-cache ../store) || fail "first build failed: $(cat a/ship.out)"
+[ -d store ] || fail "no store created"
+(cd b && ship "$task" --artifact-cache ../store) || fail "second checkout failed: $(cat b/ship.out)"
+grep -q "Restored from cache" b/ship.out || fail "second checkout did not restore: $(cat b/ship.out)"
+[ "$(wc -l < runs.log)" -eq 1 ] || fail "restored task ran"
+cmp -s a/out.txt b/out.txt || fail "restored output differs"
+[ -x b/out.txt ] && [ -w b/out.txt ] || fail "restored output lost its mode"
+
+rm b/out.txt
+(cd b && ship "$task" --artifact-cache ../store --force) || fail "forced build failed"
+[ "$(wc -l < runs.log)" -eq 2 ] || fail "--force restored instead of running"
+echo other > b/in.txt
+(cd b && ship "$task" --artifact-cache ../store) || fail "changed input build failed"
+[ "$(wc -l < runs.log)" -eq 3 ] || fail "changed input was restored"
+[ "$(head -n 1 b/out.txt)" = other ] || fail "stale output after input change"
+
+# three 800 KB outputs against a 1 MB limit: only the newest survives
+for n in 1 2 3; do
+    mkdir big$n
+    head -c 400000 /dev/urandom > big$n/in.txt
+    (cd big$n && ship "$task" --artifact-cache ../store --artifact-limit 1) || fail "big build $n failed"
+done
+[ "$(du -sk store | cut -f1)" -lt 1100 ] || fail "store is $(du -sk store | cut -f1) KB over a 1 MB limit"
+rm big1/out.txt big3/out.txt
+(cd big3 && ship "$task" --artifact-cache ../store --artifact-limit 1) || fail "newest rebuild failed"
+grep -q "Restored from cache" big3/ship.out || fail "newest entry was evicted"
+(cd big1 && ship "$task" --artifact-cache ../store --artifact-limit 1) || fail "oldest rebuild failed"
+grep -q "Restored from cache" big1/ship.out && fail "oldest entry survived eviction"
+exit 0
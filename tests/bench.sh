@@ -0,0 +1,18 @@
+# --bench generates a script of the requested shape, times every phase over
+# it and writes one JSON row per phase whose item counts match that shape.
+. "$(dirname "$0")/lib.sh"
+
+"$SHIP" --bench-vars 200 --bench-tasks 40 --bench-escapes 50 --bench-iterations 2 > ship.out 2>&1 \
+    || fail "bench failed: $(cat ship.out)"
+[ -f bench_output.txt ] || fail "no results file"
+for phase in tokenize parse map_set map_get plan run_dry; do
+    grep -q "^  $phase " ship.out || fail "no $phase row: $(cat ship.out)"
+    grep -q "\"phase\": \"$phase\"" bench_output.txt || fail "no $phase result"
+done
+grep -q '"phase": "map_set", "items": 200, "runs": 2' bench_output.txt || fail "map_set row: $(cat bench_output.txt)"
+grep -q '"phase": "plan", "items": 40, "runs": 2' bench_output.txt || fail "plan row: $(cat bench_output.txt)"
+grep -q '"phase": "run_dry", "items": 40,' bench_output.txt || fail "generated tasks did not all run"
+if command -v python3 > /dev/null; then
+    python3 -m json.tool bench_output.txt > /dev/null || fail "results are not JSON"
+fi
+exit 0
@@ -0,0 +1,31 @@
+# The copy and move engines: contents, modes and symlinks survive, an
+# existing directory receives src by its basename, and a target inside src
+# is refused.
+. "$(dirname "$0")/lib.sh"
+
+mkdir -p src/d/e out
+head -c 100000 /dev/urandom > src/d/blob
+echo hi > src/d/e/note
+printf '#!/bin/sh\n' > src/tool && chmod 751 src/tool
+ln -s d/e/note src/link
+
+ship '    copy { src: "src", dst: "copy" }' || fail "copy failed: $(cat ship.out)"
+cmp src/d/blob copy/d/blob || fail "blob differs"
+cmp src/d/e/note copy/d/e/note || fail "note differs"
+[ "$(stat -c %a copy/tool)" = 751 ] || fail "mode not preserved"
+[ "$(readlink copy/link)" = d/e/note ] || fail "symlink not preserved"
+
+ship '    copy { src: "src", dst: "out" }' || fail "copy into dir failed"
+cmp src/d/blob out/src/d/blob || fail "basename rule not applied"
+
+ship '    copy { src: "src", dst: "src/d/inner" }' && fail "copy into itself succeeded"
+grep -q "into itself" ship.out || fail "no into-itself error: $(cat ship.out)"
+[ ! -e src/d/inner ] || fail "copy into itself left output behind"
+
+ship '    move { src: "copy", dst: "moved" }' || fail "move failed: $(cat ship.out)"
+[ ! -e copy ] || fail "move left the source"
+cmp src/d/blob moved/d/blob || fail "moved blob differs"
+
+ship '    move { src: "moved", dst: "moved/d" }' && fail "move into itself succeeded"
+[ -d moved/d/e ] || fail "move into itself damaged the source"
+exit 0
@@ -0,0 +1,23 @@
+# Critical path first: without history ready tasks start in plan order; once
+# durations are recorded the longer task starts first, the plan shows an
+# estimate, and editing a task's args forgets its recorded time.
+. "$(dirname "$0")/lib.sh"
+
+body='    parallel {
+        run { id: "short", command: "echo short >> order.txt; sleep 0.1" }
+        run { id: "long", command: "echo long >> order.txt; sleep 0.5" }
+    }'
+ship "$body" -j 1 --cpus 1 || fail "first build failed: $(cat ship.out)"
+[ "$(head -n 1 order.txt)" = short ] || fail "without history the plan order was not kept"
+grep -q " run:long$" .ship/durations || fail "no recorded duration: $(cat .ship/durations)"
+grep -q "about" ship.out && fail "estimate shown without history"
+
+rm order.txt
+ship "$body" -j 1 --cpus 1 || fail "second build failed: $(cat ship.out)"
+[ "$(head -n 1 order.txt)" = long ] || fail "the longer task did not start first"
+grep -q "steps to execute (about" ship.out || fail "no estimate: $(cat ship.out)"
+
+rm order.txt
+ship "$(echo "$body" | sed 's/sleep 0.5/sleep 0.4/')" -j 1 --cpus 1 || fail "edited build failed"
+[ "$(head -n 1 order.txt)" = short ] || fail "a stale duration survived an args change"
+exit 0
@@ -0,0 +1,36 @@
+# The build daemon: a client run goes through the socket with the caller's
+# cwd and environment, reuses the warm plan, relays the exit code, picks up
+# script edits and survives a script error.
+. "$(dirname "$0")/lib.sh"
+
+"$SHIP" --daemon > daemon.out 2>&1 &
+pid=$!
+trap 'kill $pid 2> /dev/null; wait $pid 2> /dev/null || true; rm -rf "$WORK"' EXIT
+i=0
+while [ ! -S .ship/daemon.sock ]; do
+    i=$((i + 1))
+    [ $i -lt 50 ] || fail "daemon did not start: $(cat daemon.out)"
+    sleep 0.1
+done
+
+body='    echo { message: "hello" }
+    run { command: "echo $GREETING > env.txt; pwd > cwd.txt" }'
+GREETING=forwarded ship "$body" --client || fail "client build failed: $(cat ship.out)"
+[ "$(said)" = hello ] || fail "client output: $(cat ship.out)"
+[ "$(cat env.txt)" = forwarded ] || fail "environment not forwarded: $(cat env.txt)"
+[ "$(cat cwd.txt)" = "$(pwd)" ] || fail "cwd not forwarded: $(cat cwd.txt)"
+
+ship "$body" --client --trace warm.json || fail "warm build failed: $(cat ship.out)"
+grep -q '"name":"daemon"' warm.json || fail "warm build did not reuse the daemon's plan"
+
+ship '    echo { message: "edited" }' --client || fail "edited build failed"
+[ "$(said)" = edited ] || fail "daemon ran a stale plan: $(cat ship.out)"
+
+rc=0
+ship '    run { command: "exit 3" }' --client || rc=$?
+[ $rc -ne 0 ] || fail "failing build returned 0 through the daemon"
+ship '    if 1 < "a" { echo { message: "bad" } }' --client && fail "bad script succeeded"
+ship '    echo { message: "still up" }' --client || fail "daemon died after a script error"
+[ "$(said)" = "still up" ] || fail "after error: $(cat ship.out)"
+kill -0 $pid || fail "daemon exited: $(cat daemon.out)"
+exit 0
@@ -0,0 +1,38 @@
+# The delete engine removes whole trees without following symlinks out of
+# them, and honours forgive_missing.
+. "$(dirname "$0")/lib.sh"
+
+mkdir -p victim/a/b/c keep
+for i in 1 2 3; do echo $i > victim/a/f$i; echo $i > victim/a/b/c/g$i; done
+echo precious > keep/file
+ln -s ../keep victim/a/link
+chmod 555 victim/a/b
+
+ship '    delete { path: "victim" }' || fail "delete failed: $(cat ship.out)"
+[ ! -e victim ] || fail "victim still exists"
+[ "$(cat keep/file)" = precious ] || fail "delete followed a symlink"
+
+ship '    delete { path: "victim" }' || fail "missing path not forgiven"
+ship '    delete { path: "victim", forgive_missing: false }' \
+    && fail "missing path was forgiven"
+
+# deeper than PATH_MAX: only a walk relative to each parent's fd gets here.
+# Built by nesting short chains so no single path handed to mkdir/mv is long.
+seg=dddddddddddddddddddddddddddddddddddddddd
+chain=$seg/$seg/$seg/$seg/$seg/$seg/$seg/$seg/$seg/$seg/$seg/$seg/$seg/$seg/$seg/$seg/$seg/$seg/$seg/$seg
+mkdir -p deep/$chain
+echo leaf > deep/$chain/f
+i=0
+while [ $i -lt 6 ]; do
+    mkdir -p next/$chain
+    mv deep next/$chain/deep
+    mv next deep
+    i=$((i + 1))
+done
+ship '    delete { path: "deep" }' || fail "deep delete failed: $(cat ship.out)"
+[ ! -e deep ] || fail "deep tree still exists"
+
+echo x > single
+ship '    delete { path: "single" }' || fail "file delete failed"
+[ ! -e single ] || fail "single file still exists"
+exit 0
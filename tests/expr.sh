@@ -0,0 +1,19 @@
+# Expressions in `if`: constants fold, && and || never touch a dead operand,
+# and comparing mixed kinds is a located script error rather than an exit.
+. "$(dirname "$0")/lib.sh"
+
+ship '    var { n = 3 }
+    if false && (1 < "a") { run { command: "touch dead" } }
+    if true || (1 < "a") { run { command: "touch or" } }
+    if n > 2 && !(n >= 4) && "abc" < "abd" { run { command: "touch fold" } }
+    if n == "3" { run { command: "touch loose" } }' || fail "build failed: $(cat ship.out)"
+[ ! -e dead ] || fail "dead && block ran"
+[ -e or ] || fail "|| block did not run"
+[ -e fold ] || fail "folded condition was false"
+[ ! -e loose ] || fail "number equalled string"
+
+ship '    run { command: "touch before" }
+    if 1 < "a" { run { command: "touch bad" } }' && fail "mixed comparison succeeded"
+grep -q "Cannot compare number with string at line 3" ship.out || fail "no located error: $(cat ship.out)"
+[ ! -e before ] && [ ! -e bad ] || fail "tasks ran after a script error"
+exit 0
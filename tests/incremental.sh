@@ -0,0 +1,31 @@
+# Tasks with declared inputs and outputs are skipped while both are
+# unchanged, rerun when either changes, and symlinks in an input tree are
+# hashed by target rather than followed.
+. "$(dirname "$0")/lib.sh"
+
+mkdir -p in/sub
+echo one > in/a
+echo two > in/sub/b
+ln -s . in/loop
+ln -s a in/alias
+task='    run { command: "cat in/a in/sub/b > out.txt; echo ran >> runs.log", inputs: "in", outputs: "out.txt" }'
+
+ship "$task" || fail "first run failed: $(cat ship.out)"
+ship "$task" || fail "second run failed: $(cat ship.out)"
+grep -q "Up to date" ship.out || fail "unchanged task reran: $(cat ship.out)"
+[ "$(wc -l < runs.log)" -eq 1 ] || fail "expected one run, got $(wc -l < runs.log)"
+
+echo three > in/sub/b
+ship "$task" || fail "run after input change failed"
+[ "$(wc -l < runs.log)" -eq 2 ] || fail "input change did not rerun"
+
+rm out.txt
+ship "$task" || fail "run after output removal failed"
+[ "$(wc -l < runs.log)" -eq 3 ] || fail "missing output did not rerun"
+
+ln -sf sub/b in/alias
+ship "$task" || fail "run after relink failed"
+[ "$(wc -l < runs.log)" -eq 4 ] || fail "retargeted symlink did not rerun"
+ship "$task" || fail "settled run failed"
+[ "$(wc -l < runs.log)" -eq 4 ] || fail "symlinked tree never settles"
+exit 0
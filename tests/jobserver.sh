@@ -0,0 +1,33 @@
+# The make jobserver: make started by run tasks takes its job slots from
+# ship's -j budget, shares it across parallel tasks, and joins an outer
+# make's jobserver when ship itself runs under make.
+. "$(dirname "$0")/lib.sh"
+
+ship '    run { command: "echo \"$MAKEFLAGS\" > flags.txt" }' -j 3 --cpus 3 || fail "build failed: $(cat ship.out)"
+grep -q -- "-j3" flags.txt && grep -q -- "--jobserver-auth=" flags.txt || fail "not advertised: $(cat flags.txt)"
+ship '    run { command: "echo \"$MAKEFLAGS\" > flags.txt" }' -j 3 --no-jobserver || fail "build failed"
+grep -q -- "--jobserver-auth=" flags.txt && fail "advertised with --no-jobserver"
+command -v make > /dev/null || { echo "make not installed; skipping"; exit 0; }
+
+printf 'all: r1 r2 r3 r4 r5 r6\nr%%:\n\t@echo + >> $(EV); sleep 0.2; echo - >> $(EV)\n' > inner.mk
+# peak <events>: most recipes that were running at once
+peak()
+{
+    awk '/\+/ { n++; if(n > m) m = n } /-/ { n-- } END { print m + 0 }' "$1"
+}
+
+ship '    run { command: "make -s -f inner.mk EV=one.ev" }' -j 3 --cpus 3 || fail "one make failed: $(cat ship.out)"
+[ "$(peak one.ev)" -ge 2 ] && [ "$(peak one.ev)" -le 3 ] || fail "one make under -j3 peaked at $(peak one.ev)"
+
+two='    parallel {
+        run { command: "make -s -f inner.mk EV=two.ev" }
+        run { command: "make -s -f inner.mk EV=two.ev" }
+    }'
+ship "$two" -j 2 --cpus 2 || fail "two makes failed: $(cat ship.out)"
+[ "$(peak two.ev)" -le 2 ] || fail "two makes under -j2 peaked at $(peak two.ev)"
+
+printf 'all:\n\t+"%s" -j 8 --cpus 8 build.ship > ship.out 2>&1\n' "$SHIP" > outer.mk
+sed -i 's/two.ev/outer.ev/g' build.ship
+make -s -j3 -f outer.mk || fail "ship under make -j3 failed: $(cat ship.out)"
+[ "$(peak outer.ev)" -le 3 ] || fail "under make -j3 the recipes peaked at $(peak outer.ev)"
+exit 0
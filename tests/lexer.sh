@@ -0,0 +1,30 @@
+# The lexer reads the mapped script in place: escapes, both quote styles,
+# every comment form and CRLF endings lex right, and a script that ends
+# without a newline, exactly at a page boundary or not at all still parses.
+. "$(dirname "$0")/lib.sh"
+
+printf 'ship {\r\n  // line comment "not a string"\r\n  /* block\r\n  comment */ # hash comment\r\n  echo { message: "a\\"b\\\\c\\td" }\r\n  echo { message: '"'"'single "quoted"'"'"' }\r\n  var { n = -2.5 }\r\n}' > build.ship
+"$SHIP" build.ship > ship.out 2>&1 || fail "build failed: $(cat ship.out)"
+said > got.txt
+printf '%s\n' "$(printf 'a"b\\c\td')" 'single "quoted"' > want.txt
+cmp -s got.txt want.txt || fail "wrong tokens: $(cat got.txt)"
+
+: > build.ship
+"$SHIP" build.ship > ship.out 2>&1 || fail "empty script failed: $(cat ship.out)"
+
+# pad so that the final closing brace is the last byte of the first page
+printf 'ship { echo { message: "edge" } #' > build.ship
+head -c $((4096 - 2 - $(wc -c < build.ship))) /dev/zero | tr '\0' x >> build.ship
+printf '\n}' >> build.ship
+"$SHIP" build.ship > ship.out 2>&1 || fail "page-sized script failed: $(cat ship.out)"
+[ "$(said)" = edge ] || fail "page-sized script lost its task: $(cat ship.out)"
+
+printf 'ship {\n  echo { message: "never closed }\n' > build.ship
+rc=0
+"$SHIP" build.ship > ship.out 2>&1 || rc=$?
+[ $rc -eq 1 ] || fail "unterminated string exited $rc: $(cat ship.out)"
+
+printf 'ship {\n\n  echo message\n}\n' > build.ship
+"$SHIP" build.ship > ship.out 2>&1 && fail "missing brace succeeded"
+grep -q "at line 3" ship.out || fail "wrong error line: $(cat ship.out)"
+exit 0
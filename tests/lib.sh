@@ -0,0 +1,28 @@
+# Shared setup for the smoke tests: $1 is the ship binary. Each test runs in
+# a scratch directory that is removed on exit.
+set -eu
+SHIP=$1
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+cd "$WORK"
+unset SHIP_ARTIFACT_CACHE MAKEFLAGS
+
+fail()
+{
+    echo "FAIL: $*" >&2
+    exit 1
+}
+
+# ship <script body> [flags...]: write build.ship and run it
+ship()
+{
+    printf 'ship {\n%s\n}\n' "$1" > build.ship
+    shift
+    "$SHIP" "$@" build.ship > ship.out 2>&1
+}
+
+# said: the messages echo tasks printed in the last run, one per line
+said()
+{
+    sed -n 's/^  .*>[^ ]* //p' ship.out
+}
@@ -0,0 +1,28 @@
+# The native list task: globs follow shell rules, excluded directories are
+# skipped, matches are sorted, and "@id" hands the listing to later tasks,
+# even when the list task itself would be skipped as up to date.
+. "$(dirname "$0")/lib.sh"
+
+mkdir -p src/sub/deep src/skip
+touch src/a.c src/b.h src/sub/c.c src/sub/deep/d.c src/.hidden.c src/skip/e.c marker
+body='    list { id: "cs", path: "src", pattern: "**/*.c", exclude: "skip", inputs: "src", outputs: "marker" }
+    list { id: "dirs", path: "src", type: "dir" }
+    list { id: "some", path: "src", pattern: ["*.h", "sub/*.c"] }
+    echo { message: "@cs" }
+    echo { message: "@dirs" }
+    echo { message: "@some" }
+    zip { files: "@cs", zip_path: "cs.zip" }'
+ship "$body" || fail "build failed: $(cat ship.out)"
+said > got.txt
+printf '%s\n' "src/a.c src/sub/c.c src/sub/deep/d.c" "src/skip src/sub" "src/b.h src/sub/c.c" > want.txt
+cmp -s got.txt want.txt || fail "wrong listings: $(cat got.txt)"
+
+ship "$body" || fail "second build failed: $(cat ship.out)"
+said > got.txt
+cmp -s got.txt want.txt || fail "consumer lost the skipped producer's listing: $(cat got.txt)"
+
+if command -v unzip > /dev/null; then
+    [ "$(unzip -Z1 cs.zip | wc -l)" -eq 3 ] || fail "zip of the listing: $(unzip -Z1 cs.zip)"
+fi
+ship '    list { path: "absent" }' && fail "listing a missing directory succeeded"
+exit 0
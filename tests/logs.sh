@@ -0,0 +1,21 @@
+# Run output streams through a bounded tail: the full stdout and stderr land
+# in a per-task log file while the error report shows only the last 64 KiB,
+# prefixed with how much was left out and where to find it.
+. "$(dirname "$0")/lib.sh"
+
+ship '    run { command: "seq 1 500000; sleep 1; echo err-marker >&2; exit 2" }' && fail "exit 2 succeeded"
+log=.ship/logs/001-run.log
+[ -f $log ] || fail "no log file: $(ls .ship/logs 2> /dev/null)"
+[ "$(grep -c . $log)" -eq 500001 ] || fail "log has $(grep -c . $log) lines"
+[ "$(head -n 1 $log)" = 1 ] || fail "log lost the start"
+grep -q err-marker $log || fail "stderr not logged"
+grep -q "earlier bytes omitted; full output in $log" ship.out || fail "no omission note: $(head -c 2000 ship.out)"
+grep -q '^500000' ship.out || fail "tail lost the last line"
+grep -q err-marker ship.out || fail "stderr missing from the report"
+[ "$(wc -c < ship.out)" -lt 80000 ] || fail "report is $(wc -c < ship.out) bytes, not a bounded tail"
+
+ship '    run { command: "echo short; exit 1" }
+    run { command: "echo next" }' && fail "exit 1 succeeded"
+grep -q omitted ship.out && fail "short output reported as truncated"
+grep -q 'short' ship.out || fail "short output missing: $(cat ship.out)"
+exit 0
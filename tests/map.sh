@@ -0,0 +1,22 @@
+# Variables live in the hash-table map: tens of thousands of them resolve,
+# redefinition overwrites, names that share prefixes or hash buckets stay
+# apart, and an unknown name still reads as itself.
+. "$(dirname "$0")/lib.sh"
+
+body=$(awk 'BEGIN {
+    for(i = 0; i < 20000; i++) printf "    var { v%d = \"value %d\" }\n", i, i
+    print "    var { v7 = \"seven again\" }"
+    print "    var { v = \"bare\" }"
+    print "    echo { message: v0 }"
+    print "    echo { message: v7 }"
+    print "    echo { message: v19999 }"
+    print "    echo { message: v1 }"
+    print "    echo { message: v10 }"
+    print "    echo { message: v }"
+    print "    echo { message: v20000 }"
+}')
+ship "$body" || fail "build failed: $(tail ship.out)"
+said > got.txt
+printf '%s\n' "value 0" "seven again" "value 19999" "value 1" "value 10" bare v20000 > want.txt
+cmp -s got.txt want.txt || fail "wrong values: $(cat got.txt)"
+exit 0
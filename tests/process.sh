@@ -0,0 +1,32 @@
+# Commands started with posix_spawn: exit codes and signals come back as
+# the shell reports them, with and without /bin/sh in between, and a command
+# that cannot be started fails with the reason instead of silently.
+. "$(dirname "$0")/lib.sh"
+
+ship '    run { command: "sh -c \"exit 3\"" }' && fail "exit 3 succeeded"
+grep -q "exit 3" ship.out || fail "direct exit code lost: $(cat ship.out)"
+ship '    run { command: "true; exit 5" }' && fail "exit 5 succeeded"
+grep -q "exit 5" ship.out || fail "shell exit code lost: $(cat ship.out)"
+ship '    run { command: "kill -9 $$" }' && fail "killed command succeeded"
+grep -q "exit 137" ship.out || fail "signal not reported as 128+9: $(cat ship.out)"
+ship '    run { command: "no-such-command-here" }' && fail "missing command succeeded"
+grep -q "exit 127" ship.out && grep -q "No such file" ship.out || fail "missing command: $(cat ship.out)"
+
+ship '    run { command: "printf %s spaced   out > words.txt" }
+    run { command: "yes | head -n 3 > yes.txt" }' || fail "build failed: $(cat ship.out)"
+[ "$(cat words.txt)" = spacedout ] || fail "argv split wrong: $(cat words.txt)"
+[ "$(wc -l < yes.txt)" -eq 3 ] || fail "yes | head did not end"
+
+# with too few descriptors for the output pipes the task reports why
+ship '    run { command: "true" }' || fail "true failed"
+# (how many descriptors the startup needs varies, so step the limit down)
+n=9
+while [ $n -ge 4 ]; do
+    if ! (ulimit -n $n; exec "$SHIP" build.ship) > ship.out 2>&1 &&
+        grep -q "true: Too many open files" ship.out; then
+        break
+    fi
+    n=$((n - 1))
+done
+[ $n -ge 4 ] || fail "pipe failure not reported: $(cat ship.out)"
+exit 0
@@ -0,0 +1,25 @@
+# Remote run tasks through a ship-worker: inputs go out, declared outputs and
+# the exit code come back, and the worker only serves what it should.
+. "$(dirname "$0")/lib.sh"
+
+"$SHIP" --worker "unix:$WORK/w.sock" > worker.log 2>&1 &
+worker=$!
+trap 'kill $worker 2> /dev/null; rm -rf "$WORK"' EXIT
+i=0
+while [ ! -S w.sock ] && [ $i -lt 50 ]; do sleep 0.1; i=$((i + 1)); done
+[ -S w.sock ] || fail "worker did not start: $(cat worker.log)"
+[ "$(stat -c %a w.sock)" = 600 ] || fail "worker socket is not owner-only"
+
+mkdir in
+echo payload > in/foo..bar
+ship "    run { command: \"cat in/foo..bar > out.txt; exit 3\", remote: \"unix:$WORK/w.sock\", inputs: \"in\", outputs: \"out.txt\" }" \
+    && fail "remote exit code was lost"
+grep -q "exit 3" ship.out || fail "wrong remote exit code: $(cat ship.out)"
+[ "$(cat out.txt)" = payload ] || fail "input or output did not round-trip"
+
+ship "    run { command: \"exit 1\", remote: \"unix:$WORK/w.sock\", inputs: \"in/../in/foo..bar\" }" || true
+grep -q "must be relative" ship.out || fail "a .. input was sent: $(cat ship.out)"
+
+"$SHIP" --worker 0.0.0.0:0 > public.log 2>&1 && fail "worker listened on a public address"
+grep -q "non-loopback" public.log || fail "no loopback error: $(cat public.log)"
+exit 0
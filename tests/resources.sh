@@ -0,0 +1,44 @@
+# Tasks are packed by their declared cpus and memory: the running totals
+# never pass --cpus or --memory, tasks that fit run side by side, and a task
+# larger than the machine still runs, alone.
+. "$(dirname "$0")/lib.sh"
+
+# task <args> <weight>: a parallel member logging +weight and -weight around a sleep
+task()
+{
+    printf '        run { command: "echo +%s >> ev; sleep 0.3; echo -%s >> ev", %s }\n' "$2" "$2" "$1"
+}
+# peak: the largest sum of weights that were running at once
+peak()
+{
+    awk '/^\+/ { n += substr($0, 2); if(n > m) m = n } /^-/ { n -= substr($0, 2) } END { print m + 0 }' ev
+}
+
+ship "    parallel {
+$(task 'cpus: 3' 3)
+$(task 'cpus: 2' 2)
+$(task 'cpus: 1' 1)
+$(task 'cpus: 1' 1)
+    }" -j 4 --cpus 4 || fail "cpu build failed: $(cat ship.out)"
+[ "$(peak)" -le 4 ] || fail "declared cpus peaked at $(peak) over 4"
+[ "$(peak)" -ge 3 ] || fail "nothing ran alongside the big task"
+
+rm ev
+ship "    parallel {
+$(task 'memory: "80M"' 80)
+$(task 'memory: 80' 80)
+$(task 'memory: "20M"' 20)
+    }" -j 4 --cpus 4 --memory 100M || fail "memory build failed: $(cat ship.out)"
+[ "$(peak)" -le 100 ] || fail "declared memory peaked at $(peak)M over 100M"
+[ "$(peak)" -eq 100 ] || fail "the 20M task never ran beside an 80M one"
+
+rm ev
+ship "    parallel {
+$(task 'cpus: 16' 16)
+$(task 'cpus: 1' 1)
+    }" -j 2 --cpus 2 || fail "oversized build failed: $(cat ship.out)"
+[ "$(peak)" -eq 16 ] || fail "oversized task did not run alone: peak $(peak)"
+
+ship '    run { command: "true", memory: "lots" }' || fail "bad memory failed the build"
+grep -q "cannot parse memory 'lots'" ship.out || fail "no warning for a bad size: $(cat ship.out)"
+exit 0
@@ -0,0 +1,22 @@
+# Dependencies are honoured under a parallel pool, and cycles are rejected
+# before any task runs.
+. "$(dirname "$0")/lib.sh"
+
+ship '    run { id: "slow", command: "sleep 0.3; echo slow >> order.log" }
+    run { id: "fast", command: "echo fast >> order.log", after: "slow" }
+    run { id: "side", command: "echo side >> side.log" }
+    run { command: "echo last >> order.log", after: "fast, side" }' -j 4 \
+    || fail "ordered build failed: $(cat ship.out)"
+[ "$(cat order.log)" = "$(printf 'slow\nfast\nlast')" ] || fail "wrong order: $(cat order.log)"
+[ -f side.log ] || fail "independent task did not run"
+
+ship '    run { id: "a", command: "touch ran", after: "b" }
+    run { id: "b", command: "touch ran", after: "a" }' -j 4 \
+    && fail "cyclic build succeeded"
+grep -q "cycle" ship.out || fail "no cycle error: $(cat ship.out)"
+[ ! -e ran ] || fail "a task ran despite the cycle"
+
+ship '    run { id: "a", command: "touch ran", after: "missing" }' \
+    && fail "unknown dependency accepted"
+[ ! -e ran ] || fail "a task ran despite the unknown dependency"
+exit 0
@@ -0,0 +1,24 @@
+# The persistent shell: state carries across tasks, command text never breaks
+# the driver or its sentinels, and a task env reaches its command only.
+. "$(dirname "$0")/lib.sh"
+
+ship '    run { command: "cd sub 2> /dev/null || mkdir sub && cd sub; KEPT=yes", shell: "persistent" }
+    run { command: "echo \"$KEPT $(basename $PWD)\" > ../state.txt", shell: "persistent" }
+    run { command: "echo \"__ship_1_1__ 0\"; printf \"no newline\"", shell: "persistent" }
+    run { command: "cat <<EOT > ../heredoc.txt\nline $KEPT\nEOT", shell: "persistent" }
+    run { command: "(sleep 0.2; echo late > ../late.txt) &", shell: "persistent" }
+    run { command: "echo \"$FOO\" > ../env.txt", shell: "persistent", env: "FOO=it'"'"'s set" }
+    run { command: "echo \"[$FOO] $KEPT\" > ../after.txt", shell: "persistent" }' \
+    || fail "persistent build failed: $(cat ship.out)"
+[ "$(cat state.txt)" = "yes sub" ] || fail "state not kept: $(cat state.txt)"
+[ "$(cat sub/../heredoc.txt)" = "line yes" ] || fail "heredoc broken: $(cat heredoc.txt)"
+[ "$(cat late.txt)" = late ] || fail "background job not waited for"
+[ "$(cat env.txt)" = "it's set" ] || fail "env not exported: $(cat env.txt)"
+[ "$(cat after.txt)" = "[] yes" ] || fail "env leaked into the next task: $(cat after.txt)"
+
+ship '    run { command: "echo \"unbalanced", shell: "persistent" }' && fail "unbalanced quote succeeded"
+ship '    run { command: "exit 7", shell: "persistent" }' && fail "exit 7 succeeded"
+grep -q "exit 7" ship.out || fail "wrong exit code: $(cat ship.out)"
+ship '    run { command: "echo recovered > again.txt", shell: "persistent" }' || fail "shell did not recover"
+[ "$(cat again.txt)" = recovered ] || fail "recovered task did not run"
+exit 0
@@ -0,0 +1,27 @@
+# The .shipc plan cache: the second run loads it instead of rewriting it,
+# produces the same plan and output, and editing the script invalidates it.
+. "$(dirname "$0")/lib.sh"
+
+body='    var { greeting = "hello one" }
+    echo { id: "first", message: greeting }
+    parallel {
+        echo { message: "two", after: "first" }
+        echo { message: "three", after: "first" }
+    }'
+cache=.ship/build.ship.shipc
+
+ship "$body" || fail "cold run failed: $(cat ship.out)"
+cp ship.out cold.out
+[ -f $cache ] || fail "no cache written"
+# backdate the cache: a load leaves it alone, a miss writes a fresh one
+touch -d 2000-01-01 $cache
+
+ship "$body" || fail "warm run failed: $(cat ship.out)"
+[ -z "$(find $cache -newermt 2001-01-01)" ] || fail "warm run rewrote the cache instead of loading it"
+grep -q "hello one" ship.out || fail "cached plan lost the variable: $(cat ship.out)"
+[ "$(grep -c '✔' ship.out)" -eq "$(grep -c '✔' cold.out)" ] || fail "cached plan differs"
+
+ship "$(echo "$body" | sed 's/hello/goodbye/')" || fail "edited run failed"
+[ -n "$(find $cache -newermt 2001-01-01)" ] || fail "edited script reused the cache"
+grep -q "goodbye one" ship.out || fail "edited script ran the stale plan"
+exit 0
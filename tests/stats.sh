@@ -0,0 +1,15 @@
+# --stats counts the CPU that native tasks spend on their pool threads, and
+# shows n/a for commands ship cannot sample instead of near-zero numbers.
+. "$(dirname "$0")/lib.sh"
+
+mkdir src
+seq 1 3000000 > src/numbers
+ship '    zip { src: "src", zip_path: "out.zip" }
+    run { command: "i=0; while [ $i -lt 1000 ]; do i=$((i+1)); done", shell: "persistent" }' --stats \
+    || fail "build failed: $(cat ship.out)"
+row=$(grep '^  [0-9][0-9]* *zip ' ship.out) || fail "no zip row: $(cat ship.out)"
+user=$(echo "$row" | awk '{ print $4 }')
+awk -v u="$user" 'BEGIN { exit !(u > 0.02) }' || fail "zip CPU not counted: $row"
+grep '^  [0-9][0-9]* *run ' ship.out | grep -q 'n/a' || fail "persistent shell row not n/a: $(cat ship.out)"
+grep -q 'not counted' ship.out || fail "no unmeasured note"
+exit 0
@@ -0,0 +1,29 @@
+# --trace writes a Chrome trace-event file: the build phases, one complete
+# event per task and per spawned process, and timestamps that respect the
+# task graph.
+. "$(dirname "$0")/lib.sh"
+
+# field <event name> <key>: a numeric field of the first event with that name
+field()
+{
+    grep "\"name\":\"$1\"" trace.json | head -n 1 | sed "s/.*\"$2\":\([0-9.]*\).*/\1/"
+}
+
+ship '    run { id: "first", command: "sleep 0.2" }
+    parallel {
+        echo { message: "second", after: "first" }
+        run { command: "true", after: "first" }
+    }' -j 2 --trace trace.json || fail "build failed: $(cat ship.out)"
+[ "$(head -c 1 trace.json)" = "{" ] && [ "$(tail -n 1 trace.json)" = "]}" ] || fail "trace not closed"
+if command -v python3 > /dev/null; then
+    python3 -m json.tool trace.json > /dev/null || fail "trace is not JSON"
+fi
+for name in read parse plan build "\\[1\\] run" "\\[2\\] echo" "\\[3\\] run" "sleep 0.2" true; do
+    grep -q "\"ph\":\"X\".*\"name\":\"$name\"" trace.json || fail "no event for $name"
+done
+[ "$(grep -c '"ph":"X","cat":"task"' trace.json)" -eq 3 ] || fail "expected three task events"
+
+end=$(awk "BEGIN { print $(field '\[1\] run' ts) + $(field '\[1\] run' dur) }")
+awk "BEGIN { exit !($(field '\[2\] echo' ts) >= $end) }" || fail "echo started before its dependency ended"
+awk "BEGIN { exit !($(field 'sleep 0.2' dur) >= 200000) }" || fail "process event shorter than the sleep"
+exit 0
@@ -0,0 +1,24 @@
+# Tagged values: numbers, bools, null and lists print the same way wherever
+# they are used, truthiness follows the type, and typed args read their type.
+. "$(dirname "$0")/lib.sh"
+
+ship '    var { n = 3 }
+    var { items = [1, "two", true, [0.5, null]] }
+    echo { message: n }
+    echo { message: 2.5 }
+    echo { message: 0.1 }
+    echo { message: -7 }
+    echo { message: false }
+    echo { message: null }
+    echo { message: items }
+    if items { echo { message: "full list" } }
+    if [] { echo { message: "empty list" } }
+    if 0 { echo { message: "zero" } }
+    if "" { echo { message: "empty string" } }
+    delete { path: "missing", forgive_missing: true }' || fail "build failed: $(cat ship.out)"
+said > got.txt
+printf '%s\n' 3 2.5 0.1 -7 false null "1 two true 0.5 null" "full list" > want.txt
+cmp -s got.txt want.txt || fail "wrong values: $(cat got.txt)"
+
+ship '    delete { path: "missing", forgive_missing: false }' && fail "false bool was truthy"
+exit 0
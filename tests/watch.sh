@@ -0,0 +1,42 @@
+# --watch reruns a task whose inputs changed together with its dependents,
+# leaves unrelated tasks alone, ignores its own outputs and reloads the
+# script when it is edited.
+. "$(dirname "$0")/lib.sh"
+
+# lines <file> <count>: wait up to five seconds for file to reach count lines
+lines()
+{
+    i=0
+    while [ "$(cat "$1" 2> /dev/null | wc -l)" -lt "$2" ]; do
+        i=$((i + 1))
+        [ $i -lt 50 ] || fail "$1 never reached $2 lines: $(cat ship.out)"
+        sleep 0.1
+    done
+}
+
+mkdir a b
+echo 1 > a/f
+echo 1 > b/f
+printf 'ship {
+    run { id: "a", command: "echo a >> a.log; cp a/f a/copy", inputs: "a", outputs: "a/copy" }
+    run { id: "b", command: "echo b >> b.log", inputs: "b", after: "" }
+    run { id: "c", command: "echo c >> c.log", after: "a" }
+}
+' > build.ship
+"$SHIP" --watch build.ship > ship.out 2>&1 &
+pid=$!
+trap 'kill $pid 2> /dev/null; wait $pid 2> /dev/null || true; rm -rf "$WORK"' EXIT
+lines c.log 1
+sleep 0.5
+
+echo 2 > a/f
+lines c.log 2
+sleep 0.5
+[ "$(wc -l < a.log)" -eq 2 ] || fail "a ran $(wc -l < a.log) times, its own output retriggered it"
+[ "$(wc -l < b.log)" -eq 1 ] || fail "unrelated task b reran"
+
+echo '# edited' >> build.ship
+lines c.log 3
+kill -0 $pid || fail "watch exited: $(cat ship.out)"
+grep -q "reloading" ship.out || fail "script edit did not reload: $(cat ship.out)"
+exit 0
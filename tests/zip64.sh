@@ -0,0 +1,26 @@
+# The zip writer switches to zip64 past 65535 entries and for streamed
+# entries, large entries deflated in slices concatenate correctly, and the
+# result extracts with a stock unzip.
+. "$(dirname "$0")/lib.sh"
+command -v unzip > /dev/null || { echo "unzip not installed; skipping"; exit 0; }
+
+mkdir -p tree/many
+(cd tree/many && seq 1 65600 | xargs touch)
+head -c 40000000 /dev/zero > tree/big.bin
+head -c 300000 /dev/urandom > tree/noise.bin
+seq 1 5000000 > tree/seq.txt
+
+ship '    zip { src: "tree", zip_path: "out/tree.zip" }' \
+    || fail "zip failed: $(cat ship.out)"
+unzip -tqq out/tree.zip > unzip.out 2>&1 || fail "archive does not verify: $(tail -5 unzip.out)"
+[ "$(unzip -Z1 out/tree.zip | wc -l)" -eq 65603 ] || fail "wrong entry count"
+unzip -p out/tree.zip big.bin | cmp - tree/big.bin || fail "streamed entry differs"
+unzip -p out/tree.zip seq.txt | cmp - tree/seq.txt || fail "chunked entry differs"
+unzip -p out/tree.zip noise.bin | cmp - tree/noise.bin || fail "small entry differs"
+# zip64 end of central directory record and locator, at the end of the file
+tail -c 128 out/tree.zip | od -An -v -tx1 | tr -d ' \n' | grep -q 504b0606 || fail "no zip64 end record"
+tail -c 128 out/tree.zip | od -An -v -tx1 | tr -d ' \n' | grep -q 504b0607 || fail "no zip64 locator"
+ship '    zip { src: "tree/seq.txt", zip_path: "out/stored.zip", store: true }' \
+    || fail "stored zip failed: $(cat ship.out)"
+unzip -p out/stored.zip seq.txt | cmp - tree/seq.txt || fail "stored chunked entry differs"
+exit 0